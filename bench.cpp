@@ -0,0 +1,1202 @@
+#include "alloc_count.hpp"
+#include "khelper.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include <unistd.h>
+
+using namespace khelper;
+
+const constexpr bool BENCH_ALL   = false;
+const constexpr bool BENCH_SCAN  = BENCH_ALL || true;
+const constexpr bool BENCH_FIND  = BENCH_ALL || true;
+const constexpr bool BENCH_CASE  = BENCH_ALL || true;
+const constexpr bool BENCH_SET   = BENCH_ALL || true;
+const constexpr bool BENCH_UTF8  = BENCH_ALL || true;
+const constexpr bool BENCH_SHELL = BENCH_ALL || true;
+const constexpr bool BENCH_MULTI = BENCH_ALL || true;
+const constexpr bool BENCH_REGEX = BENCH_ALL || true;
+const constexpr bool BENCH_LAZY  = BENCH_ALL || true;
+const constexpr bool BENCH_SLICE = BENCH_ALL || true;
+const constexpr bool BENCH_PRUNE = BENCH_ALL || true;
+const constexpr bool BENCH_JOIN  = BENCH_ALL || true;
+const constexpr bool BENCH_HASH  = BENCH_ALL || true;
+const constexpr bool BENCH_PAR   = BENCH_ALL || true;
+const constexpr bool BENCH_PARSE = BENCH_ALL || true;
+const constexpr bool BENCH_CSV   = BENCH_ALL || true;
+const constexpr bool BENCH_ARENA = BENCH_ALL || true;
+const constexpr bool BENCH_FMT   = BENCH_ALL || true;
+const constexpr bool BENCH_NUM   = BENCH_ALL || true;
+const constexpr bool BENCH_PRINT = BENCH_ALL || true;
+
+const constexpr size_t BENCH_BYTES = 64 << 20;
+const constexpr int BENCH_REPS     = 3;
+
+// Keeps the optimizer from throwing away the work being timed.
+volatile size_t bench_sink = 0;
+
+// Runs `func` a few times and reports the best run. `bytes` is the amount of
+// input processed per run, for the throughput column.
+template <typename F>
+auto bench(const std::string_view name, const size_t bytes, F func) {
+    using Clock   = std::chrono::steady_clock;
+    double best   = 0;
+    size_t allocs = 0;
+    for (int i = 0; i < BENCH_REPS; i++) {
+        const size_t allocs_before = allocation_count.load();
+        const auto start           = Clock::now();
+        bench_sink                 = bench_sink + func();
+        const double secs
+            = std::chrono::duration<double>(Clock::now() - start).count();
+        allocs = allocation_count.load() - allocs_before;
+        if (i == 0 or secs < best) { best = secs; }
+    }
+    println("  {}: {:.1f} ms, {:.3f} GB/s, {} allocations", name, best * 1e3,
+            bytes / best / 1e9, allocs);
+}
+
+// CSV-ish text: short fields, a newline roughly every 80 bytes.
+auto make_text(const size_t size) -> String {
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<int> field_len{1, 16};
+    String output = {};
+    output.reserve(size);
+    size_t line_len = 0;
+    while (output.size() < size) {
+        output.append(field_len(rng), 'x');
+        line_len += 17;
+        if (line_len > 80) {
+            output += '\n';
+            line_len = 0;
+        } else {
+            output += ',';
+        }
+    }
+    return output;
+}
+
+// The loop `split()` used before it moved onto the scan core.
+auto split_bytewise(const std::string_view input, const char &delim)
+    -> Vec<String> {
+    Vec<String> output = {};
+    String elem        = "";
+    for (size_t i = 0; i < input.size(); i++) {
+        if (input[i] != delim) {
+            elem += input[i];
+        } else if (input[i] == delim and !elem.empty()) {
+            output.push_back(elem);
+            elem.clear();
+        }
+    }
+    if (!elem.empty()) { output.push_back(elem); }
+    return output;
+}
+
+auto bench_scan() {
+    const String text = make_text(BENCH_BYTES);
+    println("scan: {} MiB", text.size() >> 20);
+
+    println("count ','");
+    bench("byte loop", text.size(), [&] {
+        size_t count = 0;
+        for (const char c : text) {
+            count += c == ',';
+        }
+        return count;
+    });
+    bench("memchr", text.size(), [&] {
+        size_t count    = 0;
+        const char *pos = text.data();
+        const char *end = text.data() + text.size();
+        while ((pos = static_cast<const char *>(memchr(pos, ',', end - pos)))) {
+            count++;
+            pos++;
+        }
+        return count;
+    });
+    for (auto impl : {ScanImpl::Scalar, ScanImpl::SSE2, ScanImpl::AVX2,
+                      ScanImpl::AVX512}) {
+        if (!set_scan_impl(impl)) { continue; }
+        bench(format("count_byte {}", impl), text.size(),
+              [&] { return count_byte(',', text); });
+    }
+
+    // Newlines are sparse, so this is where wide compares pay off the most.
+    println("find every '\\n'");
+    bench("memchr", text.size(), [&] {
+        size_t count    = 0;
+        const char *pos = text.data();
+        const char *end = text.data() + text.size();
+        while (
+            (pos = static_cast<const char *>(memchr(pos, '\n', end - pos)))) {
+            count++;
+            pos++;
+        }
+        return count;
+    });
+    for (auto impl : {ScanImpl::Scalar, ScanImpl::SSE2, ScanImpl::AVX2,
+                      ScanImpl::AVX512}) {
+        if (!set_scan_impl(impl)) { continue; }
+        bench(format("lines_view {}", impl), text.size(),
+              [&] { return lines_view(text).count(); });
+    }
+
+    println("split(',')");
+    bench("bytewise split", text.size(),
+          [&] { return split_bytewise(text, ',').size(); });
+    for (auto impl : {ScanImpl::Scalar, ScanImpl::AVX2, ScanImpl::AVX512}) {
+        if (!set_scan_impl(impl)) { continue; }
+        bench(format("split {}", impl), text.size(),
+              [&] { return split(text, ',').size(); });
+    }
+    set_scan_impl(ScanImpl::Auto);
+    bench("split_view().to_vec()", text.size(),
+          [&] { return split_view(',', text).to_vec().size(); });
+}
+
+// The loop `replace()` used before it went through a Searcher, minus its
+// read past the end of `input`.
+auto replace_bytewise(const std::string_view input, const std::string_view from,
+                      const std::string_view to) -> String {
+    String output{};
+    for (size_t i = 0; i < input.size();) {
+        if (starts_with(from, input.substr(i))) {
+            i += from.size();
+            output += to;
+        } else {
+            output += input[i];
+            i++;
+        }
+    }
+    return output;
+}
+
+auto bench_find() {
+    const String text = make_text(BENCH_BYTES);
+    println("find: {} MiB", text.size() >> 20);
+
+    // Neither occurs in the text, so every search reads all of it.
+    const String long_needle = String(40, 'x') + "," + String(40, 'x') + "z";
+    for (const String &needle : {String{"xxxxxxxxxxxxxxxxz"}, long_needle}) {
+        println("needle of {} bytes", needle.size());
+        bench("std::string_view::find", text.size(), [&] {
+            return std::string_view{text}.find(needle);
+        });
+        bench("find", text.size(),
+              [&] { return find(needle, text).value_or(0); });
+    }
+
+    println("replace(\",\", \";\")");
+    bench("per-byte starts_with", text.size(),
+          [&] { return replace_bytewise(text, ",", ";").size(); });
+    bench("replace", text.size(),
+          [&] { return replace(text, ",", ";").size(); });
+    println("replace(\"xxxxx\", \"-\")");
+    bench("per-byte starts_with", text.size(),
+          [&] { return replace_bytewise(text, "xxxxx", "-").size(); });
+    bench("replace", text.size(),
+          [&] { return replace(text, "xxxxx", "-").size(); });
+}
+
+auto bench_case() {
+    const String text = make_text(BENCH_BYTES);
+    println("case: {} MiB", text.size() >> 20);
+    // What `to_lowercase()` did before it moved onto the scan core.
+    auto lowercase_bytewise = [](const std::string_view input) {
+        String output{input};
+        for (auto &it : output) {
+            it = tolower(it);
+        }
+        return output;
+    };
+    bench("per-byte tolower", text.size(),
+          [&] { return lowercase_bytewise(text).size(); });
+    bench("to_lowercase", text.size(),
+          [&] { return to_lowercase(text).size(); });
+    String buffer = text;
+    bench("make_lowercase", text.size(), [&] {
+        make_lowercase(buffer);
+        return buffer.size();
+    });
+
+    // Header names, matched the way a request parser would.
+    const Vec<String> names = {"Content-Type", "content-length",
+                               "ACCEPT-ENCODING", "X-Forwarded-For",
+                               "Cache-Control", "Authorization"};
+    Vec<String> headers     = {};
+    size_t bytes            = 0;
+    for (size_t i = 0; i < 1'000'000; i++) {
+        headers.push_back(names[i % names.size()]);
+        bytes += headers.back().size();
+    }
+    println("{} header names", headers.size());
+    bench("lowercase copy ==", bytes, [&] {
+        size_t found = 0;
+        for (const auto &it : headers) {
+            found += lowercase_bytewise(it) == "content-length";
+        }
+        return found;
+    });
+    bench("iequals", bytes, [&] {
+        size_t found = 0;
+        for (const auto &it : headers) {
+            found += iequals("content-length", it);
+        }
+        return found;
+    });
+}
+
+auto bench_charset() {
+    const String text = make_text(BENCH_BYTES);
+    println("charset: {} MiB", text.size() >> 20);
+
+    // Counting tokens the way a caller would without a CharSet: a predicate
+    // per byte.
+    for (const String &chars : {String{","}, String{" \t\r\n,;"},
+                                String{" \t\r\n,;:.!?()[]{}<>\"'`|/\\-+=*&"}}) {
+        println("{} delimiters", chars.size());
+        bench("predicate loop", text.size(), [&] {
+            size_t tokens = 0;
+            bool in_token = false;
+            for (const char c : text) {
+                const bool delim = chars.find(c) != String::npos;
+                tokens += !delim and !in_token;
+                in_token = !delim;
+            }
+            return tokens;
+        });
+        const CharSet set{chars};
+        bench("split_any_view", text.size(),
+              [&] { return split_any_view(set, text).count(); });
+    }
+    bench("words_view", text.size(),
+          [&] { return words_view(text).count(); });
+}
+
+auto bench_shell() {
+    // Audit-log style command lines, a few with quoting.
+    const Vec<String> samples = {
+        "/usr/bin/ls -la --color=auto /var/log/nginx\n",
+        "sudo systemctl restart postgresql.service\n",
+        "grep -rn \"connection refused\" /var/log/syslog\n",
+        "find /home/deploy -name '*.tmp' -mtime +7 -delete\n",
+        "tar -czf backup-2024.tar.gz /etc/nginx /etc/ssh\n",
+        "echo it\\'s \"a \\\"quoted\\\" word\" >> notes.txt\n",
+        "curl -s -H 'Accept: application/json' https://example.com/api\n",
+        "python3 manage.py migrate --database=default --noinput\n",
+    };
+    String text = {};
+    text.reserve(BENCH_BYTES / 4 + 128);
+    for (size_t i = 0; text.size() < BENCH_BYTES / 4; i++) {
+        text += samples[i * 7 % samples.size()];
+    }
+    const Vec<StringV> lines = lines_view(text).to_vec();
+    println("shell: {} MiB, {} lines", text.size() >> 20, lines.size());
+
+    bench("string_break", text.size(), [&] {
+        size_t words = 0;
+        for (const StringV line : lines) { words += string_break(line).size(); }
+        return words;
+    });
+    bench("shell_split", text.size(), [&] {
+        size_t words = 0;
+        for (const StringV line : lines) {
+            words += shell_split(line).words.size();
+        }
+        return words;
+    });
+    bench("ShellSplitter", text.size(), [&] {
+        ShellSplitter splitter = {};
+        size_t words           = 0;
+        for (const StringV line : lines) {
+            words += splitter.split(line).size();
+        }
+        return words;
+    });
+    bench("for_each_shell_line", text.size(), [&] {
+        std::istringstream input{text};
+        size_t words = 0;
+        for_each_shell_line(
+            [&](const Vec<StringV> &line) { words += line.size(); }, input);
+        return words;
+    });
+}
+
+auto bench_utf8() {
+    const String sample = "Grüße, Jürgen! Привет, мир. 你好，世界。مرحبا "
+                          "بالعالم 🎉🚀 and some plain ASCII to go with it.\n";
+    String text = {};
+    text.reserve(BENCH_BYTES + sample.size());
+    while (text.size() < BENCH_BYTES) { text += sample; }
+    println("utf8: {} MiB of mixed scripts", text.size() >> 20);
+
+    for (auto impl : {ScanImpl::Scalar, ScanImpl::Auto}) {
+        set_scan_impl(impl);
+        bench(format("utf8_validate ({})", scan_impl()), text.size(),
+              [&] { return static_cast<size_t>(utf8_validate(text)); });
+        bench(format("char_count ({})", scan_impl()), text.size(),
+              [&] { return char_count(text); });
+    }
+
+    const std::string_view prefix = std::string_view{text}.substr(0, 1 << 20);
+    const size_t chars            = char_count(prefix);
+    const size_t slices           = 10'000;
+    println("{} slices of 1 MiB", slices);
+    bench("char_slice", prefix.size() * slices, [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < slices; i++) {
+            const size_t start = i * 7919 % chars;
+            total += char_slice(start, start + 10, prefix).size();
+        }
+        return total;
+    });
+    bench("Utf8Index", prefix.size() * slices, [&] {
+        const Utf8Index index{prefix};
+        size_t total = 0;
+        for (size_t i = 0; i < slices; i++) {
+            const size_t start = i * 7919 % chars;
+            total += char_slice(start, start + 10, index).size();
+        }
+        return total;
+    });
+}
+
+auto bench_multi_replace() {
+    std::mt19937 rng{42};
+    // Log lines with a secret in roughly one in eight.
+    auto make_log = [&](const Vec<String> &secrets) {
+        String output = {};
+        output.reserve(BENCH_BYTES / 4);
+        for (size_t i = 0; output.size() < BENCH_BYTES / 4; i++) {
+            output += format("{} INFO request took {} ms", i, rng() % 500);
+            if (rng() % 8 == 0) {
+                output += " auth=" + secrets[rng() % secrets.size()];
+            }
+            output += '\n';
+        }
+        return output;
+    };
+
+    for (const size_t count : {4, 16, 64}) {
+        Vec<String> secrets = {};
+        for (size_t i = 0; i < count; i++) {
+            secrets.push_back(format("sk_{:x}_{}", rng(), i));
+        }
+        const String log = make_log(secrets);
+        println("scrub {} secrets from {} MiB", count, log.size() >> 20);
+
+        bench("sequential replace()", log.size(), [&] {
+            String output = log;
+            for (const auto &it : secrets) {
+                output = replace(output, it, "[redacted]");
+            }
+            return output.size();
+        });
+        const MultiSearcher searcher{secrets};
+        const Vec<String> redacted(count, "[redacted]");
+        bench("replace_all()", log.size(), [&] {
+            return replace_all(searcher, redacted, log).size();
+        });
+    }
+}
+
+auto bench_regex() {
+    const size_t count = 100'000;
+    std::mt19937 rng{42};
+    const Vec<String> levels = {"INFO", "DEBUG", "WARN", "ERROR"};
+    Vec<String> lines        = {};
+    size_t bytes             = 0;
+    for (size_t i = 0; i < count; i++) {
+        lines.push_back(format("2024-01-{:02} {} worker-{} handled request {} "
+                               "in {}ms",
+                               1 + rng() % 28, levels[rng() % 4], rng() % 16,
+                               rng(), rng() % 5000));
+        bytes += lines.back().size();
+    }
+    const String pattern = "(WARN|ERROR) worker-\\d+ .* in \\d{4}ms$";
+    println("regex: {} lines, {}", count, pattern);
+
+    const auto count_matching = [&](auto matches) {
+        return static_cast<size_t>(
+            std::count_if(lines.begin(), lines.end(), matches));
+    };
+
+    bench("std::regex per call", bytes, [&] {
+        return count_matching([&](const auto &it) {
+            return std::regex_search(it, std::regex(pattern));
+        });
+    });
+    const std::regex compiled{pattern};
+    bench("std::regex compiled once", bytes, [&] {
+        return count_matching(
+            [&](const auto &it) { return std::regex_search(it, compiled); });
+    });
+    bench("re_search(string)", bytes, [&] {
+        return count_matching(
+            [&](const auto &it) { return re_search(pattern, it); });
+    });
+    const Regex re{pattern};
+    bench("re_search(Regex)", bytes, [&] {
+        return count_matching(
+            [&](const auto &it) { return re_search(re, it); });
+    });
+}
+
+// What `retain()` used to do, with its erase call fixed: gather the indices
+// to drop, then erase them one at a time from the back.
+template <typename T, typename Predicate>
+auto retain_by_erase(Predicate pred, Vec<T> &input) -> size_t {
+    Vec<size_t> remove_indices = {};
+    for (size_t i = 0; i < input.size(); i++) {
+        if (!pred(input[i])) { remove_indices.push_back(i); }
+    }
+    for (size_t i = 0; i < remove_indices.size(); i++) {
+        input.erase(input.begin()
+                    + remove_indices[remove_indices.size() - 1 - i]);
+    }
+    return remove_indices.size();
+}
+
+auto bench_retain() {
+    std::mt19937 rng{42};
+    auto make_input = [&](const size_t size) {
+        Vec<u32> input(size);
+        for (auto &it : input) {
+            it = rng() % 1000;
+        }
+        return input;
+    };
+    auto keep = [](u32 it) { return it % 2 == 0; };
+
+    // Erasing one at a time is quadratic, so it only gets a small input.
+    const size_t small         = 100'000;
+    const Vec<u32> small_input = make_input(small);
+    println("retain: half of {} elements", small);
+    bench("erase per element", small * sizeof(u32), [&] {
+        Vec<u32> input = small_input;
+        return retain_by_erase(keep, input);
+    });
+    bench("retain", small * sizeof(u32), [&] {
+        Vec<u32> input = small_input;
+        return retain(keep, input);
+    });
+
+    const size_t size    = 10'000'000;
+    const Vec<u32> large = make_input(size);
+    const size_t bytes   = size * sizeof(u32);
+    println("retain family: {} elements", size);
+    bench("retain", bytes, [&] {
+        Vec<u32> input = large;
+        return retain(keep, input);
+    });
+    bench("drain_filter", bytes, [&] {
+        Vec<u32> input = large;
+        return drain_filter(keep, input).size();
+    });
+    bench("dedup_by_key", bytes, [&] {
+        Vec<u32> input = large;
+        return dedup_by_key([](u32 it) { return it / 100; }, input);
+    });
+    bench("partition, consuming", bytes, [&] {
+        Vec<u32> input = large;
+        return partition(keep, std::move(input)).first.size();
+    });
+}
+
+auto bench_join() {
+    const size_t records = 200'000;
+    std::mt19937 rng{42};
+    Vec<Vec<String>> fields(records);
+    size_t bytes = 0;
+    for (auto &record : fields) {
+        for (size_t i = 0; i < 12; i++) {
+            record.emplace_back(4 + rng() % 20, char('a' + rng() % 26));
+            bytes += record.back().size();
+        }
+    }
+    println("join: {} records of 12 fields", records);
+
+    bench("+= in a loop", bytes, [&] {
+        size_t total = 0;
+        for (const auto &record : fields) {
+            String line = {};
+            for (size_t i = 0; i < record.size(); i++) {
+                if (i != 0) { line += ", "; }
+                line += record[i];
+            }
+            total += line.size();
+        }
+        return total;
+    });
+    bench("ostringstream", bytes, [&] {
+        size_t total = 0;
+        for (const auto &record : fields) {
+            std::ostringstream line;
+            for (size_t i = 0; i < record.size(); i++) {
+                if (i != 0) { line << ", "; }
+                line << record[i];
+            }
+            total += line.str().size();
+        }
+        return total;
+    });
+    bench("join()", bytes, [&] {
+        size_t total = 0;
+        for (const auto &record : fields) {
+            total += join(", ", record).size();
+        }
+        return total;
+    });
+
+    const size_t parts = 64;
+    Vec<Vec<u32>> pieces(parts);
+    size_t elements = 0;
+    for (auto &piece : pieces) {
+        piece.resize(1000 + rng() % 100'000);
+        elements += piece.size();
+    }
+    println("concat: {} vectors, {} elements", parts, elements);
+    // Each builds 8 outputs from 8 pieces apiece.
+    bench("push_back in a loop", elements * sizeof(u32), [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < parts; i += 8) {
+            Vec<u32> output = {};
+            for (size_t j = i; j < i + 8; j++) {
+                for (auto it : pieces[j]) {
+                    output.push_back(it);
+                }
+            }
+            total += output.size();
+        }
+        return total;
+    });
+    bench("append() in a loop", elements * sizeof(u32), [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < parts; i += 8) {
+            Vec<u32> output = {};
+            for (size_t j = i; j < i + 8; j++) {
+                append(output, pieces[j]);
+            }
+            total += output.size();
+        }
+        return total;
+    });
+    bench("concat()", elements * sizeof(u32), [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < parts; i += 8) {
+            total += concat(pieces[i], pieces[i + 1], pieces[i + 2],
+                            pieces[i + 3], pieces[i + 4], pieces[i + 5],
+                            pieces[i + 6], pieces[i + 7])
+                         .size();
+        }
+        return total;
+    });
+}
+
+auto bench_hash() {
+    const size_t size = 1'000'000;
+    std::mt19937_64 rng{42};
+    Vec<u64> keys(size);
+    for (auto &it : keys) {
+        it = rng();
+    }
+    // Half present, half not.
+    Vec<u64> probes(size);
+    for (size_t i = 0; i < size; i++) {
+        probes[i] = i % 2 == 0 ? keys[rng() % size] : rng();
+    }
+    const size_t bytes = size * sizeof(u64);
+    println("hash: {} u64 keys", size);
+
+    bench("unordered_map insert", bytes, [&] {
+        std::unordered_map<u64, u64> map = {};
+        for (auto it : keys) {
+            map[it] = it;
+        }
+        return map.size();
+    });
+    bench("HashMap insert", bytes, [&] {
+        HashMap<u64, u64> map = {};
+        for (auto it : keys) {
+            map[it] = it;
+        }
+        return map.size();
+    });
+
+    std::unordered_map<u64, u64> std_map = {};
+    HashMap<u64, u64> flat_map           = {};
+    for (auto it : keys) {
+        std_map[it]  = it;
+        flat_map[it] = it;
+    }
+    bench("unordered_map find", bytes, [&] {
+        size_t found = 0;
+        for (auto it : probes) {
+            found += std_map.find(it) != std_map.end();
+        }
+        return found;
+    });
+    bench("HashMap find", bytes, [&] {
+        size_t found = 0;
+        for (auto it : probes) {
+            found += flat_map.find(it) != nullptr;
+        }
+        return found;
+    });
+
+    // Looking up slices of a buffer, as a parser would.
+    Vec<String> names(100'000);
+    String text = {};
+    for (size_t i = 0; i < names.size(); i++) {
+        names[i] = format("field_name_{}", rng() % 1'000'000);
+        text += names[i];
+        text += ' ';
+    }
+    Vec<StringV> views = {};
+    for (const auto &it : split_view(' ', text)) {
+        views.push_back(it);
+    }
+    std::unordered_map<String, size_t> std_names = {};
+    HashMap<String, size_t> flat_names           = {};
+    for (size_t i = 0; i < names.size(); i++) {
+        std_names[names[i]]  = i;
+        flat_names[names[i]] = i;
+    }
+    println("string_view lookups: {} names", names.size());
+    bench("unordered_map<String>", text.size(), [&] {
+        size_t found = 0;
+        for (auto it : views) {
+            found += std_names.count(String{it});
+        }
+        return found;
+    });
+    bench("HashMap<String>", text.size(), [&] {
+        size_t found = 0;
+        for (auto it : views) {
+            found += flat_names.contains(it);
+        }
+        return found;
+    });
+
+    const size_t small = 20'000;
+    Vec<u64> left(keys.begin(), keys.begin() + small);
+    Vec<u64> right(probes.begin(), probes.begin() + small);
+    println("intersection: {} x {} elements", small, small);
+    bench("find() in a loop", small * sizeof(u64), [&] {
+        size_t found = 0;
+        for (auto it : right) {
+            found += find(it, left).has_value();
+        }
+        return found;
+    });
+    bench("intersection()", small * sizeof(u64),
+          [&] { return intersection(left, right).size(); });
+    bench("unique()", bytes, [&] { return unique(probes).size(); });
+    bench("counts()", bytes, [&] { return counts(probes).size(); });
+}
+
+auto bench_slice() {
+    const size_t size = 10'000'000;
+    Vec<u32> input(size);
+    std::mt19937 rng{42};
+    for (auto &it : input) {
+        it = rng() % 1000;
+    }
+    const size_t bytes = size * sizeof(u32);
+    const size_t batch = 4096;
+    println("slice: {} elements in batches of {}", size, batch);
+
+    auto add = [](u64 acc, u32 it) { return acc + it; };
+    // Before chunks(), a batch was copied out to hand it to a helper.
+    bench("copied batches", bytes, [&] {
+        u64 total = 0;
+        for (size_t start = 0; start < size; start += batch) {
+            const size_t end = start + batch < size ? start + batch : size;
+            const Vec<u32> part(input.begin() + start, input.begin() + end);
+            total += fold(u64{0}, add, part);
+        }
+        return total;
+    });
+    bench("chunks()", bytes, [&] {
+        u64 total = 0;
+        for (auto part : Slice{input}.chunks(batch)) {
+            total += fold(u64{0}, add, part);
+        }
+        return total;
+    });
+    bench("windows(8)", bytes, [&] {
+        u64 best = 0;
+        for (auto window : Slice{input}.windows(8)) {
+            const u64 sum = fold(u64{0}, add, window);
+            best          = sum > best ? sum : best;
+        }
+        return best;
+    });
+}
+
+auto bench_parallel() {
+    const size_t size = 10'000'000;
+    Vec<u32> input(size);
+    std::mt19937 rng{42};
+    for (auto &it : input) {
+        it = rng() % 1000;
+    }
+    const size_t bytes = size * sizeof(u32);
+    println("parallel: {} elements, {} hardware threads", size,
+            std::thread::hardware_concurrency());
+
+    // A few rounds of mixing, so there's some work per element to share out.
+    auto mix = [](u32 it) {
+        u64 x = it;
+        for (int i = 0; i < 8; i++) {
+            x = (x ^ (x >> 29)) * 0xbf58476d1ce4e5b9u;
+        }
+        return x;
+    };
+    auto rare = [&](u32 it) { return mix(it) % 64 == 0; };
+    auto add  = [&](u64 acc, u32 it) { return acc + mix(it); };
+    auto plus = [](u64 a, u64 b) { return a + b; };
+    // Only the last element matches, so every find scans the whole input.
+    input.back()   = 1000;
+    auto last_only = [&](u32 it) { return mix(it) != 0 and it == 1000; };
+
+    bench("serial fmap", bytes, [&] {
+        Vec<u64> output(size);
+        for (size_t i = 0; i < size; i++) {
+            output[i] = mix(input[i]);
+        }
+        return output.size();
+    });
+    bench("serial filter", bytes, [&] { return filter(rare, input).size(); });
+    bench("serial fold", bytes, [&] { return fold(u64{0}, add, input); });
+    bench("serial find", bytes, [&] {
+        for (size_t i = 0; i < size; i++) {
+            if (last_only(input[i])) { return i; }
+        }
+        return size;
+    });
+
+    const size_t hardware = std::thread::hardware_concurrency();
+    for (size_t threads = 1; threads <= (hardware > 4 ? hardware : 4);
+         threads *= 2) {
+        ThreadPool pool{threads};
+        println("{} threads", threads);
+        bench("par_fmap", bytes,
+              [&] { return par_fmap(pool, mix, input).size(); });
+        bench("par_filter", bytes,
+              [&] { return par_filter(pool, rare, input).size(); });
+        bench("par_fold", bytes,
+              [&] { return par_fold(pool, u64{0}, add, plus, input); });
+        bench("par_find", bytes, [&] {
+            return par_find(pool, last_only, input).value_or(size);
+        });
+    }
+}
+
+auto bench_lazy() {
+    const size_t size = 10'000'000;
+    Vec<u32> input(size);
+    std::mt19937 rng{42};
+    for (auto &it : input) {
+        it = rng() % 1000;
+    }
+    const size_t bytes = size * sizeof(u32);
+    println("lazy: {} elements", size);
+
+    auto keep   = [](auto it) { return it >= 2; };
+    auto triple = [](auto it) { return it * 3; };
+    // Never false, so both chains have to walk the whole input.
+    auto small = [](auto it) { return it < 3000; };
+
+    println("take_while(fmap(filter())) over everything");
+    bench("eager", bytes, [&] {
+        return take_while(small, fmap<u32, u32>(triple, filter(keep, input)))
+            .size();
+    });
+    bench("lazy", bytes, [&] {
+        return lazy::collect(lazy::take_while(
+                                 small, lazy::fmap(triple,
+                                                   lazy::filter(keep, input))))
+            .size();
+    });
+
+    println("first three matches");
+    bench("eager", bytes, [&] {
+        auto all = fmap<u32, u32>(triple, filter(keep, input));
+        return Vec<u32>(all.begin(), all.begin() + 3).size();
+    });
+    bench("lazy", bytes, [&] {
+        return lazy::collect(
+                   lazy::take(3, lazy::fmap(triple, lazy::filter(keep, input))))
+            .size();
+    });
+
+    // Both sides build the words, so the difference is what the chain costs.
+    const size_t count = 1'000'000;
+    println("fmap(filter()) on {} owned strings", count);
+    auto make_words = [&] {
+        Vec<String> words(count);
+        for (size_t i = 0; i < count; i++) {
+            words[i] = String(24 + input[i] % 8, char('a' + input[i] % 26));
+        }
+        return words;
+    };
+    auto not_z = [](const String &it) { return it[0] != 'z'; };
+    auto shout = [](String it) {
+        it[0] = char(it[0] - 'a' + 'A');
+        return it;
+    };
+    const size_t words_bytes = count * 28;
+    bench("copying", words_bytes, [&] {
+        const Vec<String> words = make_words();
+        return fmap<String, String>(shout, filter(not_z, words)).size();
+    });
+    bench("consuming", words_bytes, [&] {
+        Vec<String> words = make_words();
+        return fmap<String, String>(shout, filter(not_z, std::move(words)))
+            .size();
+    });
+}
+
+auto bench_parse() {
+    const size_t count = 10'000'000;
+    std::mt19937_64 rng{42};
+    String text = {};
+    text.reserve(count * 12);
+    for (size_t i = 0; i < count; i++) {
+        const i64 value = static_cast<i64>(rng() % 2'000'000'000);
+        text += std::to_string(value - 1'000'000'000);
+        text += '\n';
+    }
+    println("parse: {} numbers, {} MiB", count, text.size() >> 20);
+
+    bench("stoll over split()", text.size(), [&] {
+        Vec<i64> output = {};
+        for (const auto &it : split(text, '\n')) {
+            try {
+                output.push_back(std::stoll(it));
+            } catch (...) {}
+        }
+        return output.size();
+    });
+    bench("parse_i64 over split()", text.size(), [&] {
+        Vec<i64> output = {};
+        for (const auto &it : split(text, '\n')) {
+            if (auto value = parse_i64(it); value) {
+                output.push_back(value.value());
+            }
+        }
+        return output.size();
+    });
+    bench("parse_i64 over split_view()", text.size(), [&] {
+        Vec<i64> output = {};
+        for (const auto &it : split_view('\n', text)) {
+            if (auto value = parse_i64(it); value) {
+                output.push_back(value.value());
+            }
+        }
+        return output.size();
+    });
+    bench("parse_column<i64>", text.size(),
+          [&] { return parse_column<i64>('\n', text).values.size(); });
+}
+
+auto bench_csv() {
+    // An export with ids, prices, and a quoted text column that sometimes
+    // holds commas and escaped quotes.
+    const Vec<String> notes = {"plain", "\"with, comma\"",
+                               "\"say \"\"hi\"\"\"", "\"multi\nline\""};
+    std::mt19937_64 rng{42};
+    String text = "id,price,note,qty\n";
+    text.reserve(BENCH_BYTES + 64);
+    while (text.size() < BENCH_BYTES) {
+        text += std::to_string(rng() % 1'000'000'000);
+        text += ',';
+        text += std::to_string(rng() % 100'000);
+        text += ".25,";
+        text += notes[rng() % 64 == 0 ? rng() % notes.size() : 0];
+        text += ',';
+        text += std::to_string(rng() % 1000);
+        text += '\n';
+    }
+    println("csv: {} MiB", text.size() >> 20);
+
+    bench("split() lines and fields", text.size(), [&] {
+        Vec<Vec<String>> rows = {};
+        for (const auto &line : split(text, '\n')) {
+            rows.push_back(split(line, ','));
+        }
+        return rows.size();
+    });
+    bench("CsvReader rows", text.size(), [&] {
+        CsvReader reader{text};
+        size_t fields = 0;
+        while (auto row = reader.next()) { fields += row->size(); }
+        return fields;
+    });
+    std::istringstream stream{text};
+    bench("CsvReader rows from a stream", text.size(), [&] {
+        stream.clear();
+        stream.seekg(0);
+        CsvReader reader{stream};
+        size_t fields = 0;
+        while (auto row = reader.next()) { fields += row->size(); }
+        return fields;
+    });
+    bench("csv_column<i64>", text.size(), [&] {
+        CsvReader reader{text};
+        return csv_column<i64>("id", reader).values.size();
+    });
+    bench("csv_column<f64>", text.size(), [&] {
+        CsvReader reader{text};
+        return csv_column<f64>("price", reader).values.size();
+    });
+}
+
+auto bench_arena() {
+    // A request's worth of small strings, again and again: split a header
+    // block, rewrite a field and format a log line.
+    const String request = "GET /index.html HTTP/1.1\nHost: example.com\n"
+                           "Accept: text/html,application/xml\n"
+                           "User-Agent: bench/1.0\nConnection: keep-alive\n";
+    const size_t requests = 200'000;
+    println("arena: {} requests of {} bytes", requests, request.size());
+
+    bench("heap", request.size() * requests, [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < requests; i++) {
+            auto rows   = lines(request);
+            auto fields = split(rows[2], ',');
+            auto host   = replace(rows[1], "example", "test");
+            total += rows.size() + fields.size() + host.size()
+                   + format("{} {} {}", i, rows[0], fields.size()).size();
+        }
+        return total;
+    });
+    Arena arena{};
+    bench("Arena, reset per request", request.size() * requests, [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < requests; i++) {
+            arena.reset();
+            auto rows   = lines(arena, request);
+            auto fields = split(arena, rows[2], ',');
+            auto host   = replace(arena, rows[1], "example", "test");
+            total += rows.size() + fields.size() + host.size()
+                   + format(arena, "{} {} {}", i, rows[0], fields.size())
+                         .size();
+        }
+        return total;
+    });
+}
+
+// The recursive formatter `format()` used before it parsed fields in one pass.
+template <typename T>
+auto format_recursive(const std::string_view fmt_string, T input)
+    -> std::string {
+    auto it = find("{}", fmt_string);
+    if (!it) { return std::string{fmt_string}; }
+    std::ostringstream oss;
+    oss << fmt_string.substr(0, it.value()) << input
+        << fmt_string.substr(it.value() + 2);
+    return oss.str();
+}
+
+template <typename T, typename... Args>
+auto format_recursive(const std::string_view fmt_string, T first,
+                      Args... rest) -> std::string {
+    return format_recursive(format_recursive(fmt_string, first), rest...);
+}
+
+auto bench_format() {
+    const size_t count = 1'000'000;
+    println("format: {} log lines", count);
+
+    // Bytes of output, for the throughput column.
+    const String line  = format("request {} took {} ms from {}", 0, 1.5, "host");
+    const size_t bytes = count * line.size();
+    bench("recursive format", bytes, [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++) {
+            total += format_recursive("request {} took {} ms from {}", i % 10,
+                                      1.5, "host")
+                         .size();
+        }
+        return total;
+    });
+    bench("format", bytes, [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++) {
+            total += format("request {} took {} ms from {}", i % 10, 1.5,
+                            "host")
+                         .size();
+        }
+        return total;
+    });
+    bench("format(kfmt())", bytes, [&] {
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++) {
+            total += format(kfmt("request {} took {} ms from {}"), i % 10, 1.5,
+                            "host")
+                         .size();
+        }
+        return total;
+    });
+    bench("format_to(kfmt()) into one buffer", bytes, [&] {
+        size_t total  = 0;
+        String buffer = {};
+        for (size_t i = 0; i < count; i++) {
+            buffer.clear();
+            format_to(buffer, kfmt("request {} took {} ms from {}"), i % 10,
+                      1.5, "host");
+            total += buffer.size();
+        }
+        return total;
+    });
+}
+
+// How a vector printed before it went through to_chars().
+template <typename T>
+auto print_vec_streamed(std::ostream &os, const Vec<T> &input) -> void {
+    os << "Vec { ";
+    for (size_t i = 0; i < input.size(); i++) {
+        if constexpr (sizeof(T) == 1) {
+            os << std::to_string(input[i]);
+        } else {
+            os << input[i];
+        }
+        if (i != input.size() - 1) { os << ", "; }
+    }
+    os << " }";
+}
+
+template <typename T>
+auto bench_print_vec(const std::string_view name, const Vec<T> &input) {
+    std::ostringstream probe;
+    probe << input;
+    const size_t bytes = probe.str().size();
+    println("print Vec<{}>: {} elements, {} MiB", name, input.size(),
+            bytes >> 20);
+
+    bench("per-element ostream", bytes, [&] {
+        std::ostringstream oss;
+        print_vec_streamed(oss, input);
+        return oss.str().size();
+    });
+    bench("operator<<", bytes, [&] {
+        std::ostringstream oss;
+        oss << input;
+        return oss.str().size();
+    });
+}
+
+auto bench_numbers() {
+    const size_t count = 5'000'000;
+    std::mt19937_64 rng{42};
+    Vec<u8> bytes(count);
+    Vec<i64> ints(count);
+    Vec<f64> floats(count);
+    for (size_t i = 0; i < count; i++) {
+        bytes[i]  = static_cast<u8>(rng());
+        ints[i]   = static_cast<i64>(rng() >> (rng() % 64));
+        floats[i] = std::uniform_real_distribution<f64>{-1e6, 1e6}(rng);
+    }
+    bench_print_vec("u8", bytes);
+    bench_print_vec("i64", ints);
+    bench_print_vec("f64", floats);
+
+    println("format(\"{}\") of a random double");
+    const size_t bytes_out = count * 18;
+    bench("ostringstream << setprecision(17)", bytes_out, [&] {
+        size_t total = 0;
+        for (const f64 it : floats) {
+            std::ostringstream oss;
+            oss << std::setprecision(17) << it;
+            total += oss.str().size();
+        }
+        return total;
+    });
+    bench("to_chars shortest", bytes_out, [&] {
+        size_t total = 0;
+        char buffer[32];
+        for (const f64 it : floats) {
+            total += to_chars(std::begin(buffer), std::end(buffer), it).ptr
+                   - buffer;
+        }
+        return total;
+    });
+}
+
+auto bench_print() {
+    const size_t count = 1'000'000;
+    println("println: {} lines into a file", count);
+
+    // Timing lines still reach the terminal; only the measured println calls
+    // land in the scratch file.
+    char path[]         = "/tmp/khelper_bench_XXXXXX";
+    const int file      = mkstemp(path);
+    const int stdout_fd = dup(1);
+    auto run = [&](const PrintMode mode, const size_t threads) {
+        set_print_mode(mode);
+        dup2(file, 1);
+        Vec<std::thread> workers = {};
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                for (size_t i = t; i < count; i += threads) {
+                    println("request {} handled by worker {}", i, t);
+                }
+            });
+        }
+        for (auto &it : workers) {
+            it.join();
+        }
+        flush_output();
+        dup2(stdout_fd, 1);
+        set_print_mode(PrintMode::Async);
+        return count;
+    };
+    const size_t bytes = count * 36;
+    for (const size_t threads : {1, 4}) {
+        bench(format("Sync, {} threads", threads), bytes,
+              [&] { return run(PrintMode::Sync, threads); });
+        bench(format("Async, {} threads", threads), bytes,
+              [&] { return run(PrintMode::Async, threads); });
+    }
+    close(stdout_fd);
+    close(file);
+    unlink(path);
+}
+
+int main() {
+    // clang-format off
+    if (BENCH_SCAN)  { bench_scan();  }
+    if (BENCH_FIND)  { bench_find();  }
+    if (BENCH_CASE)  { bench_case();  }
+    if (BENCH_SET)   { bench_charset(); }
+    if (BENCH_UTF8)  { bench_utf8();  }
+    if (BENCH_SHELL) { bench_shell(); }
+    if (BENCH_MULTI) { bench_multi_replace(); }
+    if (BENCH_REGEX) { bench_regex(); }
+    if (BENCH_LAZY)  { bench_lazy();  }
+    if (BENCH_SLICE) { bench_slice(); }
+    if (BENCH_PRUNE) { bench_retain(); }
+    if (BENCH_JOIN)  { bench_join();  }
+    if (BENCH_HASH)  { bench_hash();  }
+    if (BENCH_PAR)   { bench_parallel(); }
+    if (BENCH_PARSE) { bench_parse(); }
+    if (BENCH_CSV)   { bench_csv();   }
+    if (BENCH_ARENA) { bench_arena(); }
+    if (BENCH_FMT)   { bench_format(); }
+    if (BENCH_NUM)   { bench_numbers(); }
+    if (BENCH_PRINT) { bench_print(); }
+    // clang-format on
+    return 0;
+}
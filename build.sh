@@ -5,11 +5,15 @@ if [[ ! -d output ]]; then
     mkdir output
 fi
 
-g++ -g -O3 -fPIC -std=c++17 -Wall -Wextra -Werror --shared khelper.cpp -o output/libkhelper.so \
+g++ -g -O3 -fPIC -std=c++17 -pthread -Wall -Wextra -Werror --shared khelper.cpp -o output/libkhelper.so \
     && cp khelper.hpp output/
 
 if [[ $1 != "-l" || $1 != "--lib" ]]; then
-    g++ -g -O3 -std=c++17 test.cpp -Loutput -lkhelper -o exe_test \
+    g++ -g -O3 -std=c++17 -pthread test.cpp -Loutput -lkhelper -o exe_test \
         && LD_LIBRARY_PATH=output ./exe_test
 fi
 
+if [[ $1 == "-b" || $1 == "--bench" ]]; then
+    g++ -g -O3 -std=c++17 -pthread bench.cpp -Loutput -lkhelper -o exe_bench \
+        && LD_LIBRARY_PATH=output ./exe_bench
+fi
@@ -1,327 +1,4927 @@
 #include "khelper.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <list>
+#include <mutex>
 #include <optional>
 #include <regex>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KHELPER_X86 1
+#include <immintrin.h>
+#endif
+
 namespace khelper {
-/// PARSE
-auto parse_i32(const std::string &input) -> std::optional<int32_t> {
-    try {
-        return std::stol(input);
-    } catch (...) { return {}; }
+/// RESULT
+auto operator<<(std::ostream &os, const Error &rhs) -> std::ostream & {
+    os << "Error { .message = \"" << rhs.message << "\", .code = " << rhs.code
+       << " }";
+    return os;
 }
-auto parse_i64(const std::string &input) -> std::optional<int64_t> {
-    try {
-        return std::stoll(input);
-    } catch (...) { return {}; }
+
+/// PARSE
+auto operator<<(std::ostream &os, const ParseError &rhs) -> std::ostream & {
+    switch (rhs) {
+    case ParseError::Empty: return os << "Empty";
+    case ParseError::InvalidDigit: return os << "InvalidDigit";
+    case ParseError::Overflow: return os << "Overflow";
+    case ParseError::Underflow: return os << "Underflow";
+    case ParseError::TrailingCharacters: return os << "TrailingCharacters";
+    }
+    return os;
 }
-auto parse_u32(const std::string &input) -> std::optional<uint32_t> {
-    try {
-        return std::stoul(input);
-    } catch (...) { return {}; }
+
+namespace detail {
+// The number is 0.d... times 10^(scale + exponent), where `scale` counts
+// the integer digits after leading zeros, or the zeros after the point when
+// there are none.
+auto is_below_one(const std::string_view number) -> bool {
+    size_t i = 0;
+    if (i < number.size() and (number[i] == '-' or number[i] == '+')) { i++; }
+    i64 scale        = 0;
+    bool significant = false;
+    for (; i < number.size() and number[i] >= '0' and number[i] <= '9'; i++) {
+        significant = significant or number[i] != '0';
+        if (significant) { scale++; }
+    }
+    if (i < number.size() and number[i] == '.') {
+        for (i++; i < number.size() and number[i] >= '0' and number[i] <= '9';
+             i++) {
+            significant = significant or number[i] != '0';
+            if (!significant) { scale--; }
+        }
+    }
+    i64 exponent = 0;
+    if (i < number.size() and (number[i] == 'e' or number[i] == 'E')) {
+        i++;
+        const bool negative = i < number.size() and number[i] == '-';
+        if (i < number.size() and (number[i] == '-' or number[i] == '+')) {
+            i++;
+        }
+        // Saturates well past any float's range.
+        for (; i < number.size() and number[i] >= '0' and number[i] <= '9';
+             i++) {
+            exponent = std::min<i64>(exponent * 10 + (number[i] - '0'),
+                                     i64{1} << 32);
+        }
+        if (negative) { exponent = -exponent; }
+    }
+    return scale + exponent <= 0;
 }
+} // namespace detail
 
-auto parse_u64(const std::string &input) -> std::optional<uint64_t> {
-    try {
-        return std::stoull(input);
-    } catch (...) { return {}; }
+namespace {
+template <typename T>
+auto parse_option(const std::string_view input) -> std::optional<T> {
+    auto output = parse<T>(input);
+    if (!output) { return {}; }
+    return output.value_;
 }
+} // namespace
 
-/// STRING
-// clang-format off
-// Can go to https://gist.github.com/JBlond/2fea43a3049b38287e5e9cefc87b2124
-// if I want to implement more.
-auto black(const std::string_view input)            -> std::string { return "\e[0;30m" + std::string{input} + "\e[0m"; }
-auto red(const std::string_view input)              -> std::string { return "\e[0;31m" + std::string{input} + "\e[0m"; }
-auto green(const std::string_view input)            -> std::string { return "\e[0;32m" + std::string{input} + "\e[0m"; }
-auto yellow(const std::string_view input)           -> std::string { return "\e[0;33m" + std::string{input} + "\e[0m"; }
-auto blue(const std::string_view input)             -> std::string { return "\e[0;34m" + std::string{input} + "\e[0m"; }
-auto purple(const std::string_view input)           -> std::string { return "\e[0;35m" + std::string{input} + "\e[0m"; }
-auto cyan(const std::string_view input)             -> std::string { return "\e[0;36m" + std::string{input} + "\e[0m"; }
-auto white(const std::string_view input)            -> std::string { return "\e[0;37m" + std::string{input} + "\e[0m"; }
-auto black_bold(const std::string_view input)       -> std::string { return "\e[1;30m" + std::string{input} + "\e[0m"; }
-auto red_bold(const std::string_view input)         -> std::string { return "\e[1;31m" + std::string{input} + "\e[0m"; }
-auto green_bold(const std::string_view input)       -> std::string { return "\e[1;32m" + std::string{input} + "\e[0m"; }
-auto yellow_bold(const std::string_view input)      -> std::string { return "\e[1;33m" + std::string{input} + "\e[0m"; }
-auto blue_bold(const std::string_view input)        -> std::string { return "\e[1;34m" + std::string{input} + "\e[0m"; }
-auto purple_bold(const std::string_view input)      -> std::string { return "\e[1;35m" + std::string{input} + "\e[0m"; }
-auto cyan_bold(const std::string_view input)        -> std::string { return "\e[1;36m" + std::string{input} + "\e[0m"; }
-auto white_bold(const std::string_view input)       -> std::string { return "\e[1;37m" + std::string{input} + "\e[0m"; }
-auto black_underline(const std::string_view input)  -> std::string { return "\e[4;30m" + std::string{input} + "\e[0m"; }
-auto red_underline(const std::string_view input)    -> std::string { return "\e[4;31m" + std::string{input} + "\e[0m"; }
-auto green_underline(const std::string_view input)  -> std::string { return "\e[4;32m" + std::string{input} + "\e[0m"; }
-auto yellow_underline(const std::string_view input) -> std::string { return "\e[4;33m" + std::string{input} + "\e[0m"; }
-auto blue_underline(const std::string_view input)   -> std::string { return "\e[4;34m" + std::string{input} + "\e[0m"; }
-auto purple_underline(const std::string_view input) -> std::string { return "\e[4;35m" + std::string{input} + "\e[0m"; }
-auto cyan_underline(const std::string_view input)   -> std::string { return "\e[4;36m" + std::string{input} + "\e[0m"; }
-auto white_underline(const std::string_view input)  -> std::string { return "\e[4;37m" + std::string{input} + "\e[0m"; }
-auto black_bg(const std::string_view input)         -> std::string { return "\e[40m" + std::string{input} + "\e[0m"; }
-auto red_bg(const std::string_view input)           -> std::string { return "\e[41m" + std::string{input} + "\e[0m"; }
-auto green_bg(const std::string_view input)         -> std::string { return "\e[42m" + std::string{input} + "\e[0m"; }
-auto yellow_bg(const std::string_view input)        -> std::string { return "\e[43m" + std::string{input} + "\e[0m"; }
-auto blue_bg(const std::string_view input)          -> std::string { return "\e[44m" + std::string{input} + "\e[0m"; }
-auto purple_bg(const std::string_view input)        -> std::string { return "\e[45m" + std::string{input} + "\e[0m"; }
-auto cyan_bg(const std::string_view input)          -> std::string { return "\e[46m" + std::string{input} + "\e[0m"; }
-auto white_bg(const std::string_view input)         -> std::string { return "\e[47m" + std::string{input} + "\e[0m"; }
-// clang-format on
+auto parse_i32(const std::string_view input) -> std::optional<int32_t> {
+    return parse_option<int32_t>(input);
+}
+auto parse_i64(const std::string_view input) -> std::optional<int64_t> {
+    return parse_option<int64_t>(input);
+}
+auto parse_u32(const std::string_view input) -> std::optional<uint32_t> {
+    return parse_option<uint32_t>(input);
+}
+auto parse_u64(const std::string_view input) -> std::optional<uint64_t> {
+    return parse_option<uint64_t>(input);
+}
+auto parse_f32(const std::string_view input) -> std::optional<float> {
+    return parse_option<float>(input);
+}
+auto parse_f64(const std::string_view input) -> std::optional<double> {
+    return parse_option<double>(input);
+}
 
-auto args_vec(int argc, const char **argv) -> std::vector<std::string> {
-    std::vector<std::string> output = {};
-    for (int i = 0; i < argc; i++) {
-        output.push_back(argv[i]);
+namespace {
+// Bit i is set when data[i] == needle, for the 64 bytes starting at `data`.
+auto byte_mask64(const char *data, const char needle) -> u64 {
+#ifdef KHELPER_X86
+    const __m128i target = _mm_set1_epi8(needle);
+    u64 output           = 0;
+    for (int i = 0; i < 4; i++) {
+        const __m128i block
+            = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i));
+        const u64 mask = static_cast<u32>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(block, target)));
+        output |= mask << (16 * i);
+    }
+    return output;
+#else
+    u64 output = 0;
+    for (int i = 0; i < 64; i++) {
+        output |= u64{data[i] == needle} << i;
     }
     return output;
+#endif
 }
 
-auto string_break(const std::string_view input) -> std::vector<std::string> {
-    std::vector<std::string> output = {};
-    std::string tmp                 = "";
-    bool in_string                  = false;
-    char previous_char_is_backslash = false;
-
-    for (size_t i = 0; i < input.size(); i++) {
-        // Handling backslash
-        if (input[i] == '\\') {
-            // Marking an escape character.
-            previous_char_is_backslash = true;
-            tmp += input[i];
-            continue;
+// Calls func(start, end) for every field, including empty ones between two
+// delimiters, but not for an empty one after a trailing delimiter.
+template <typename F>
+auto for_each_field(const char delim, const std::string_view input, F func)
+    -> void {
+    const char *data = input.data();
+    const size_t size = input.size();
+    size_t start      = 0;
+    for (size_t block = 0; block < size; block += 64) {
+        u64 mask = 0;
+        if (block + 64 <= size) {
+            mask = byte_mask64(data + block, delim);
+        } else {
+            for (size_t i = block; i < size; i++) {
+                mask |= u64{data[i] == delim} << (i - block);
+            }
         }
+        while (mask != 0) {
+            const size_t pos = block + __builtin_ctzll(mask);
+            func(start, pos);
+            start = pos + 1;
+            mask &= mask - 1;
+        }
+    }
+    if (start < size) { func(start, size); }
+}
 
-        // "string" = multiple whitespace-separated words.
-        // "word" = singular word.
-        if (input[i] == '\"' and !previous_char_is_backslash and !in_string) {
-            // Starting string
-            if (!tmp.empty()) {
-                output.push_back(tmp);
-                tmp.clear();
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// Reads 1 to 8 ASCII digits as one word, left padded with '0', and converts
+// them with a few multiplies instead of a loop. False if any byte isn't a
+// digit. `end` is the end of the whole buffer, which decides whether a full
+// 8 byte load is safe.
+auto swar_digits(const char *data, const size_t len, const char *end, u64 &out)
+    -> bool {
+    const u64 zeros = 0x3030303030303030;
+    u64 chunk       = zeros;
+    if (data + 8 <= end) {
+        // A fixed-size load, then the bytes past the field get shifted out
+        // and '0's shifted in. Far cheaper than a variable-length copy.
+        u64 word = 0;
+        memcpy(&word, data, 8);
+        const size_t pad = 8 * (8 - len);
+        chunk            = (word << pad) | (zeros & ((u64{1} << pad) - 1));
+    } else {
+        memcpy(reinterpret_cast<char *>(&chunk) + (8 - len), data, len);
+    }
+    const u64 high_nibbles = chunk & 0xF0F0F0F0F0F0F0F0;
+    const u64 carries = ((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4;
+    if ((high_nibbles | carries) != 0x3333333333333333) { return false; }
+
+    chunk -= zeros;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FF) * 0x000F424000000064)
+             + (((chunk >> 16) & 0x000000FF000000FF) * 0x0000271000000001))
+         >> 32;
+    out = static_cast<u32>(chunk);
+    return true;
+}
+
+template <typename T>
+auto parse_field(const std::string_view field, const char *end)
+    -> std::optional<T> {
+    if constexpr (std::is_floating_point_v<T>) {
+        auto output = parse<T>(field);
+        return output.value_;
+    } else {
+        size_t i      = 0;
+        bool negative = false;
+        if constexpr (std::is_signed_v<T>) {
+            if (!field.empty() and field[0] == '-') {
+                negative = true;
+                i        = 1;
             }
-            in_string = true;
-        } else if (in_string and input[i] != '\"') {
-            // In a string and continuing.
-            tmp += input[i];
-        } else if (in_string and previous_char_is_backslash
-                   and input[i] == '\"') {
-            // Found an escaped double quote in a string.
-            tmp += input[i];
-        } else if (in_string and !previous_char_is_backslash
-                   and input[i] == '\"') {
-            // Exiting a string.
-            if (!tmp.empty()) {
-                output.push_back(tmp);
-                tmp.clear();
+        }
+        const size_t len = field.size() - i;
+        // Sixteen digits always fit in a u64. Anything longer is rare enough
+        // to leave to from_chars.
+        if (len == 0 or len > 16) { return parse<T>(field).value_; }
+
+        const char *digits = field.data() + i;
+        u64 value          = 0;
+        if (len <= 8) {
+            if (!swar_digits(digits, len, end, value)) { return {}; }
+        } else {
+            u64 high = 0;
+            u64 low  = 0;
+            if (!swar_digits(digits, len - 8, end, high)
+                or !swar_digits(digits + len - 8, 8, end, low)) {
+                return {};
             }
-        } else if (previous_char_is_backslash and input[i] == '\"') {
-            // Found an escaped double quote.
-            tmp += input[i];
-        } else if (!std::isspace(input[i])) {
-            // In word
-            tmp += input[i];
-        } else if (std::isspace(input[i]) and !tmp.empty()) {
-            // Ending word
-            output.push_back(tmp);
-            tmp.clear();
+            value = high * 100000000 + low;
         }
-        previous_char_is_backslash = false;
-    }
 
-    if (!tmp.empty()) { output.push_back(tmp); }
-    return output;
+        const u64 max = static_cast<u64>(std::numeric_limits<T>::max());
+        if (negative) {
+            if (value > max + 1) { return {}; }
+            return static_cast<T>(-static_cast<i64>(value));
+        }
+        if (value > max) { return {}; }
+        return static_cast<T>(value);
+    }
 }
-auto quote_string(const std::string_view input) -> std::string {
-    return "\"" + std::string{input} + "\"";
+#else
+template <typename T>
+auto parse_field(const std::string_view field, const char *)
+    -> std::optional<T> {
+    return parse<T>(field).value_;
 }
+#endif
+} // namespace
 
-auto split(const std::string_view input, const char &delim)
-    -> std::vector<std::string> {
-    std::vector<std::string> output = {};
-    std::string elem                = "";
-    for (size_t i = 0; i < input.size(); i++) {
-        if (input[i] != delim) {
-            elem += input[i];
-        } else if (input[i] == delim and !elem.empty()) {
-            output.push_back(elem);
-            elem.clear();
+template <typename T>
+auto parse_column(const char delim, const std::string_view input) -> Column<T> {
+    Column<T> output = {};
+    output.values.reserve(count_byte(delim, input) + 1);
+    size_t row = 0;
+    for_each_field(delim, input, [&](size_t start, size_t end) {
+        if (delim == '\n' and end > start and input[end - 1] == '\r') { end--; }
+        const std::string_view field{input.data() + start, end - start};
+        if (auto value = parse_field<T>(field, input.data() + input.size());
+            value) {
+            output.values.push_back(value.value());
+        } else {
+            output.bad_rows.push_back(row);
         }
-    }
-    if (!elem.empty()) { output.push_back(elem); }
+        row++;
+    });
     return output;
 }
 
-auto find(const std::string_view needle, const std::string_view haystack)
-    -> std::optional<size_t> {
-    size_t out = haystack.find(needle);
-    if (out == std::string::npos) { return {}; }
-    return out;
+// clang-format off
+template auto parse_column<i8>(const char, const std::string_view)  -> Column<i8>;
+template auto parse_column<i16>(const char, const std::string_view) -> Column<i16>;
+template auto parse_column<i32>(const char, const std::string_view) -> Column<i32>;
+template auto parse_column<i64>(const char, const std::string_view) -> Column<i64>;
+template auto parse_column<u8>(const char, const std::string_view)  -> Column<u8>;
+template auto parse_column<u16>(const char, const std::string_view) -> Column<u16>;
+template auto parse_column<u32>(const char, const std::string_view) -> Column<u32>;
+template auto parse_column<u64>(const char, const std::string_view) -> Column<u64>;
+template auto parse_column<f32>(const char, const std::string_view) -> Column<f32>;
+template auto parse_column<f64>(const char, const std::string_view) -> Column<f64>;
+// clang-format on
+
+/// ARENA
+Arena::Arena(const size_t chunk_size)
+    : chunk_size(chunk_size == 0 ? 1 : chunk_size) {}
+
+auto Arena::reset() -> void {
+    this->current = 0;
+    this->offset  = 0;
+    this->used_   = 0;
 }
 
-// This one is really starting to push that line between just an aesthetic
-// wrapper.
-auto slice(const size_t start, const std::string &input) -> std::string {
-    return input.substr(start);
+auto Arena::release() -> void {
+    this->chunks.clear();
+    this->reset();
 }
 
-auto slice(const size_t start, const size_t end, const std::string &input)
-    -> std::string {
-    return input.substr(start, end - start);
+auto Arena::used() const -> size_t {
+    return this->used_;
 }
 
-auto replace(const std::string_view input, const std::string_view from,
-             const std::string_view to) -> std::string {
-    std::string output{};
-    for (usize i = 0; i < input.size();) {
-        if (starts_with(from, &input[i])) {
-            i += from.size();
-            output += to;
-        } else {
-            output += input[i];
-            i++;
-        }
+auto Arena::capacity() const -> size_t {
+    size_t output = 0;
+    for (const auto &it : this->chunks) {
+        output += it.size;
     }
     return output;
 }
 
-auto replacen(const std::string_view input, const std::string_view from,
-              const std::string_view to, const size_t max_count)
-    -> std::string {
-    std::string output{};
-    size_t remaining_replacements = max_count;
-
-    for (usize i = 0; i < input.size();) {
-        if (remaining_replacements > 0 && starts_with(from, &input[i])) {
-            i += from.size();
-            output += to;
-            remaining_replacements--;
-        } else {
-            output += input[i];
-            i++;
+// After a reset the kept chunks are filled in order. One too small for the
+// request is skipped, and past the last a new chunk is added at double the
+// size of the one before, or bigger if the request needs it.
+auto Arena::do_allocate(const size_t bytes, const size_t alignment) -> void * {
+    while (true) {
+        if (this->current == this->chunks.size()) {
+            const size_t grow = this->chunks.empty()
+                                  ? this->chunk_size
+                                  : this->chunks.back().size * 2;
+            const size_t size = std::max(grow, bytes + alignment);
+            this->chunks.push_back({UPtr<char[]>{new char[size]}, size});
+            this->offset = 0;
+        }
+
+        const Chunk &chunk = this->chunks[this->current];
+        const auto base    = reinterpret_cast<uintptr_t>(chunk.data.get());
+        const uintptr_t start
+            = (base + this->offset + alignment - 1) & ~(alignment - 1);
+        const size_t end = start - base + bytes;
+        if (end <= chunk.size) {
+            this->used_ += end - this->offset;
+            this->offset = end;
+            return reinterpret_cast<void *>(start);
         }
+        this->current++;
+        this->offset = 0;
     }
-    return output;
 }
 
-auto lines(const std::string &input) -> std::vector<std::string> {
-    std::vector<std::string> output = {};
-    size_t start                    = 0;
+auto Arena::do_deallocate(void *, size_t, size_t) -> void {}
 
-    for (size_t i = 0; i < input.size(); i++) {
-        if (input[i] == '\n') {
-            output.push_back(input.substr(start, i - start));
-            if (i + 1 < input.size()) { start = i + 1; }
-        }
+auto Arena::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+    -> bool {
+    return this == &other;
+}
+
+/// SCAN
+// Every implementation returns the index of the first match, or `size` when
+// there isn't one, so callers never deal with a null pointer.
+namespace {
+auto find_byte_scalar(const char *data, const size_t size, const char needle)
+    -> size_t {
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == needle) { return i; }
+    }
+    return size;
+}
+
+auto count_byte_scalar(const char *data, const size_t size, const char needle)
+    -> size_t {
+    size_t output = 0;
+    for (size_t i = 0; i < size; i++) {
+        output += data[i] == needle;
     }
     return output;
 }
 
-auto starts_with(const std::string_view needle, const std::string_view haystack)
-    -> bool {
-    // clang-format off
-    if (needle.size() == 0)              return true;
-    if (needle.size() > haystack.size()) return false;
-    if (haystack == needle)              return true;
-    // clang-format on
+// Checks the bytes between the first and last, which the callers have
+// already matched. Candidates are frequent and needles short, so an inline
+// loop beats a call to memcmp.
+inline auto middle_matches(const char *candidate, const char *needle,
+                           const size_t len) -> bool {
+    for (size_t i = 1; i + 1 < len; i++) {
+        if (candidate[i] != needle[i]) { return false; }
+    }
+    return true;
+}
 
-    for (size_t i = 0; i < needle.size(); i++) {
-        if (haystack[i] != needle[i]) { return false; }
+// Substring kernels take needles of two bytes or more and, like the byte
+// kernels, return `size` when there's no match.
+auto find_substr_scalar(const char *data, const size_t size,
+                        const char *needle, const size_t len) -> size_t {
+    if (size < len) { return size; }
+    const size_t last_start = size - len;
+    for (size_t i = 0; i <= last_start;) {
+        const size_t hit = i + find_byte_scalar(data + i, last_start + 1 - i,
+                                                needle[0]);
+        if (hit > last_start) { break; }
+        if (memcmp(data + hit + 1, needle + 1, len - 1) == 0) { return hit; }
+        i = hit + 1;
     }
+    return size;
+}
 
-    return true;
+inline auto ascii_lower(const char c) -> char {
+    return static_cast<u8>(c - 'A') < 26 ? static_cast<char>(c | 0x20) : c;
 }
 
-auto ends_with(const std::string_view needle, const std::string_view haystack)
+// Case kernels flip the ASCII letters from `first` to `first + 25`, so 'A'
+// lowercases and 'a' uppercases. Every other byte is left alone.
+auto convert_case_scalar(char *data, const size_t size, const char first)
+    -> void {
+    for (size_t i = 0; i < size; i++) {
+        if (static_cast<u8>(data[i] - first) < 26) { data[i] ^= 0x20; }
+    }
+}
+
+auto equal_icase_scalar(const char *lhs, const char *rhs, const size_t size)
     -> bool {
-    // clang-format off
-    if (needle.size() == 0)              return true;
-    if (needle.size() > haystack.size()) return false;
-    if (haystack == needle)              return true;
-    // clang-format on
+    for (size_t i = 0; i < size; i++) {
+        if (ascii_lower(lhs[i]) != ascii_lower(rhs[i])) { return false; }
+    }
+    return true;
+}
 
-    for (size_t i = 0; i < needle.size(); i++) {
-        if (haystack[haystack.size() - needle.size() + i] != needle[i]) {
-            return false;
+inline auto middle_matches_icase(const char *candidate, const char *needle,
+                                 const size_t len) -> bool {
+    return len < 3 or equal_icase_scalar(candidate + 1, needle + 1, len - 2);
+}
+
+// Case-insensitive substring kernels take needles of one byte or more, in
+// any case.
+auto find_substr_icase_scalar(const char *data, const size_t size,
+                              const char *needle, const size_t len)
+    -> size_t {
+    if (size < len) { return size; }
+    const char first = ascii_lower(needle[0]);
+    const char last  = ascii_lower(needle[len - 1]);
+    for (size_t i = 0; i + len <= size; i++) {
+        if (ascii_lower(data[i]) == first
+            and ascii_lower(data[i + len - 1]) == last
+            and middle_matches_icase(data + i, needle, len)) {
+            return i;
         }
     }
+    return size;
+}
+
+// Index of the first byte whose membership in `set` is `member`, or `size`.
+auto find_set_scalar(const char *data, const size_t size, const CharSet &set,
+                     const bool member) -> size_t {
+    for (size_t i = 0; i < size; i++) {
+        if (set.contains(data[i]) == member) { return i; }
+    }
+    return size;
+}
 
+// Strict UTF-8, with a word at a time for runs of ASCII.
+auto utf8_valid_scalar(const char *data, const size_t size) -> bool {
+    const auto *bytes = reinterpret_cast<const u8 *>(data);
+    size_t i          = 0;
+    while (i < size) {
+        if (i + 8 <= size) {
+            u64 word;
+            memcpy(&word, bytes + i, 8);
+            if ((word & 0x8080808080808080) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        const u8 lead = bytes[i];
+        if (lead < 0x80) {
+            i++;
+            continue;
+        }
+        size_t len = 0;
+        if (lead >= 0xc2 and lead <= 0xdf) {
+            len = 2;
+        } else if (lead >= 0xe0 and lead <= 0xef) {
+            len = 3;
+        } else if (lead >= 0xf0 and lead <= 0xf4) {
+            len = 4;
+        } else {
+            return false;
+        }
+        if (size - i < len) { return false; }
+        for (size_t k = 1; k < len; k++) {
+            if ((bytes[i + k] & 0xc0) != 0x80) { return false; }
+        }
+        // Overlong forms, surrogates and code points past U+10FFFF all show
+        // in the second byte.
+        const u8 next = bytes[i + 1];
+        if ((lead == 0xe0 and next < 0xa0) or (lead == 0xed and next > 0x9f)
+            or (lead == 0xf0 and next < 0x90)
+            or (lead == 0xf4 and next > 0x8f)) {
+            return false;
+        }
+        i += len;
+    }
     return true;
 }
 
-auto to_lowercase(const std::string_view input) -> std::string {
-    std::string output{input};
-    for (auto &it : output) {
-        it = tolower(it);
+// Bytes that start a code point, i.e. aren't 0b10xxxxxx, one bit per byte.
+inline auto utf8_starts(const u64 word) -> u64 {
+    return ((~word >> 7) | (word >> 6)) & 0x0101010101010101;
+}
+
+auto char_count_scalar(const char *data, const size_t size) -> size_t {
+    size_t output = 0;
+    size_t i      = 0;
+    for (; i + 8 <= size; i += 8) {
+        u64 word;
+        memcpy(&word, data + i, 8);
+        output += __builtin_popcountll(utf8_starts(word));
+    }
+    for (; i < size; i++) {
+        output += (data[i] & 0xc0) != 0x80;
     }
     return output;
 }
 
-auto to_uppercase(const std::string_view input) -> std::string {
-    std::string output{input};
-    for (auto &it : output) {
-        it = toupper(it);
+// The CSV kernels look at exactly 64 bytes and set bit i of `out[0]` for a
+// quote at data[i], and of `out[1]` for `delim` or a newline.
+auto csv_masks_scalar(const char *data, const char delim, u64 *out) -> void {
+    u64 quotes     = 0;
+    u64 separators = 0;
+    for (int i = 0; i < 64; i++) {
+        quotes |= u64{data[i] == '"'} << i;
+        separators |= u64{data[i] == delim or data[i] == '\n'} << i;
     }
-    return output;
+    out[0] = quotes;
+    out[1] = separators;
 }
 
-auto strip_prefix(const std::string_view prefix, const std::string_view input)
-    -> std::optional<std::string> {
-    if (starts_with(prefix, input)) {
-        return slice(prefix.size(), std::string{input});
+#ifdef KHELPER_X86
+auto find_byte_sse2(const char *data, const size_t size, const char needle)
+    -> size_t {
+    const __m128i target = _mm_set1_epi8(needle);
+    size_t i             = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i block
+            = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const u32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+        if (mask != 0) { return i + __builtin_ctz(mask); }
     }
-    return {};
+    return i + find_byte_scalar(data + i, size - i, needle);
 }
-auto strip_suffix(const std::string_view suffix, const std::string_view input)
-    -> std::optional<std::string> {
-    if (ends_with(suffix, input)) {
-        return slice(0, input.size() - suffix.size(), std::string{input});
+
+auto count_byte_sse2(const char *data, const size_t size, const char needle)
+    -> size_t {
+    const __m128i target = _mm_set1_epi8(needle);
+    size_t output        = 0;
+    size_t i             = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i block
+            = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        output += __builtin_popcount(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(block, target)));
     }
-    return {};
+    return output + count_byte_scalar(data + i, size - i, needle);
 }
 
-/// VECTOR
-auto flag_value(const std::string_view lead_value,
-                const std::vector<std::string> &input)
-    -> std::optional<std::string> {
-    for (size_t i = 0; i < input.size(); i++) {
-        if (input[i] == lead_value and i < input.size() - 1) {
-            return make_optional(std::string{input[i + 1]});
+// Compares the first and last needle bytes against 16 candidate positions at
+// a time, and only checks the middle of positions where both match.
+auto find_substr_sse2(const char *data, const size_t size, const char *needle,
+                      const size_t len) -> size_t {
+    if (size < len) { return size; }
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[len - 1]);
+    size_t i            = 0;
+    for (; i + len - 1 + 16 <= size; i += 16) {
+        const __m128i block_first
+            = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i block_last = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(data + i + len - 1));
+        const __m128i both = _mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                           _mm_cmpeq_epi8(block_last, last));
+        u32 mask           = _mm_movemask_epi8(both);
+        while (mask != 0) {
+            const size_t hit = i + __builtin_ctz(mask);
+            if (middle_matches(data + hit, needle, len)) { return hit; }
+            mask &= mask - 1;
         }
     }
-    return {};
+    return i + find_substr_scalar(data + i, size - i, needle, len);
 }
 
-/// PRINTING
-auto println() -> void {
-    std::cout << std::endl;
-}
-auto eprintln() -> void {
-    std::cerr << std::endl;
+// Flips the case of the letters from `first` to `first + 25`: the add moves
+// that range to the bottom of the signed byte range, where one compare
+// finds it.
+inline auto flip_case_sse2(const __m128i block, const char first) -> __m128i {
+    const __m128i shifted
+        = _mm_add_epi8(block, _mm_set1_epi8(static_cast<char>(0x80 - first)));
+    const __m128i letters = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+    return _mm_xor_si128(block, _mm_and_si128(letters, _mm_set1_epi8(0x20)));
 }
 
-auto operator<<(std::ostream &os, const std::vector<uint8_t> &input)
-    -> std::ostream & {
-    os << "Vec { ";
-    for (size_t i = 0; i < input.size(); i++) {
-        os << std::to_string(input[i]);
-        if (i != input.size() - 1) { os << ", "; }
+auto convert_case_sse2(char *data, const size_t size, const char first)
+    -> void {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        auto *at = reinterpret_cast<__m128i *>(data + i);
+        _mm_storeu_si128(at, flip_case_sse2(_mm_loadu_si128(at), first));
     }
-    os << " }";
-    return os;
+    convert_case_scalar(data + i, size - i, first);
 }
 
-/// MISC
-auto re_search(const std::string &re, const std::string &input) -> bool {
-    return std::regex_search(input, std::regex(re));
+auto equal_icase_sse2(const char *lhs, const char *rhs, const size_t size)
+    -> bool {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i a = flip_case_sse2(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i)), 'A');
+        const __m128i b = flip_case_sse2(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i)), 'A');
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xffff) { return false; }
+    }
+    return equal_icase_scalar(lhs + i, rhs + i, size - i);
 }
 
-auto lines_from_file(const std::string &input) -> std::vector<std::string> {
-    std::ifstream file(input);
-    std::ostringstream input_ss;
-    input_ss << file.rdbuf();
-    return lines(input_ss.str());
+auto find_substr_icase_sse2(const char *data, const size_t size,
+                            const char *needle, const size_t len) -> size_t {
+    if (size < len) { return size; }
+    const __m128i first = _mm_set1_epi8(ascii_lower(needle[0]));
+    const __m128i last  = _mm_set1_epi8(ascii_lower(needle[len - 1]));
+    size_t i            = 0;
+    for (; i + len - 1 + 16 <= size; i += 16) {
+        const __m128i block_first = flip_case_sse2(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), 'A');
+        const __m128i block_last = flip_case_sse2(
+            _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(data + i + len - 1)),
+            'A');
+        const __m128i both = _mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                           _mm_cmpeq_epi8(block_last, last));
+        u32 mask           = _mm_movemask_epi8(both);
+        while (mask != 0) {
+            const size_t hit = i + __builtin_ctz(mask);
+            if (middle_matches_icase(data + hit, needle, len)) { return hit; }
+            mask &= mask - 1;
+        }
+    }
+    return i + find_substr_icase_scalar(data + i, size - i, needle, len);
+}
+
+// The nibble lookup needs pshufb, which SSE2 doesn't have; the table lookup
+// is still independent of the set's size.
+auto find_set_sse2(const char *data, const size_t size, const CharSet &set,
+                   const bool member) -> size_t {
+    return find_set_scalar(data, size, set, member);
+}
+
+// Validation needs pshufb, so SSE2 only counts.
+auto utf8_valid_sse2(const char *data, const size_t size) -> bool {
+    return utf8_valid_scalar(data, size);
+}
+
+// Continuation bytes are -128..-65 as signed bytes, so everything greater
+// starts a code point.
+auto char_count_sse2(const char *data, const size_t size) -> size_t {
+    const __m128i last_continuation = _mm_set1_epi8(-65);
+    size_t output                   = 0;
+    size_t i                        = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i block
+            = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        output += __builtin_popcount(
+            _mm_movemask_epi8(_mm_cmpgt_epi8(block, last_continuation)));
+    }
+    return output + char_count_scalar(data + i, size - i);
+}
+
+auto csv_masks_sse2(const char *data, const char delim, u64 *out) -> void {
+    const __m128i quote     = _mm_set1_epi8('"');
+    const __m128i separator = _mm_set1_epi8(delim);
+    const __m128i newline   = _mm_set1_epi8('\n');
+    u64 quotes              = 0;
+    u64 separators          = 0;
+    for (int i = 0; i < 4; i++) {
+        const __m128i block
+            = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i));
+        const u64 q = static_cast<u32>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(block, quote)));
+        const u64 s = static_cast<u32>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(block, separator),
+                         _mm_cmpeq_epi8(block, newline))));
+        quotes |= q << (16 * i);
+        separators |= s << (16 * i);
+    }
+    out[0] = quotes;
+    out[1] = separators;
+}
+
+__attribute__((target("avx2"))) auto
+find_byte_avx2(const char *data, const size_t size, const char needle)
+    -> size_t {
+    const __m256i target = _mm256_set1_epi8(needle);
+    size_t i             = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m256i lo
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i hi = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(data + i + 32));
+        const __m256i either = _mm256_or_si256(_mm256_cmpeq_epi8(lo, target),
+                                               _mm256_cmpeq_epi8(hi, target));
+        if (_mm256_movemask_epi8(either) != 0) {
+            const u64 mask_lo = static_cast<u32>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, target)));
+            const u64 mask_hi = static_cast<u32>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, target)));
+            return i + __builtin_ctzll(mask_lo | (mask_hi << 32));
+        }
+    }
+    for (; i + 32 <= size; i += 32) {
+        const __m256i block
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const u32 mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target));
+        if (mask != 0) { return i + __builtin_ctz(mask); }
+    }
+    return i + find_byte_sse2(data + i, size - i, needle);
+}
+
+__attribute__((target("avx2"))) auto
+find_substr_avx2(const char *data, const size_t size, const char *needle,
+                 const size_t len) -> size_t {
+    if (size < len) { return size; }
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last  = _mm256_set1_epi8(needle[len - 1]);
+    size_t i            = 0;
+    for (; i + len - 1 + 32 <= size; i += 32) {
+        const __m256i block_first
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i block_last = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(data + i + len - 1));
+        u32 mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                             _mm256_cmpeq_epi8(block_last, last)));
+        while (mask != 0) {
+            const size_t hit = i + __builtin_ctz(mask);
+            if (middle_matches(data + hit, needle, len)) { return hit; }
+            mask &= mask - 1;
+        }
+    }
+    return i + find_substr_sse2(data + i, size - i, needle, len);
+}
+
+__attribute__((target("avx2,popcnt"))) auto
+count_byte_avx2(const char *data, const size_t size, const char needle)
+    -> size_t {
+    const __m256i target = _mm256_set1_epi8(needle);
+    size_t output        = 0;
+    size_t i             = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i block
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        output += __builtin_popcount(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target)));
+    }
+    return output + count_byte_sse2(data + i, size - i, needle);
+}
+
+__attribute__((target("avx2"))) inline auto
+flip_case_avx2(const __m256i block, const char first) -> __m256i {
+    const __m256i shifted = _mm256_add_epi8(
+        block, _mm256_set1_epi8(static_cast<char>(0x80 - first)));
+    const __m256i letters
+        = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), shifted);
+    return _mm256_xor_si256(block,
+                            _mm256_and_si256(letters, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2"))) auto
+convert_case_avx2(char *data, const size_t size, const char first) -> void {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        auto *at = reinterpret_cast<__m256i *>(data + i);
+        _mm256_storeu_si256(at, flip_case_avx2(_mm256_loadu_si256(at), first));
+    }
+    convert_case_sse2(data + i, size - i, first);
+}
+
+__attribute__((target("avx2"))) auto
+equal_icase_avx2(const char *lhs, const char *rhs, const size_t size) -> bool {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i a = flip_case_avx2(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lhs + i)),
+            'A');
+        const __m256i b = flip_case_avx2(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rhs + i)),
+            'A');
+        if (~_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != 0) {
+            return false;
+        }
+    }
+    return equal_icase_sse2(lhs + i, rhs + i, size - i);
+}
+
+__attribute__((target("avx2"))) auto
+find_substr_icase_avx2(const char *data, const size_t size, const char *needle,
+                       const size_t len) -> size_t {
+    if (size < len) { return size; }
+    const __m256i first = _mm256_set1_epi8(ascii_lower(needle[0]));
+    const __m256i last  = _mm256_set1_epi8(ascii_lower(needle[len - 1]));
+    size_t i            = 0;
+    for (; i + len - 1 + 32 <= size; i += 32) {
+        const __m256i block_first = flip_case_avx2(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)),
+            'A');
+        const __m256i block_last = flip_case_avx2(
+            _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(data + i + len - 1)),
+            'A');
+        u32 mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                             _mm256_cmpeq_epi8(block_last, last)));
+        while (mask != 0) {
+            const size_t hit = i + __builtin_ctz(mask);
+            if (middle_matches_icase(data + hit, needle, len)) { return hit; }
+            mask &= mask - 1;
+        }
+    }
+    return i + find_substr_icase_sse2(data + i, size - i, needle, len);
+}
+
+// Membership of 32 bytes: the low nibble picks a table entry, the high bit
+// picks which of the two tables, and the other three high bits pick a bit.
+__attribute__((target("avx2"))) inline auto
+set_mask_avx2(const __m256i block, const __m256i low, const __m256i high,
+              const __m256i bits) -> u32 {
+    const __m256i nibbles = _mm256_set1_epi8(15);
+    const __m256i lo      = _mm256_and_si256(block, nibbles);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibbles);
+    const __m256i row
+        = _mm256_blendv_epi8(_mm256_shuffle_epi8(low, lo),
+                             _mm256_shuffle_epi8(high, lo), block);
+    const __m256i miss = _mm256_cmpeq_epi8(
+        _mm256_and_si256(row, _mm256_shuffle_epi8(bits, hi)),
+        _mm256_setzero_si256());
+    return ~static_cast<u32>(_mm256_movemask_epi8(miss));
+}
+
+__attribute__((target("avx2"))) auto
+find_set_avx2(const char *data, const size_t size, const CharSet &set,
+              const bool member) -> size_t {
+    const __m128i low128
+        = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.table));
+    const __m128i high128
+        = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.table + 16));
+    const __m256i low  = _mm256_broadcastsi128_si256(low128);
+    const __m256i high = _mm256_broadcastsi128_si256(high128);
+    const __m256i bits = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4,
+        8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i block
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        u32 mask = set_mask_avx2(block, low, high, bits);
+        if (!member) { mask = ~mask; }
+        if (mask != 0) { return i + __builtin_ctz(mask); }
+    }
+    return i + find_set_scalar(data + i, size - i, set, member);
+}
+
+// UTF-8 validation by table lookup (Keiser and Lemire, "Validating UTF-8 In
+// Less Than One Instruction Per Byte"). Every error in a pair of adjacent
+// bytes sets the same bit in three tables, indexed by the high and low
+// nibbles of the first byte and the high nibble of the second. Third and
+// fourth bytes are checked separately against the lead two or three back.
+namespace utf8_error {
+const u8 TOO_SHORT      = 1 << 0; // lead not followed by a continuation
+const u8 TOO_LONG       = 1 << 1; // ASCII followed by a continuation
+const u8 OVERLONG_3     = 1 << 2;
+const u8 TOO_LARGE      = 1 << 3;
+const u8 SURROGATE      = 1 << 4;
+const u8 OVERLONG_2     = 1 << 5;
+const u8 TOO_LARGE_1000 = 1 << 6;
+const u8 OVERLONG_4     = 1 << 6;
+const u8 TWO_CONTS      = 1 << 7; // continuation after a continuation
+const u8 CARRY          = TOO_SHORT | TOO_LONG | TWO_CONTS;
+} // namespace utf8_error
+
+__attribute__((target("avx2"))) inline auto
+utf8_lookup_avx2(const __m256i table, const __m256i nibbles) -> __m256i {
+    return _mm256_shuffle_epi8(table, nibbles);
+}
+
+__attribute__((target("avx2"))) inline auto
+high_nibbles_avx2(const __m256i block) -> __m256i {
+    return _mm256_and_si256(_mm256_srli_epi16(block, 4), _mm256_set1_epi8(15));
+}
+
+// `block` shifted right by `N` bytes, with the last bytes of `previous`
+// shifted in.
+template <int N>
+__attribute__((target("avx2"))) inline auto
+shift_in_avx2(const __m256i block, const __m256i previous) -> __m256i {
+    return _mm256_alignr_epi8(
+        block, _mm256_permute2x128_si256(previous, block, 0x21), 16 - N);
+}
+
+__attribute__((target("avx2"))) auto
+utf8_errors_avx2(const __m256i block, const __m256i previous) -> __m256i {
+    using namespace utf8_error;
+    // clang-format off
+    const __m256i byte_1_high = _mm256_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const u8 large = CARRY | TOO_LARGE | TOO_LARGE_1000;
+    const __m256i byte_1_low = _mm256_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2,
+        CARRY, CARRY, CARRY | TOO_LARGE, large, large, large, large, large,
+        large, large, large, large | SURROGATE, large, large,
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2,
+        CARRY, CARRY, CARRY | TOO_LARGE, large, large, large, large, large,
+        large, large, large, large | SURROGATE, large, large);
+    const u8 cont = TOO_LONG | OVERLONG_2 | TWO_CONTS;
+    const __m256i byte_2_high = _mm256_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT,
+        cont | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        cont | OVERLONG_3 | TOO_LARGE, cont | SURROGATE | TOO_LARGE,
+        cont | SURROGATE | TOO_LARGE, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT,
+        cont | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        cont | OVERLONG_3 | TOO_LARGE, cont | SURROGATE | TOO_LARGE,
+        cont | SURROGATE | TOO_LARGE, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT);
+    // clang-format on
+
+    const __m256i prev1 = shift_in_avx2<1>(block, previous);
+    const __m256i low_nibbles
+        = _mm256_and_si256(prev1, _mm256_set1_epi8(15));
+    const __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            utf8_lookup_avx2(byte_1_high, high_nibbles_avx2(prev1)),
+            utf8_lookup_avx2(byte_1_low, low_nibbles)),
+        utf8_lookup_avx2(byte_2_high, high_nibbles_avx2(block)));
+
+    // A byte two after a 3- or 4-byte lead, or three after a 4-byte lead,
+    // has to be a continuation; TWO_CONTS flags exactly those, so they
+    // cancel out and anything left is an error.
+    const __m256i third = _mm256_subs_epu8(shift_in_avx2<2>(block, previous),
+                                           _mm256_set1_epi8(0xe0 - 0x80));
+    const __m256i fourth = _mm256_subs_epu8(shift_in_avx2<3>(block, previous),
+                                            _mm256_set1_epi8(0xf0 - 0x80));
+    const __m256i must_continue = _mm256_and_si256(
+        _mm256_or_si256(third, fourth), _mm256_set1_epi8(-128));
+    return _mm256_xor_si256(must_continue, special);
+}
+
+__attribute__((target("avx2"))) auto
+utf8_valid_avx2(const char *data, const size_t size) -> bool {
+    // Non-zero where the block ends partway through a code point.
+    const __m256i incomplete_max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, static_cast<char>(0xef),
+        static_cast<char>(0xdf), static_cast<char>(0xbf));
+    __m256i previous   = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i errors     = _mm256_setzero_si256();
+    size_t i           = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i block
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        if (_mm256_movemask_epi8(block) == 0) {
+            // All ASCII: the only possible error is a code point cut off at
+            // the end of the previous block.
+            errors     = _mm256_or_si256(errors, incomplete);
+            incomplete = _mm256_setzero_si256();
+        } else {
+            errors = _mm256_or_si256(errors, utf8_errors_avx2(block, previous));
+            incomplete = _mm256_subs_epu8(block, incomplete_max);
+        }
+        previous = block;
+    }
+    if (!_mm256_testz_si256(errors, errors)) { return false; }
+
+    // The tail goes to the scalar check, from the start of the code point
+    // the blocks ended in, so a sequence split across the two is seen
+    // whole.
+    size_t start = i;
+    while (start > 0 and i - start < 3 and (data[start - 1] & 0xc0) == 0x80) {
+        start--;
+    }
+    if (start > 0 and static_cast<u8>(data[start - 1]) >= 0xc0) { start--; }
+    return utf8_valid_scalar(data + start, size - start);
+}
+
+__attribute__((target("avx2,popcnt"))) auto
+char_count_avx2(const char *data, const size_t size) -> size_t {
+    const __m256i last_continuation = _mm256_set1_epi8(-65);
+    size_t output                   = 0;
+    size_t i                        = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i block
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        output += __builtin_popcount(_mm256_movemask_epi8(
+            _mm256_cmpgt_epi8(block, last_continuation)));
+    }
+    return output + char_count_sse2(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) auto
+csv_masks_avx2(const char *data, const char delim, u64 *out) -> void {
+    const __m256i quote     = _mm256_set1_epi8('"');
+    const __m256i separator = _mm256_set1_epi8(delim);
+    const __m256i newline   = _mm256_set1_epi8('\n');
+    u64 quotes              = 0;
+    u64 separators          = 0;
+    for (int i = 0; i < 2; i++) {
+        const __m256i block = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(data + 32 * i));
+        const u64 q = static_cast<u32>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, quote)));
+        const u64 s = static_cast<u32>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, separator),
+                            _mm256_cmpeq_epi8(block, newline))));
+        quotes |= q << (32 * i);
+        separators |= s << (32 * i);
+    }
+    out[0] = quotes;
+    out[1] = separators;
+}
+
+__attribute__((target("avx512f,avx512bw"))) auto
+find_byte_avx512(const char *data, const size_t size, const char needle)
+    -> size_t {
+    const __m512i target = _mm512_set1_epi8(needle);
+    size_t i             = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m512i block = _mm512_loadu_si512(data + i);
+        const u64 mask      = _mm512_cmpeq_epi8_mask(block, target);
+        if (mask != 0) { return i + __builtin_ctzll(mask); }
+    }
+    if (i < size) {
+        const __mmask64 tail = ~u64{0} >> (64 - (size - i));
+        const __m512i block  = _mm512_maskz_loadu_epi8(tail, data + i);
+        const u64 mask = _mm512_mask_cmpeq_epi8_mask(tail, block, target);
+        if (mask != 0) { return i + __builtin_ctzll(mask); }
+    }
+    return size;
+}
+
+__attribute__((target("avx512f,avx512bw"))) auto
+find_substr_avx512(const char *data, const size_t size, const char *needle,
+                   const size_t len) -> size_t {
+    if (size < len) { return size; }
+    const __m512i first = _mm512_set1_epi8(needle[0]);
+    const __m512i last  = _mm512_set1_epi8(needle[len - 1]);
+    size_t i            = 0;
+    for (; i + len - 1 + 64 <= size; i += 64) {
+        const __m512i block_first = _mm512_loadu_si512(data + i);
+        const __m512i block_last  = _mm512_loadu_si512(data + i + len - 1);
+        u64 mask = _mm512_cmpeq_epi8_mask(block_first, first)
+                 & _mm512_cmpeq_epi8_mask(block_last, last);
+        while (mask != 0) {
+            const size_t hit = i + __builtin_ctzll(mask);
+            if (middle_matches(data + hit, needle, len)) { return hit; }
+            mask &= mask - 1;
+        }
+    }
+    return i + find_substr_avx2(data + i, size - i, needle, len);
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt"))) auto
+count_byte_avx512(const char *data, const size_t size, const char needle)
+    -> size_t {
+    const __m512i target = _mm512_set1_epi8(needle);
+    size_t output        = 0;
+    size_t i             = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m512i block = _mm512_loadu_si512(data + i);
+        output += __builtin_popcountll(_mm512_cmpeq_epi8_mask(block, target));
+    }
+    if (i < size) {
+        const __mmask64 tail = ~u64{0} >> (64 - (size - i));
+        const __m512i block  = _mm512_maskz_loadu_epi8(tail, data + i);
+        output += __builtin_popcountll(
+            _mm512_mask_cmpeq_epi8_mask(tail, block, target));
+    }
+    return output;
+}
+__attribute__((target("avx512f,avx512bw"))) inline auto
+flip_case_avx512(const __m512i block, const char first) -> __m512i {
+    const __mmask64 letters = _mm512_cmplt_epu8_mask(
+        _mm512_sub_epi8(block, _mm512_set1_epi8(first)), _mm512_set1_epi8(26));
+    return _mm512_mask_blend_epi8(
+        letters, block, _mm512_xor_si512(block, _mm512_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx512f,avx512bw"))) auto
+convert_case_avx512(char *data, const size_t size, const char first) -> void {
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m512i block = _mm512_loadu_si512(data + i);
+        _mm512_storeu_si512(data + i, flip_case_avx512(block, first));
+    }
+    if (i < size) {
+        const __mmask64 tail = ~u64{0} >> (64 - (size - i));
+        const __m512i block  = _mm512_maskz_loadu_epi8(tail, data + i);
+        _mm512_mask_storeu_epi8(data + i, tail, flip_case_avx512(block, first));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw"))) auto
+equal_icase_avx512(const char *lhs, const char *rhs, const size_t size)
+    -> bool {
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m512i a = flip_case_avx512(_mm512_loadu_si512(lhs + i), 'A');
+        const __m512i b = flip_case_avx512(_mm512_loadu_si512(rhs + i), 'A');
+        if (_mm512_cmpneq_epi8_mask(a, b) != 0) { return false; }
+    }
+    if (i < size) {
+        const __mmask64 tail = ~u64{0} >> (64 - (size - i));
+        const __m512i a
+            = flip_case_avx512(_mm512_maskz_loadu_epi8(tail, lhs + i), 'A');
+        const __m512i b
+            = flip_case_avx512(_mm512_maskz_loadu_epi8(tail, rhs + i), 'A');
+        return _mm512_cmpneq_epi8_mask(a, b) == 0;
+    }
+    return true;
+}
+
+__attribute__((target("avx512f,avx512bw"))) auto
+find_substr_icase_avx512(const char *data, const size_t size,
+                         const char *needle, const size_t len) -> size_t {
+    if (size < len) { return size; }
+    const __m512i first = _mm512_set1_epi8(ascii_lower(needle[0]));
+    const __m512i last  = _mm512_set1_epi8(ascii_lower(needle[len - 1]));
+    size_t i            = 0;
+    for (; i + len - 1 + 64 <= size; i += 64) {
+        const __m512i block_first
+            = flip_case_avx512(_mm512_loadu_si512(data + i), 'A');
+        const __m512i block_last
+            = flip_case_avx512(_mm512_loadu_si512(data + i + len - 1), 'A');
+        u64 mask = _mm512_cmpeq_epi8_mask(block_first, first)
+                 & _mm512_cmpeq_epi8_mask(block_last, last);
+        while (mask != 0) {
+            const size_t hit = i + __builtin_ctzll(mask);
+            if (middle_matches_icase(data + hit, needle, len)) { return hit; }
+            mask &= mask - 1;
+        }
+    }
+    return i + find_substr_icase_avx2(data + i, size - i, needle, len);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline auto
+set_mask_avx512(const __m512i block, const __m512i low, const __m512i high,
+                const __m512i bits) -> u64 {
+    const __m512i nibbles = _mm512_set1_epi8(15);
+    const __m512i lo      = _mm512_and_si512(block, nibbles);
+    const __m512i hi = _mm512_and_si512(_mm512_srli_epi16(block, 4), nibbles);
+    const __m512i row
+        = _mm512_mask_blend_epi8(_mm512_movepi8_mask(block),
+                                 _mm512_shuffle_epi8(low, lo),
+                                 _mm512_shuffle_epi8(high, lo));
+    return _mm512_test_epi8_mask(row, _mm512_shuffle_epi8(bits, hi));
+}
+
+__attribute__((target("avx512f,avx512bw"))) auto
+find_set_avx512(const char *data, const size_t size, const CharSet &set,
+                const bool member) -> size_t {
+    // The shuffles work per 16-byte lane, so each table goes in all four.
+    // The masked broadcast sidesteps a bogus -Wuninitialized in GCC 12.
+    const __m512i low = _mm512_maskz_broadcast_i32x4(
+        0xffff, _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.table)));
+    const __m512i high = _mm512_maskz_broadcast_i32x4(
+        0xffff,
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.table + 16)));
+    const __m512i bits = _mm512_maskz_broadcast_i32x4(
+        0xffff, _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32,
+                              64, -128));
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        u64 mask = set_mask_avx512(_mm512_loadu_si512(data + i), low, high,
+                                   bits);
+        if (!member) { mask = ~mask; }
+        if (mask != 0) { return i + __builtin_ctzll(mask); }
+    }
+    if (i < size) {
+        const __mmask64 tail = ~u64{0} >> (64 - (size - i));
+        u64 mask             = set_mask_avx512(
+            _mm512_maskz_loadu_epi8(tail, data + i), low, high, bits);
+        if (!member) { mask = ~mask; }
+        mask &= tail;
+        if (mask != 0) { return i + __builtin_ctzll(mask); }
+    }
+    return size;
+}
+// The lookup needs bytes from the previous block, which AVX-512 can only
+// shift in across lanes with an extra permute; the AVX2 kernel is already
+// bound by loads.
+auto utf8_valid_avx512(const char *data, const size_t size) -> bool {
+    return utf8_valid_avx2(data, size);
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt"))) auto
+char_count_avx512(const char *data, const size_t size) -> size_t {
+    const __m512i last_continuation = _mm512_set1_epi8(-65);
+    size_t output                   = 0;
+    size_t i                        = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m512i block = _mm512_loadu_si512(data + i);
+        output += __builtin_popcountll(
+            _mm512_cmpgt_epi8_mask(block, last_continuation));
+    }
+    if (i < size) {
+        const __mmask64 tail = ~u64{0} >> (64 - (size - i));
+        const __m512i block  = _mm512_maskz_loadu_epi8(tail, data + i);
+        output += __builtin_popcountll(
+            _mm512_mask_cmpgt_epi8_mask(tail, block, last_continuation));
+    }
+    return output;
+}
+
+__attribute__((target("avx512f,avx512bw"))) auto
+csv_masks_avx512(const char *data, const char delim, u64 *out) -> void {
+    const __m512i block = _mm512_loadu_si512(data);
+    out[0]              = _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('"'));
+    out[1] = _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(delim))
+           | _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('\n'));
+}
+#endif
+
+struct ScanOps {
+    ScanImpl impl;
+    size_t (*find_byte)(const char *, size_t, char);
+    size_t (*count_byte)(const char *, size_t, char);
+    size_t (*find_substr)(const char *, size_t, const char *, size_t);
+    void (*convert_case)(char *, size_t, char);
+    bool (*equal_icase)(const char *, const char *, size_t);
+    size_t (*find_substr_icase)(const char *, size_t, const char *, size_t);
+    size_t (*find_set)(const char *, size_t, const CharSet &, bool);
+    bool (*utf8_valid)(const char *, size_t);
+    size_t (*char_count)(const char *, size_t);
+    void (*csv_masks)(const char *, char, u64 *);
+};
+
+// clang-format off
+const ScanOps SCAN_SCALAR = {ScanImpl::Scalar, find_byte_scalar, count_byte_scalar, find_substr_scalar,
+                             convert_case_scalar, equal_icase_scalar, find_substr_icase_scalar,
+                             find_set_scalar, utf8_valid_scalar, char_count_scalar, csv_masks_scalar};
+#ifdef KHELPER_X86
+const ScanOps SCAN_SSE2   = {ScanImpl::SSE2,   find_byte_sse2,   count_byte_sse2,   find_substr_sse2,
+                             convert_case_sse2,   equal_icase_sse2,   find_substr_icase_sse2,
+                             find_set_sse2, utf8_valid_sse2, char_count_sse2, csv_masks_sse2};
+const ScanOps SCAN_AVX2   = {ScanImpl::AVX2,   find_byte_avx2,   count_byte_avx2,   find_substr_avx2,
+                             convert_case_avx2,   equal_icase_avx2,   find_substr_icase_avx2,
+                             find_set_avx2, utf8_valid_avx2, char_count_avx2, csv_masks_avx2};
+const ScanOps SCAN_AVX512 = {ScanImpl::AVX512, find_byte_avx512, count_byte_avx512, find_substr_avx512,
+                             convert_case_avx512, equal_icase_avx512, find_substr_icase_avx512,
+                             find_set_avx512, utf8_valid_avx512, char_count_avx512, csv_masks_avx512};
+#endif
+// clang-format on
+
+auto scan_ops_for(const ScanImpl impl) -> const ScanOps * {
+    switch (impl) {
+    case ScanImpl::Scalar: return &SCAN_SCALAR;
+#ifdef KHELPER_X86
+    case ScanImpl::SSE2: return &SCAN_SSE2;
+    case ScanImpl::AVX2:
+        return __builtin_cpu_supports("avx2") ? &SCAN_AVX2 : nullptr;
+    case ScanImpl::AVX512:
+        return (__builtin_cpu_supports("avx512f")
+                and __builtin_cpu_supports("avx512bw"))
+                 ? &SCAN_AVX512
+                 : nullptr;
+    case ScanImpl::Auto:
+        if (auto ops = scan_ops_for(ScanImpl::AVX512); ops) { return ops; }
+        if (auto ops = scan_ops_for(ScanImpl::AVX2); ops) { return ops; }
+        return &SCAN_SSE2;
+#else
+    case ScanImpl::Auto: return &SCAN_SCALAR;
+#endif
+    default: return nullptr;
+    }
+}
+
+auto active_scan_ops() -> std::atomic<const ScanOps *> & {
+    static std::atomic<const ScanOps *> ops{scan_ops_for(ScanImpl::Auto)};
+    return ops;
+}
+
+auto scan_ops() -> const ScanOps & {
+    return *active_scan_ops().load(std::memory_order_relaxed);
+}
+} // namespace
+
+auto scan_impl_supported(const ScanImpl impl) -> bool {
+    return scan_ops_for(impl) != nullptr;
+}
+
+auto set_scan_impl(const ScanImpl impl) -> bool {
+    const ScanOps *ops = scan_ops_for(impl);
+    if (ops == nullptr) { return false; }
+    active_scan_ops().store(ops, std::memory_order_relaxed);
+    return true;
+}
+
+auto scan_impl() -> ScanImpl {
+    return scan_ops().impl;
+}
+
+auto find_byte(const char needle, const std::string_view input)
+    -> std::optional<size_t> {
+    const size_t out = scan_ops().find_byte(input.data(), input.size(), needle);
+    if (out == input.size()) { return {}; }
+    return out;
+}
+
+auto count_byte(const char needle, const std::string_view input) -> size_t {
+    return scan_ops().count_byte(input.data(), input.size(), needle);
+}
+
+auto find_char(const char needle, const std::string_view input)
+    -> std::optional<std::pair<size_t, char>> {
+    if (auto it = find_byte(needle, input); it) {
+        return std::make_pair(it.value(), needle);
+    }
+    return {};
+}
+
+auto find_char(const CharSet &set, const std::string_view input)
+    -> std::optional<std::pair<size_t, char>> {
+    const size_t out
+        = scan_ops().find_set(input.data(), input.size(), set, true);
+    if (out == input.size()) { return {}; }
+    return std::make_pair(out, input[out]);
+}
+
+auto operator<<(std::ostream &os, const ScanImpl &rhs) -> std::ostream & {
+    switch (rhs) {
+    case ScanImpl::Auto: return os << "Auto";
+    case ScanImpl::Scalar: return os << "Scalar";
+    case ScanImpl::SSE2: return os << "SSE2";
+    case ScanImpl::AVX2: return os << "AVX2";
+    case ScanImpl::AVX512: return os << "AVX512";
+    }
+    return os;
+}
+
+/// SEARCH
+namespace {
+// Needles up to this long go through the vectorized filter. Past it, the
+// filter's worst case (every position a candidate) costs too much per byte.
+const constexpr size_t SHORT_NEEDLE_MAX = 32;
+} // namespace
+
+namespace {
+// The Two-Way preprocessing: a critical factorization of the needle from the
+// larger of its two maximal suffixes (one per byte ordering), and whether the
+// needle is periodic at that split.
+struct TwoWayFactor {
+    size_t critical_pos = 0;
+    size_t period       = 0;
+    bool is_periodic    = false;
+};
+
+auto two_way_factor(const std::string_view needle) -> TwoWayFactor {
+    const auto *n    = reinterpret_cast<const unsigned char *>(needle.data());
+    const size_t len = needle.size();
+    auto maximal_suffix = [&](const bool reversed, size_t &period_out) {
+        ptrdiff_t ip = -1;
+        size_t jp    = 0;
+        size_t k     = 1;
+        size_t p     = 1;
+        while (jp + k < len) {
+            const unsigned char a = n[ip + k];
+            const unsigned char b = n[jp + k];
+            if (a == b) {
+                if (k == p) {
+                    jp += p;
+                    k = 1;
+                } else {
+                    k++;
+                }
+            } else if (reversed ? a < b : a > b) {
+                jp += k;
+                k = 1;
+                p = jp - ip;
+            } else {
+                ip = jp++;
+                k = p = 1;
+            }
+        }
+        period_out = p;
+        return ip;
+    };
+    size_t period_forward  = 0;
+    size_t period_reversed = 0;
+    const ptrdiff_t forward  = maximal_suffix(false, period_forward);
+    const ptrdiff_t reversed = maximal_suffix(true, period_reversed);
+    const ptrdiff_t split    = std::max(forward, reversed);
+    const size_t suffix_period
+        = reversed > forward ? period_reversed : period_forward;
+
+    TwoWayFactor factor{};
+    factor.critical_pos = static_cast<size_t>(split + 1);
+    factor.is_periodic
+        = memcmp(n, n + suffix_period, factor.critical_pos) == 0;
+    if (factor.is_periodic) {
+        factor.period = suffix_period;
+    } else {
+        // Any shift this long is safe, and it's longer than `period`.
+        factor.period = static_cast<size_t>(
+            std::max<ptrdiff_t>(split, len - split - 1) + 1);
+    }
+    return factor;
+}
+
+// Crochemore-Perrin Two-Way, with a last-byte shift to skip ahead the way
+// Horspool does. `last_of(c)` is one past the last index of byte `c` in the
+// needle, or 0; an overestimate only costs skips, never matches. `memory` is
+// the prefix of the needle already known to match after a shift by a
+// periodic needle's period.
+template <typename LastOf>
+auto two_way_next(const TwoWayFactor &factor, const std::string_view needle,
+                  const std::string_view haystack, size_t start,
+                  LastOf last_of) -> size_t {
+    const auto *n    = reinterpret_cast<const unsigned char *>(needle.data());
+    const auto *h    = reinterpret_cast<const unsigned char *>(haystack.data());
+    const size_t len = needle.size();
+    const size_t ms  = factor.critical_pos;
+    size_t memory    = 0;
+    while (haystack.size() - start >= len) {
+        const size_t last = last_of(h[start + len - 1]);
+        if (last == 0) {
+            start += len;
+            memory = 0;
+            continue;
+        }
+        if (last != len) {
+            start += std::max(len - last, memory);
+            memory = 0;
+            continue;
+        }
+
+        size_t k = std::max(ms, memory);
+        while (k < len and n[k] == h[start + k]) {
+            k++;
+        }
+        if (k < len) {
+            start += k - ms + 1;
+            memory = 0;
+            continue;
+        }
+        k = ms;
+        while (k > memory and n[k - 1] == h[start + k - 1]) {
+            k--;
+        }
+        if (k <= memory) { return start; }
+        start += factor.period;
+        memory = factor.is_periodic ? len - factor.period : 0;
+    }
+    return haystack.size();
+}
+} // namespace
+
+Searcher::Searcher(const std::string_view needle) : needle_{needle} {
+    if (needle.empty()) {
+        this->kind = Kind::Empty;
+        return;
+    }
+    if (needle.size() == 1) {
+        this->kind = Kind::Byte;
+        return;
+    }
+    if (needle.size() <= SHORT_NEEDLE_MAX) {
+        this->kind = Kind::Short;
+        return;
+    }
+    this->kind = Kind::Long;
+
+    const TwoWayFactor factor = two_way_factor(needle);
+    this->critical_pos        = factor.critical_pos;
+    this->period              = factor.period;
+    this->is_periodic         = factor.is_periodic;
+
+    this->shift.assign(256, 0);
+    for (size_t i = 0; i < needle.size(); i++) {
+        this->shift[static_cast<u8>(needle[i])] = i + 1;
+    }
+}
+
+auto Searcher::needle() const -> std::string_view {
+    return this->needle_;
+}
+
+auto Searcher::next(const std::string_view haystack, const size_t start) const
+    -> size_t {
+    if (start >= haystack.size()) {
+        return this->kind == Kind::Empty ? std::min(start, haystack.size())
+                                         : haystack.size();
+    }
+    const char *data  = haystack.data() + start;
+    const size_t size = haystack.size() - start;
+    size_t found      = size;
+    switch (this->kind) {
+    case Kind::Empty: return start;
+    case Kind::Byte:
+        found = scan_ops().find_byte(data, size, this->needle_[0]);
+        break;
+    case Kind::Short:
+        found = scan_ops().find_substr(data, size, this->needle_.data(),
+                                       this->needle_.size());
+        break;
+    case Kind::Long: return this->next_two_way(haystack, start);
+    }
+    return found == size ? haystack.size() : start + found;
+}
+
+auto Searcher::next_two_way(const std::string_view haystack, size_t start) const
+    -> size_t {
+    const TwoWayFactor factor{this->critical_pos, this->period,
+                              this->is_periodic};
+    return two_way_next(factor, this->needle_, haystack, start,
+                        [&](const unsigned char c) { return this->shift[c]; });
+}
+
+auto find(const Searcher &needle, const std::string_view haystack)
+    -> std::optional<size_t> {
+    const size_t out = needle.next(haystack);
+    if (out == haystack.size() and !needle.needle().empty()) { return {}; }
+    return out;
+}
+
+auto count_matches(const Searcher &needle, const std::string_view haystack)
+    -> size_t {
+    const size_t len = needle.needle().size();
+    if (len == 0) { return 0; }
+    size_t output = 0;
+    for (size_t pos = needle.next(haystack); pos < haystack.size();
+         pos        = needle.next(haystack, pos + len)) {
+        output++;
+    }
+    return output;
+}
+
+auto operator<<(std::ostream &os, const MultiMatch &rhs) -> std::ostream & {
+    os << "MultiMatch { .pos = " << rhs.pos << ", .len = " << rhs.len
+       << ", .needle = " << rhs.needle << " }";
+    return os;
+}
+
+MultiSearcher::MultiSearcher(const std::vector<std::string> &needles)
+    : needles_{needles} {
+    for (const auto &needle : needles) {
+        for (const char c : needle) {
+            u16 &cls = this->byte_class[static_cast<u8>(c)];
+            if (cls == 0) { cls = static_cast<u16>(this->class_count++); }
+        }
+        if (!needle.empty() and !this->is_start[static_cast<u8>(needle[0])]) {
+            this->is_start[static_cast<u8>(needle[0])] = true;
+            this->start_bytes += needle[0];
+        }
+    }
+    const size_t classes = this->class_count;
+
+    // The trie, with missing edges marked.
+    const u32 missing = std::numeric_limits<u32>::max();
+    this->transitions.assign(classes, missing);
+    this->depth = {0};
+    this->match = {0};
+    for (size_t i = 0; i < needles.size(); i++) {
+        u32 state = 0;
+        for (const char c : needles[i]) {
+            const size_t edge = state * classes + this->byte_class[u8(c)];
+            if (this->transitions[edge] == missing) {
+                this->transitions[edge] = static_cast<u32>(this->depth.size());
+                this->transitions.resize(this->transitions.size() + classes,
+                                         missing);
+                this->depth.push_back(this->depth[state] + 1);
+                this->match.push_back(0);
+            }
+            state = this->transitions[edge];
+        }
+        // The first of any duplicate needles wins.
+        if (!needles[i].empty() and this->match[state] == 0) {
+            this->match[state] = static_cast<u32>(i + 1);
+        }
+    }
+
+    // Breadth first, each missing edge takes its failure state's edge, so
+    // the scan never follows failure links. A state with no needle of its own
+    // inherits the longest one ending at its failure state.
+    std::vector<u32> fail(this->depth.size(), 0);
+    std::vector<u32> queue = {};
+    queue.reserve(this->depth.size());
+    for (size_t c = 0; c < classes; c++) {
+        u32 &child = this->transitions[c];
+        if (child == missing) {
+            child = 0;
+        } else {
+            queue.push_back(child);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        const u32 state = queue[head];
+        for (size_t c = 0; c < classes; c++) {
+            u32 &child           = this->transitions[state * classes + c];
+            const u32 fail_child = this->transitions[fail[state] * classes + c];
+            if (child == missing) {
+                child = fail_child;
+                continue;
+            }
+            fail[child] = fail_child;
+            if (this->match[child] == 0) {
+                this->match[child] = this->match[fail_child];
+            }
+            queue.push_back(child);
+        }
+    }
+}
+
+auto MultiSearcher::needles() const -> const std::vector<std::string> & {
+    return this->needles_;
+}
+
+// Only called from the root, where every byte that can't start a needle is
+// a dead end.
+auto MultiSearcher::skip_to_start(const std::string_view haystack,
+                                  size_t pos) const -> size_t {
+    const char *data  = haystack.data();
+    const size_t size = haystack.size();
+    const auto &bytes = this->start_bytes;
+    if (bytes.size() == 1) {
+        return pos + scan_ops().find_byte(data + pos, size - pos, bytes[0]);
+    }
+#ifdef KHELPER_X86
+    if (bytes.size() <= 4) {
+        __m128i targets[4];
+        for (size_t i = 0; i < 4; i++) {
+            targets[i] = _mm_set1_epi8(bytes[std::min(i, bytes.size() - 1)]);
+        }
+        for (; pos + 16 <= size; pos += 16) {
+            const auto *ptr     = reinterpret_cast<const __m128i *>(data + pos);
+            const __m128i block = _mm_loadu_si128(ptr);
+            const __m128i hits = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(block, targets[0]),
+                             _mm_cmpeq_epi8(block, targets[1])),
+                _mm_or_si128(_mm_cmpeq_epi8(block, targets[2]),
+                             _mm_cmpeq_epi8(block, targets[3])));
+            const u32 mask = _mm_movemask_epi8(hits);
+            if (mask != 0) { return pos + __builtin_ctz(mask); }
+        }
+    }
+#endif
+    while (pos < size and !this->is_start[static_cast<u8>(data[pos])]) {
+        pos++;
+    }
+    return pos;
+}
+
+auto MultiSearcher::next(const std::string_view haystack,
+                         const size_t start) const
+    -> std::optional<MultiMatch> {
+    if (this->start_bytes.empty()) { return {}; }
+    const auto *data     = reinterpret_cast<const u8 *>(haystack.data());
+    const size_t size    = haystack.size();
+    const size_t classes = this->class_count;
+
+    std::optional<MultiMatch> best = {};
+    u32 state                      = 0;
+    for (size_t i = start; i < size; i++) {
+        if (state == 0) {
+            // Nothing in progress can start early enough to beat `best`.
+            if (best) { break; }
+            i = this->skip_to_start(haystack, i);
+            if (i == size) { break; }
+        }
+        state = this->transitions[state * classes + this->byte_class[data[i]]];
+        // Every match still to come starts at or after i + 1 - depth.
+        if (best and i + 1 - this->depth[state] > best->pos) { break; }
+        if (const u32 found = this->match[state]; found != 0) {
+            const size_t len = this->needles_[found - 1].size();
+            const size_t pos = i + 1 - len;
+            if (!best or pos < best->pos
+                or (pos == best->pos and len > best->len)) {
+                best = MultiMatch{pos, len, found - 1};
+            }
+        }
+    }
+    return best;
+}
+
+auto find_any(const MultiSearcher &needles, const std::string_view haystack)
+    -> std::optional<MultiMatch> {
+    return needles.next(haystack);
+}
+
+auto find_all(const MultiSearcher &needles, const std::string_view haystack)
+    -> std::vector<MultiMatch> {
+    std::vector<MultiMatch> output = {};
+    for (auto it = needles.next(haystack); it;
+         it      = needles.next(haystack, it->pos + it->len)) {
+        output.push_back(it.value());
+    }
+    return output;
+}
+
+auto replace_all(const MultiSearcher &from, const std::vector<std::string> &to,
+                 const std::string_view input) -> std::string {
+    std::string output = {};
+    output.reserve(input.size());
+    size_t done = 0;
+    for (auto it = from.next(input); it; it = from.next(input, done)) {
+        output.append(input.data() + done, it->pos - done);
+        if (it->needle < to.size()) { output += to[it->needle]; }
+        done = it->pos + it->len;
+    }
+    output.append(input.data() + done, input.size() - done);
+    return output;
+}
+
+auto replace_all(const std::map<std::string, std::string> &replacements,
+                 const std::string_view input) -> std::string {
+    std::vector<std::string> from = {};
+    std::vector<std::string> to   = {};
+    from.reserve(replacements.size());
+    to.reserve(replacements.size());
+    for (const auto &[key, value] : replacements) {
+        from.push_back(key);
+        to.push_back(value);
+    }
+    return replace_all(MultiSearcher{from}, to, input);
+}
+
+/// STRING
+// clang-format off
+// Can go to https://gist.github.com/JBlond/2fea43a3049b38287e5e9cefc87b2124
+// if I want to implement more.
+auto black(const std::string_view input)            -> std::string { return "\e[0;30m" + std::string{input} + "\e[0m"; }
+auto red(const std::string_view input)              -> std::string { return "\e[0;31m" + std::string{input} + "\e[0m"; }
+auto green(const std::string_view input)            -> std::string { return "\e[0;32m" + std::string{input} + "\e[0m"; }
+auto yellow(const std::string_view input)           -> std::string { return "\e[0;33m" + std::string{input} + "\e[0m"; }
+auto blue(const std::string_view input)             -> std::string { return "\e[0;34m" + std::string{input} + "\e[0m"; }
+auto purple(const std::string_view input)           -> std::string { return "\e[0;35m" + std::string{input} + "\e[0m"; }
+auto cyan(const std::string_view input)             -> std::string { return "\e[0;36m" + std::string{input} + "\e[0m"; }
+auto white(const std::string_view input)            -> std::string { return "\e[0;37m" + std::string{input} + "\e[0m"; }
+auto black_bold(const std::string_view input)       -> std::string { return "\e[1;30m" + std::string{input} + "\e[0m"; }
+auto red_bold(const std::string_view input)         -> std::string { return "\e[1;31m" + std::string{input} + "\e[0m"; }
+auto green_bold(const std::string_view input)       -> std::string { return "\e[1;32m" + std::string{input} + "\e[0m"; }
+auto yellow_bold(const std::string_view input)      -> std::string { return "\e[1;33m" + std::string{input} + "\e[0m"; }
+auto blue_bold(const std::string_view input)        -> std::string { return "\e[1;34m" + std::string{input} + "\e[0m"; }
+auto purple_bold(const std::string_view input)      -> std::string { return "\e[1;35m" + std::string{input} + "\e[0m"; }
+auto cyan_bold(const std::string_view input)        -> std::string { return "\e[1;36m" + std::string{input} + "\e[0m"; }
+auto white_bold(const std::string_view input)       -> std::string { return "\e[1;37m" + std::string{input} + "\e[0m"; }
+auto black_underline(const std::string_view input)  -> std::string { return "\e[4;30m" + std::string{input} + "\e[0m"; }
+auto red_underline(const std::string_view input)    -> std::string { return "\e[4;31m" + std::string{input} + "\e[0m"; }
+auto green_underline(const std::string_view input)  -> std::string { return "\e[4;32m" + std::string{input} + "\e[0m"; }
+auto yellow_underline(const std::string_view input) -> std::string { return "\e[4;33m" + std::string{input} + "\e[0m"; }
+auto blue_underline(const std::string_view input)   -> std::string { return "\e[4;34m" + std::string{input} + "\e[0m"; }
+auto purple_underline(const std::string_view input) -> std::string { return "\e[4;35m" + std::string{input} + "\e[0m"; }
+auto cyan_underline(const std::string_view input)   -> std::string { return "\e[4;36m" + std::string{input} + "\e[0m"; }
+auto white_underline(const std::string_view input)  -> std::string { return "\e[4;37m" + std::string{input} + "\e[0m"; }
+auto black_bg(const std::string_view input)         -> std::string { return "\e[40m" + std::string{input} + "\e[0m"; }
+auto red_bg(const std::string_view input)           -> std::string { return "\e[41m" + std::string{input} + "\e[0m"; }
+auto green_bg(const std::string_view input)         -> std::string { return "\e[42m" + std::string{input} + "\e[0m"; }
+auto yellow_bg(const std::string_view input)        -> std::string { return "\e[43m" + std::string{input} + "\e[0m"; }
+auto blue_bg(const std::string_view input)          -> std::string { return "\e[44m" + std::string{input} + "\e[0m"; }
+auto purple_bg(const std::string_view input)        -> std::string { return "\e[45m" + std::string{input} + "\e[0m"; }
+auto cyan_bg(const std::string_view input)          -> std::string { return "\e[46m" + std::string{input} + "\e[0m"; }
+auto white_bg(const std::string_view input)         -> std::string { return "\e[47m" + std::string{input} + "\e[0m"; }
+// clang-format on
+
+auto args_vec(int argc, const char **argv) -> std::vector<std::string> {
+    std::vector<std::string> output = {};
+    for (int i = 0; i < argc; i++) {
+        output.push_back(argv[i]);
+    }
+    return output;
+}
+
+auto string_break(const std::string_view input) -> std::vector<std::string> {
+    std::vector<std::string> output = {};
+    std::string tmp                 = "";
+    bool in_string                  = false;
+    char previous_char_is_backslash = false;
+
+    for (size_t i = 0; i < input.size(); i++) {
+        // Handling backslash
+        if (input[i] == '\\') {
+            // Marking an escape character.
+            previous_char_is_backslash = true;
+            tmp += input[i];
+            continue;
+        }
+
+        // "string" = multiple whitespace-separated words.
+        // "word" = singular word.
+        if (input[i] == '\"' and !previous_char_is_backslash and !in_string) {
+            // Starting string
+            if (!tmp.empty()) {
+                output.push_back(tmp);
+                tmp.clear();
+            }
+            in_string = true;
+        } else if (in_string and input[i] != '\"') {
+            // In a string and continuing.
+            tmp += input[i];
+        } else if (in_string and previous_char_is_backslash
+                   and input[i] == '\"') {
+            // Found an escaped double quote in a string.
+            tmp += input[i];
+        } else if (in_string and !previous_char_is_backslash
+                   and input[i] == '\"') {
+            // Exiting a string.
+            if (!tmp.empty()) {
+                output.push_back(tmp);
+                tmp.clear();
+            }
+        } else if (previous_char_is_backslash and input[i] == '\"') {
+            // Found an escaped double quote.
+            tmp += input[i];
+        } else if (!std::isspace(input[i])) {
+            // In word
+            tmp += input[i];
+        } else if (std::isspace(input[i]) and !tmp.empty()) {
+            // Ending word
+            output.push_back(tmp);
+            tmp.clear();
+        }
+        previous_char_is_backslash = false;
+    }
+
+    if (!tmp.empty()) { output.push_back(tmp); }
+    return output;
+}
+
+namespace {
+// What each byte means to the shell tokenizer, so the scan is one lookup per
+// byte rather than a chain of comparisons.
+enum class ShellClass : u8 { Word, Space, Single, Double, Escape };
+
+constexpr auto shell_classes() -> std::array<ShellClass, 256> {
+    std::array<ShellClass, 256> table = {};
+    for (const char c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+        table[static_cast<u8>(c)] = ShellClass::Space;
+    }
+    table[static_cast<u8>('\'')] = ShellClass::Single;
+    table[static_cast<u8>('"')]  = ShellClass::Double;
+    table[static_cast<u8>('\\')] = ShellClass::Escape;
+    return table;
+}
+
+constexpr std::array<ShellClass, 256> SHELL_CLASSES = shell_classes();
+
+auto shell_class(const char c) -> ShellClass {
+    return SHELL_CLASSES[static_cast<u8>(c)];
+}
+
+// Decodes the word at `input[i]` into `out` and returns its length, leaving
+// `i` on the byte after it. Each byte written uses up at least one byte of
+// input, so `out` never needs more room than what's left of it.
+auto shell_decode(char *out, const std::string_view input, size_t &i)
+    -> size_t {
+    const size_t size = input.size();
+    size_t length     = 0;
+    while (i < size) {
+        switch (shell_class(input[i])) {
+        case ShellClass::Word: out[length++] = input[i++]; break;
+        case ShellClass::Space: return length;
+        case ShellClass::Escape:
+            if (i + 1 == size) {
+                out[length++] = input[i++];
+            } else if (input[i + 1] != '\n') {
+                out[length++] = input[i + 1];
+                i += 2;
+            } else {
+                i += 2;
+            }
+            break;
+        case ShellClass::Single: {
+            const size_t end  = std::min(input.find('\'', i + 1), size);
+            const size_t span = end - i - 1;
+            std::memcpy(out + length, input.data() + i + 1, span);
+            length += span;
+            i = std::min(end + 1, size);
+            break;
+        }
+        case ShellClass::Double:
+            for (i++; i < size and input[i] != '"'; i++) {
+                const char c = input[i];
+                if (c == '\\' and i + 1 < size) {
+                    const char next = input[i + 1];
+                    if (next == '\n') {
+                        i++;
+                        continue;
+                    }
+                    if (next == '"' or next == '\\' or next == '$'
+                        or next == '`') {
+                        out[length++] = next;
+                        i++;
+                        continue;
+                    }
+                }
+                out[length++] = c;
+            }
+            i = std::min(i + 1, size);
+            break;
+        }
+    }
+    return length;
+}
+
+// Pushes the words of `input` onto `words`. Words made only of plain bytes are
+// views of the input. The first word that needs decoding calls
+// `reserve(bytes)` for a buffer that every decoded word after it fits in too.
+template <typename Reserve>
+void shell_words(std::vector<std::string_view> &words, Reserve reserve,
+                 const std::string_view input) {
+    const size_t size = input.size();
+    char *buffer      = nullptr;
+    size_t used       = 0;
+    size_t i          = 0;
+    while (true) {
+        while (i < size and shell_class(input[i]) == ShellClass::Space) { i++; }
+        if (i == size) { break; }
+        const size_t start = i;
+        while (i < size and shell_class(input[i]) == ShellClass::Word) { i++; }
+        if (i == size or shell_class(input[i]) == ShellClass::Space) {
+            words.push_back(input.substr(start, i - start));
+            continue;
+        }
+        if (buffer == nullptr) { buffer = reserve(size - start); }
+        char *out = buffer + used;
+        std::memcpy(out, input.data() + start, i - start);
+        size_t length = i - start;
+        length += shell_decode(out + length, input, i);
+        words.push_back({out, length});
+        used += length;
+    }
+}
+} // namespace
+
+auto shell_split(const std::string_view input) -> ShellWords {
+    ShellWords output = {};
+    shell_words(
+        output.words,
+        [&](const size_t bytes) {
+            output.decoded = UPtr<char[]>{new char[bytes]};
+            return output.decoded.get();
+        },
+        input);
+    return output;
+}
+
+auto shell_split(std::pmr::memory_resource &arena, const std::string_view input)
+    -> std::vector<std::string_view> {
+    std::vector<std::string_view> output = {};
+    shell_words(
+        output,
+        [&](const size_t bytes) {
+            return static_cast<char *>(arena.allocate(bytes, 1));
+        },
+        input);
+    return output;
+}
+
+auto ShellSplitter::split(const std::string_view line)
+    -> const std::vector<std::string_view> & {
+    this->words.clear();
+    shell_words(
+        this->words,
+        [&](const size_t bytes) {
+            if (this->decoded.size() < bytes) { this->decoded.resize(bytes); }
+            return this->decoded.data();
+        },
+        line);
+    return this->words;
+}
+auto quote_string(const std::string_view input) -> std::string {
+    return "\"" + std::string{input} + "\"";
+}
+
+auto split(const std::string_view input, const char &delim)
+    -> std::vector<std::string> {
+    std::vector<std::string> output = {};
+    output.reserve(count_byte(delim, input) + 1);
+    for (const auto &it : split_view(delim, input)) {
+        output.emplace_back(it);
+    }
+    return output;
+}
+
+auto split(std::pmr::memory_resource &arena, const std::string_view input,
+           const char &delim) -> std::pmr::vector<std::pmr::string> {
+    std::pmr::vector<std::pmr::string> output{&arena};
+    output.reserve(count_byte(delim, input) + 1);
+    for (const auto &it : split_view(delim, input)) {
+        output.emplace_back(it);
+    }
+    return output;
+}
+
+auto split_any(const CharSet &delims, const std::string_view input)
+    -> std::vector<std::string> {
+    std::vector<std::string> output = {};
+    for (const auto &it : split_any_view(delims, input)) {
+        output.emplace_back(it);
+    }
+    return output;
+}
+
+auto trim(const std::string_view input) -> std::string_view {
+    return trim(ASCII_WHITESPACE, input);
+}
+
+auto trim(const CharSet &chars, const std::string_view input)
+    -> std::string_view {
+    return trim_end(chars, trim_start(chars, input));
+}
+
+auto trim_start(const std::string_view input) -> std::string_view {
+    return trim_start(ASCII_WHITESPACE, input);
+}
+
+auto trim_start(const CharSet &chars, const std::string_view input)
+    -> std::string_view {
+    return input.substr(
+        scan_ops().find_set(input.data(), input.size(), chars, false));
+}
+
+auto trim_end(const std::string_view input) -> std::string_view {
+    return trim_end(ASCII_WHITESPACE, input);
+}
+
+// Trailing runs are short, so this stays a plain backwards loop.
+auto trim_end(const CharSet &chars, const std::string_view input)
+    -> std::string_view {
+    size_t end = input.size();
+    while (end > 0 and chars.contains(input[end - 1])) {
+        end--;
+    }
+    return input.substr(0, end);
+}
+
+auto find(const std::string_view needle, const std::string_view haystack)
+    -> std::optional<size_t> {
+    // Short needles go straight to the scan kernels, skipping the Searcher's
+    // copy of the needle.
+    if (needle.size() >= 2 and needle.size() <= SHORT_NEEDLE_MAX) {
+        const size_t out = scan_ops().find_substr(
+            haystack.data(), haystack.size(), needle.data(), needle.size());
+        if (out == haystack.size()) { return {}; }
+        return out;
+    }
+    // Long needles run Two-Way without the Searcher's shift table, which
+    // would cost an allocation. A 256-bit set of the needle's bytes still
+    // skips whole windows that end on a byte the needle lacks.
+    if (needle.size() > SHORT_NEEDLE_MAX) {
+        u64 present[4] = {};
+        for (const char c : needle) {
+            const u8 byte = static_cast<u8>(c);
+            present[byte >> 6] |= u64{1} << (byte & 63);
+        }
+        const size_t len = needle.size();
+        const size_t out = two_way_next(
+            two_way_factor(needle), needle, haystack, 0,
+            [&](const unsigned char c) -> size_t {
+                return (present[c >> 6] >> (c & 63) & 1) != 0 ? len : 0;
+            });
+        if (out == haystack.size()) { return {}; }
+        return out;
+    }
+    // Empty and single-byte needles fit the Searcher's small-string buffer.
+    return find(Searcher{needle}, haystack);
+}
+
+// This one is really starting to push that line between just an aesthetic
+// wrapper.
+auto slice(const size_t start, const std::string &input) -> std::string {
+    return input.substr(start);
+}
+
+auto slice(const size_t start, const size_t end, const std::string &input)
+    -> std::string {
+    return input.substr(start, end - start);
+}
+
+auto replace(const std::string_view input, const std::string_view from,
+             const std::string_view to) -> std::string {
+    return replace(input, Searcher{from}, to);
+}
+
+auto replacen(const std::string_view input, const std::string_view from,
+              const std::string_view to, const size_t max_count)
+    -> std::string {
+    return replacen(input, Searcher{from}, to, max_count);
+}
+
+auto replace(const std::string_view input, const Searcher &from,
+             const std::string_view to) -> std::string {
+    return replacen(input, from, to, std::numeric_limits<size_t>::max());
+}
+
+namespace {
+// The output is allocated once: at the input's size when replacing can only
+// shrink it, trimmed after a single pass, and otherwise at its exact size
+// after a pass that counts the matches. Either way it's filled with bulk
+// copies. `output` comes in empty, with the allocator to use.
+template <typename S>
+auto replacen_into(S output, const std::string_view input, const Searcher &from,
+                   const std::string_view to, const size_t max_count) -> S {
+    const size_t from_len = from.needle().size();
+    if (from_len == 0 or max_count == 0) {
+        output.assign(input);
+        return output;
+    }
+
+    size_t count = max_count;
+    if (to.size() > from_len) {
+        count = 0;
+        for (size_t pos = from.next(input);
+             pos < input.size() and count < max_count;
+             pos = from.next(input, pos + from_len)) {
+            count++;
+        }
+        if (count == 0) {
+            output.assign(input);
+            return output;
+        }
+    }
+
+    output.resize(to.size() > from_len
+                      ? input.size() + count * (to.size() - from_len)
+                      : input.size());
+    char *out   = output.data();
+    size_t done = 0;
+    for (size_t i = 0; i < count; i++) {
+        const size_t pos = from.next(input, done);
+        if (pos >= input.size()) { break; }
+        memcpy(out, input.data() + done, pos - done);
+        out += pos - done;
+        memcpy(out, to.data(), to.size());
+        out += to.size();
+        done = pos + from_len;
+    }
+    memcpy(out, input.data() + done, input.size() - done);
+    out += input.size() - done;
+    output.resize(out - output.data());
+    return output;
+}
+} // namespace
+
+auto replacen(const std::string_view input, const Searcher &from,
+              const std::string_view to, const size_t max_count)
+    -> std::string {
+    return replacen_into(std::string{}, input, from, to, max_count);
+}
+
+auto replace(std::pmr::memory_resource &arena, const std::string_view input,
+             const std::string_view from, const std::string_view to)
+    -> std::pmr::string {
+    return replace(arena, input, Searcher{from}, to);
+}
+
+auto replace(std::pmr::memory_resource &arena, const std::string_view input,
+             const Searcher &from, const std::string_view to)
+    -> std::pmr::string {
+    return replacen_into(std::pmr::string{&arena}, input, from, to,
+                         std::numeric_limits<size_t>::max());
+}
+
+auto lines(const std::string &input) -> std::vector<std::string> {
+    std::vector<std::string> output = {};
+    output.reserve(count_byte('\n', input) + 1);
+    for (const auto &it : lines_view(input)) {
+        output.emplace_back(it);
+    }
+    return output;
+}
+
+auto lines(std::pmr::memory_resource &arena, const std::string_view input)
+    -> std::pmr::vector<std::pmr::string> {
+    std::pmr::vector<std::pmr::string> output{&arena};
+    output.reserve(count_byte('\n', input) + 1);
+    for (const auto &it : lines_view(input)) {
+        output.emplace_back(it);
+    }
+    return output;
+}
+
+namespace {
+// Sizes the output exactly before copying anything, so it allocates once.
+template <typename S, typename Parts>
+auto join_into(S output, const std::string_view sep, const Parts &parts)
+    -> S {
+    if (parts.size() == 0) { return output; }
+    size_t size = sep.size() * (parts.size() - 1);
+    for (const auto &it : parts) {
+        size += std::string_view{it}.size();
+    }
+    output.reserve(size);
+
+    bool first = true;
+    for (const auto &it : parts) {
+        if (!first) { output.append(sep); }
+        output.append(std::string_view{it});
+        first = false;
+    }
+    return output;
+}
+} // namespace
+
+auto join(const std::string_view sep, const std::vector<std::string> &parts)
+    -> std::string {
+    return join_into(std::string{}, sep, parts);
+}
+
+auto join(const std::string_view sep,
+          const std::vector<std::string_view> &parts) -> std::string {
+    return join_into(std::string{}, sep, parts);
+}
+
+auto join(const std::string_view sep,
+          const std::initializer_list<std::string_view> parts) -> std::string {
+    return join_into(std::string{}, sep, parts);
+}
+
+auto join(std::pmr::memory_resource &arena, const std::string_view sep,
+          const std::vector<std::string_view> &parts) -> std::pmr::string {
+    return join_into(std::pmr::string{&arena}, sep, parts);
+}
+
+auto starts_with(const std::string_view needle, const std::string_view haystack)
+    -> bool {
+    return needle.size() <= haystack.size()
+       and haystack.compare(0, needle.size(), needle) == 0;
+}
+
+auto ends_with(const std::string_view needle, const std::string_view haystack)
+    -> bool {
+    return needle.size() <= haystack.size()
+       and haystack.compare(haystack.size() - needle.size(), needle.size(),
+                            needle)
+               == 0;
+}
+
+auto to_lowercase(const std::string_view input) -> std::string {
+    std::string output{input};
+    make_lowercase(output);
+    return output;
+}
+
+auto to_uppercase(const std::string_view input) -> std::string {
+    std::string output{input};
+    make_uppercase(output);
+    return output;
+}
+
+auto make_lowercase(std::string &input) -> void {
+    scan_ops().convert_case(input.data(), input.size(), 'A');
+}
+
+auto make_uppercase(std::string &input) -> void {
+    scan_ops().convert_case(input.data(), input.size(), 'a');
+}
+
+auto iequals(const std::string_view lhs, const std::string_view rhs) -> bool {
+    return lhs.size() == rhs.size()
+       and scan_ops().equal_icase(lhs.data(), rhs.data(), lhs.size());
+}
+
+auto istarts_with(const std::string_view needle,
+                  const std::string_view haystack) -> bool {
+    return needle.size() <= haystack.size()
+       and iequals(needle, haystack.substr(0, needle.size()));
+}
+
+auto iends_with(const std::string_view needle, const std::string_view haystack)
+    -> bool {
+    return needle.size() <= haystack.size()
+       and iequals(needle, haystack.substr(haystack.size() - needle.size()));
+}
+
+auto ifind(const std::string_view needle, const std::string_view haystack)
+    -> std::optional<size_t> {
+    if (needle.empty()) { return 0; }
+    const size_t out = scan_ops().find_substr_icase(
+        haystack.data(), haystack.size(), needle.data(), needle.size());
+    if (out == haystack.size()) { return {}; }
+    return out;
+}
+
+auto strip_prefix(const std::string_view prefix, const std::string_view input)
+    -> std::optional<std::string> {
+    if (starts_with(prefix, input)) {
+        return std::string{input.substr(prefix.size())};
+    }
+    return {};
+}
+auto strip_suffix(const std::string_view suffix, const std::string_view input)
+    -> std::optional<std::string> {
+    if (ends_with(suffix, input)) {
+        return std::string{input.substr(0, input.size() - suffix.size())};
+    }
+    return {};
+}
+
+/// UTF-8
+namespace {
+// The byte offset of code point `index` of [data, data + size), or `size`.
+// Start bytes are counted a word at a time until the word holding it.
+auto utf8_advance(const char *data, const size_t size, size_t index)
+    -> size_t {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        u64 word;
+        memcpy(&word, data + i, 8);
+        const size_t starts = __builtin_popcountll(utf8_starts(word));
+        if (starts > index) { break; }
+        index -= starts;
+    }
+    for (; i < size; i++) {
+        if ((data[i] & 0xc0) == 0x80) { continue; }
+        if (index == 0) { return i; }
+        index--;
+    }
+    return size;
+}
+
+// The code point starting at byte `pos`, as a view.
+auto utf8_char_at(const size_t pos, const std::string_view input)
+    -> std::optional<std::string_view> {
+    if (pos >= input.size()) { return {}; }
+    const size_t end
+        = pos + 1
+        + utf8_advance(input.data() + pos + 1, input.size() - pos - 1, 0);
+    return input.substr(pos, end - pos);
+}
+} // namespace
+
+auto utf8_validate(const std::string_view input) -> bool {
+    return scan_ops().utf8_valid(input.data(), input.size());
+}
+
+auto char_count(const std::string_view input) -> size_t {
+    return scan_ops().char_count(input.data(), input.size());
+}
+
+auto char_slice(const size_t start, const size_t end,
+                const std::string_view input) -> std::string_view {
+    const size_t first = utf8_advance(input.data(), input.size(), start);
+    if (end <= start) { return input.substr(first, 0); }
+    const size_t last = first
+                      + utf8_advance(input.data() + first,
+                                     input.size() - first, end - start);
+    return input.substr(first, last - first);
+}
+
+auto char_slice(const size_t start, const std::string_view input)
+    -> std::string_view {
+    return input.substr(utf8_advance(input.data(), input.size(), start));
+}
+
+auto char_nth(const size_t index, const std::string_view input)
+    -> std::optional<std::string_view> {
+    return utf8_char_at(utf8_advance(input.data(), input.size(), index),
+                        input);
+}
+
+Utf8Index::Utf8Index(const std::string_view input) : input_(input) {
+    const char *data = input.data();
+    size_t i         = 0;
+    for (; i + 8 <= input.size(); i += 8) {
+        u64 word;
+        memcpy(&word, data + i, 8);
+        const size_t starts = __builtin_popcountll(utf8_starts(word));
+        // Only words holding a multiple of STRIDE need a closer look.
+        const size_t next_mark
+            = (this->count + STRIDE - 1) / STRIDE * STRIDE;
+        if (this->count + starts <= next_mark) {
+            this->count += starts;
+            continue;
+        }
+        for (size_t k = i; k < i + 8; k++) {
+            if ((data[k] & 0xc0) == 0x80) { continue; }
+            if (this->count % STRIDE == 0) { this->offsets.push_back(k); }
+            this->count++;
+        }
+    }
+    for (; i < input.size(); i++) {
+        if ((data[i] & 0xc0) == 0x80) { continue; }
+        if (this->count % STRIDE == 0) { this->offsets.push_back(i); }
+        this->count++;
+    }
+}
+
+auto Utf8Index::offset(const size_t index) const -> size_t {
+    if (index >= this->count) { return this->input_.size(); }
+    const size_t base = this->offsets[index / STRIDE];
+    return base
+         + utf8_advance(this->input_.data() + base,
+                        this->input_.size() - base, index % STRIDE);
+}
+
+auto Utf8Index::size() const -> size_t {
+    return this->count;
+}
+
+auto Utf8Index::input() const -> std::string_view {
+    return this->input_;
+}
+
+auto char_slice(const size_t start, const size_t end, const Utf8Index &input)
+    -> std::string_view {
+    const size_t first = input.offset(start);
+    const size_t last  = end <= start ? first : input.offset(end);
+    return input.input().substr(first, last - first);
+}
+
+auto char_nth(const size_t index, const Utf8Index &input)
+    -> std::optional<std::string_view> {
+    return utf8_char_at(input.offset(index), input.input());
+}
+
+/// STRING VIEWS
+namespace {
+// Moves `it` onto the token that starts at or after `it.pos`.
+auto split_view_advance(SplitView::Iterator &it) -> void {
+    const std::string_view input = it.view->input;
+    size_t pos                   = it.pos;
+
+    switch (it.view->mode) {
+    case SplitView::Mode::Delim: {
+        while (pos < input.size() and input[pos] == it.view->delim) {
+            pos++;
+        }
+        if (pos >= input.size()) { break; }
+        const size_t end = pos + scan_ops().find_byte(input.data() + pos,
+                                                      input.size() - pos,
+                                                      it.view->delim);
+        it.token = input.substr(pos, end - pos);
+        it.pos   = end;
+        it.done  = false;
+        return;
+    }
+    case SplitView::Mode::Lines: {
+        if (pos >= input.size()) { break; }
+        const size_t end = pos + scan_ops().find_byte(input.data() + pos,
+                                                      input.size() - pos, '\n');
+        if (end == input.size()) {
+            it.token = input.substr(pos);
+            it.pos   = input.size();
+        } else {
+            it.token = input.substr(pos, end - pos);
+            it.pos   = end + 1;
+        }
+        it.done = false;
+        return;
+    }
+    case SplitView::Mode::Words:
+    case SplitView::Mode::Any: {
+        const CharSet &set = it.view->mode == SplitView::Mode::Words
+                               ? ASCII_WHITESPACE
+                               : it.view->set;
+        // Runs of delimiters are short, so they're skipped byte by byte.
+        while (pos < input.size() and set.contains(input[pos])) {
+            pos++;
+        }
+        if (pos >= input.size()) { break; }
+        const size_t end = pos + scan_ops().find_set(input.data() + pos,
+                                                     input.size() - pos, set,
+                                                     true);
+        it.token = input.substr(pos, end - pos);
+        it.pos   = end;
+        it.done  = false;
+        return;
+    }
+    }
+
+    it.token = {};
+    it.pos   = input.size();
+    it.done  = true;
+}
+} // namespace
+
+auto SplitView::Iterator::operator++() -> Iterator & {
+    if (!this->done) { split_view_advance(*this); }
+    return *this;
+}
+
+auto SplitView::Iterator::operator++(int) -> Iterator {
+    Iterator previous = *this;
+    ++(*this);
+    return previous;
+}
+
+auto SplitView::begin() const -> Iterator {
+    Iterator it{};
+    it.view = this;
+    it.pos  = 0;
+    split_view_advance(it);
+    return it;
+}
+
+auto SplitView::end() const -> Iterator {
+    Iterator it{};
+    it.view = this;
+    it.pos  = this->input.size();
+    return it;
+}
+
+auto SplitView::count() const -> size_t {
+    size_t output = 0;
+    for (auto it = this->begin(); it != this->end(); ++it) {
+        output++;
+    }
+    return output;
+}
+
+auto SplitView::empty() const -> bool {
+    return this->begin() == this->end();
+}
+
+auto SplitView::to_vec() const -> std::vector<std::string_view> {
+    std::vector<std::string_view> output = {};
+    output.reserve(this->count());
+    for (const auto &it : *this) {
+        output.push_back(it);
+    }
+    return output;
+}
+
+auto split_view(const char delim, const std::string_view input) -> SplitView {
+    return SplitView{input, delim, SplitView::Mode::Delim};
+}
+
+auto split_any_view(const CharSet &delims, const std::string_view input)
+    -> SplitView {
+    return SplitView{input, '\0', SplitView::Mode::Any, delims};
+}
+
+auto lines_view(const std::string_view input) -> SplitView {
+    return SplitView{input, '\n', SplitView::Mode::Lines};
+}
+
+auto words_view(const std::string_view input) -> SplitView {
+    return SplitView{input, ' ', SplitView::Mode::Words};
+}
+
+auto operator<<(std::ostream &os, const SplitView &rhs) -> std::ostream & {
+    os << "SplitView { ";
+    bool first = true;
+    for (const auto &it : rhs) {
+        if (!first) { os << ", "; }
+        os << it;
+        first = false;
+    }
+    os << " }";
+    return os;
+}
+
+/// VECTOR
+auto flag_value(const std::string_view lead_value,
+                const std::vector<std::string> &input)
+    -> std::optional<std::string> {
+    for (size_t i = 0; i < input.size(); i++) {
+        if (input[i] == lead_value and i < input.size() - 1) {
+            return make_optional(std::string{input[i + 1]});
+        }
+    }
+    return {};
+}
+
+/// FORMATTING
+namespace {
+// "00" "01" ... "99", so integers are written two digits per division.
+struct DigitPairs {
+    constexpr DigitPairs() : data{} {
+        for (int i = 0; i < 100; i++) {
+            this->data[2 * i]     = static_cast<char>('0' + i / 10);
+            this->data[2 * i + 1] = static_cast<char>('0' + i % 10);
+        }
+    }
+    char data[200];
+};
+constexpr DigitPairs DIGIT_PAIRS{};
+
+// POW10[i] is 10^i, except for POW10[0], which makes zero one digit long.
+constexpr u64 POW10[20] = {
+    0,
+    10,
+    100,
+    1000,
+    10000,
+    100000,
+    1000000,
+    10000000,
+    100000000,
+    1000000000,
+    10000000000,
+    100000000000,
+    1000000000000,
+    10000000000000,
+    100000000000000,
+    1000000000000000,
+    10000000000000000,
+    100000000000000000,
+    1000000000000000000,
+    10000000000000000000u,
+};
+
+auto count_digits(const u64 value) -> size_t {
+    // log10(2) ~= 1233 / 4096, so this is the digit count or one less.
+    const size_t bits   = 64 - __builtin_clzll(value | 1);
+    const size_t approx = (bits * 1233) >> 12;
+    return approx - (value < POW10[approx]) + 1;
+}
+} // namespace
+
+auto u64_to_chars(char *first, char *last, u64 value) -> std::to_chars_result {
+    const size_t len = count_digits(value);
+    if (static_cast<size_t>(last - first) < len) {
+        return {last, std::errc::value_too_large};
+    }
+    char *pos = first + len;
+    while (value >= 100) {
+        pos -= 2;
+        memcpy(pos, DIGIT_PAIRS.data + (value % 100) * 2, 2);
+        value /= 100;
+    }
+    if (value >= 10) {
+        memcpy(pos - 2, DIGIT_PAIRS.data + value * 2, 2);
+    } else {
+        pos[-1] = static_cast<char>('0' + value);
+    }
+    return {first + len, std::errc{}};
+}
+
+namespace {
+auto chars_format_for(const char fmt) -> std::chars_format {
+    switch (fmt) {
+        case 'e': return std::chars_format::scientific;
+        case 'f': return std::chars_format::fixed;
+        default: return std::chars_format::general;
+    }
+}
+} // namespace
+
+// libstdc++ implements the shortest forms with Ryu, so these forward to it.
+auto to_chars(char *first, char *last, const f32 value)
+    -> std::to_chars_result {
+    return std::to_chars(first, last, value);
+}
+
+auto to_chars(char *first, char *last, const f64 value)
+    -> std::to_chars_result {
+    return std::to_chars(first, last, value);
+}
+
+auto to_chars(char *first, char *last, const f32 value,
+              const char fmt, const i32 precision)
+    -> std::to_chars_result {
+    return std::to_chars(first, last, value, chars_format_for(fmt), precision);
+}
+
+auto to_chars(char *first, char *last, const f64 value,
+              const char fmt, const i32 precision)
+    -> std::to_chars_result {
+    return std::to_chars(first, last, value, chars_format_for(fmt), precision);
+}
+
+namespace {
+// Appends `body`, padded out to the spec's width.
+auto format_pad(std::string &out, const std::string_view body,
+                const FormatSpec &spec, const char default_align) -> void {
+    if (body.size() >= spec.width) {
+        out.append(body);
+        return;
+    }
+    const size_t pad  = spec.width - body.size();
+    const char align  = spec.align != '\0' ? spec.align : default_align;
+    const size_t left = align == '>' ? pad : align == '^' ? pad / 2 : 0;
+    out.append(left, spec.fill);
+    out.append(body);
+    out.append(pad - left, spec.fill);
+}
+
+// `{:08}` style padding goes between the sign and the digits.
+auto format_zero_pad(std::string &out, std::string_view body,
+                     const FormatSpec &spec) -> void {
+    if (!body.empty() and body[0] == '-') {
+        out += '-';
+        body.remove_prefix(1);
+        if (spec.width > body.size() + 1) {
+            out.append(spec.width - body.size() - 1, '0');
+        }
+    } else if (spec.width > body.size()) {
+        out.append(spec.width - body.size(), '0');
+    }
+    out.append(body);
+}
+} // namespace
+
+auto format_write_int(std::string &out, const u64 magnitude,
+                      const bool negative, const FormatSpec &spec) -> void {
+    int base = 10;
+    switch (spec.type) {
+        case 'x': case 'X': base = 16; break;
+        case 'o': base = 8; break;
+        case 'b': base = 2; break;
+        default: break;
+    }
+
+    char buffer[72];
+    char *pos = buffer;
+    if (negative) { *pos++ = '-'; }
+    if (base == 10) {
+        pos = u64_to_chars(pos, std::end(buffer), magnitude).ptr;
+    } else {
+        pos = std::to_chars(pos, std::end(buffer), magnitude, base).ptr;
+    }
+    if (spec.type == 'X') {
+        for (char *it = buffer; it != pos; it++) {
+            if (*it >= 'a') { *it = static_cast<char>(*it - 'a' + 'A'); }
+        }
+    }
+
+    const std::string_view body{buffer, static_cast<size_t>(pos - buffer)};
+    if (spec.zero_pad and spec.align == '\0') {
+        format_zero_pad(out, body, spec);
+    } else {
+        format_pad(out, body, spec, '>');
+    }
+}
+
+namespace {
+template <typename T>
+auto format_write_floating(std::string &out, const T input,
+                           const FormatSpec &spec) -> void {
+    char buffer[64];
+    std::to_chars_result result{};
+    std::string large = {};
+    if (spec.type == 'r') {
+        result = to_chars(std::begin(buffer), std::end(buffer), input);
+    } else {
+        const char fmt = spec.type == 'e' or spec.type == 'f' ? spec.type : 'g';
+        const i32 precision = spec.precision >= 0 ? spec.precision : 6;
+        result = to_chars(std::begin(buffer), std::end(buffer), input, fmt,
+                          precision);
+        if (result.ec != std::errc{}) {
+            // Only fixed notation of a huge value gets this long.
+            large.resize(std::numeric_limits<T>::max_exponent10 + precision
+                         + 8);
+            result = to_chars(large.data(), large.data() + large.size(),
+                              input, fmt, precision);
+        }
+    }
+    const char *start = large.empty() ? buffer : large.data();
+    const std::string_view body{start,
+                                static_cast<size_t>(result.ptr - start)};
+
+    if (spec.zero_pad and spec.align == '\0') {
+        format_zero_pad(out, body, spec);
+    } else {
+        format_pad(out, body, spec, '>');
+    }
+}
+} // namespace
+
+auto format_write_float(std::string &out, const f32 input,
+                        const FormatSpec &spec) -> void {
+    format_write_floating(out, input, spec);
+}
+
+auto format_write_float(std::string &out, const f64 input,
+                        const FormatSpec &spec) -> void {
+    format_write_floating(out, input, spec);
+}
+
+auto format_write_str(std::string &out, std::string_view input,
+                      const FormatSpec &spec) -> void {
+    if (spec.precision >= 0) {
+        input = input.substr(0, static_cast<size_t>(spec.precision));
+    }
+    format_pad(out, input, spec, '<');
+}
+
+auto format_pad_tail(std::string &out, const size_t start,
+                     const FormatSpec &spec) -> void {
+    if (spec.precision >= 0 and out.size() - start > size_t(spec.precision)) {
+        out.resize(start + spec.precision);
+    }
+    const size_t len = out.size() - start;
+    if (len >= spec.width) { return; }
+    const size_t pad  = spec.width - len;
+    const char align  = spec.align != '\0' ? spec.align : '<';
+    const size_t left = align == '>' ? pad : align == '^' ? pad / 2 : 0;
+    out.insert(start, left, spec.fill);
+    out.append(pad - left, spec.fill);
+}
+
+auto StringAppendBuf::overflow(int_type c) -> int_type {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        this->out += traits_type::to_char_type(c);
+    }
+    return traits_type::not_eof(c);
+}
+
+auto StringAppendBuf::xsputn(const char *data, std::streamsize size)
+    -> std::streamsize {
+    this->out.append(data, static_cast<size_t>(size));
+    return size;
+}
+
+namespace {
+auto format_piece(std::string &out, const std::string_view text,
+                  const FormatPiece &piece, const FormatArg *args,
+                  const size_t arg_count) -> void {
+    if (!piece.literal and piece.arg < arg_count) {
+        args[piece.arg].write(out, args[piece.arg].value, piece.spec);
+    } else {
+        out.append(text.data() + piece.offset, piece.size);
+    }
+}
+} // namespace
+
+auto vformat_to(std::string &out, const std::string_view fmt,
+                const FormatArg *args, const size_t arg_count) -> void {
+    size_t pos      = 0;
+    size_t next_arg = 0;
+    FormatPiece piece{};
+    while (pos < fmt.size()) {
+        if (!next_format_piece(fmt, pos, next_arg, piece)) {
+            // A stray brace is kept as text.
+            out += fmt[pos++];
+            continue;
+        }
+        format_piece(out, fmt, piece, args, arg_count);
+    }
+}
+
+auto vformat_to(std::string &out, const std::string_view text,
+                const FormatPiece *pieces, const size_t piece_count,
+                const FormatArg *args, const size_t arg_count) -> void {
+    for (size_t i = 0; i < piece_count; i++) {
+        format_piece(out, text, pieces[i], args, arg_count);
+    }
+}
+
+namespace {
+// Runs `write` on a buffer kept per thread and copies the result into memory
+// from `arena`. The buffer is taken out while it's in use, so a call nested
+// inside `write`, from some argument's operator<<, gets a buffer of its own.
+template <typename F>
+auto format_into(std::pmr::memory_resource &arena, F write)
+    -> std::pmr::string {
+    thread_local std::string spare;
+    std::string scratch = std::move(spare);
+    scratch.clear();
+    write(scratch);
+    std::pmr::string output{scratch, &arena};
+    spare = std::move(scratch);
+    return output;
+}
+} // namespace
+
+auto vformat(std::pmr::memory_resource &arena, const std::string_view fmt,
+             const FormatArg *args, const size_t arg_count)
+    -> std::pmr::string {
+    return format_into(arena, [&](std::string &out) {
+        vformat_to(out, fmt, args, arg_count);
+    });
+}
+
+auto vformat(std::pmr::memory_resource &arena, const std::string_view text,
+             const FormatPiece *pieces, const size_t piece_count,
+             const FormatArg *args, const size_t arg_count)
+    -> std::pmr::string {
+    return format_into(arena, [&](std::string &out) {
+        vformat_to(out, text, pieces, piece_count, args, arg_count);
+    });
+}
+
+/// PRINTING
+namespace {
+// A thread's buffer is handed to the writer once it holds this much.
+const constexpr size_t PRINT_BLOCK_BYTES = 64 << 10;
+// Partially filled buffers are swept up at least this often.
+const constexpr auto PRINT_INTERVAL = std::chrono::milliseconds{20};
+
+struct PrintBlock {
+    std::string data;
+    PrintBlock *next;
+};
+
+// Lines one thread has printed to stdout but not yet handed over. The lock
+// is only contended when the writer sweeps.
+struct PrintBuffer {
+    std::mutex lock;
+    std::string data;
+};
+
+struct PrintSink {
+    std::atomic<PrintMode> mode{PrintMode::Async};
+    // Full blocks, newest first. Producers push without locking; the writer
+    // takes the whole list at once.
+    std::atomic<PrintBlock *> queue{nullptr};
+
+    std::mutex registry_lock;
+    std::vector<PrintBuffer *> registry;
+
+    // Held while blocks are written out, so two flushes never interleave.
+    // Lock order is wake_lock, write_lock, registry_lock, then a
+    // PrintBuffer's lock.
+    std::mutex write_lock;
+
+    // The exit hook is installed with the first buffered line; the crash
+    // and fork hooks only when asked for. With the fork hooks the writer is
+    // started again in a forked child.
+    std::once_flag installed;
+    std::once_flag crash_hooks;
+    std::once_flag fork_hooks;
+    std::atomic<bool> started{false};
+    std::thread *writer = nullptr;
+    pid_t writer_pid    = 0;
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+// Never destroyed, so threads that outlive static destruction can still
+// print.
+auto print_sink() -> PrintSink & {
+    static PrintSink *sink = new PrintSink{};
+    return *sink;
+}
+
+auto write_all(const int fd, const char *data, size_t size) -> void {
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) { continue; }
+            return;
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+auto push_block(PrintSink &sink, std::string &&data) -> void {
+    auto *block = new PrintBlock{std::move(data), nullptr};
+    block->next = sink.queue.load(std::memory_order_relaxed);
+    while (!sink.queue.compare_exchange_weak(block->next, block,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed)) {}
+}
+
+// Takes every queued block and returns them oldest first.
+auto take_blocks(PrintSink &sink) -> PrintBlock * {
+    PrintBlock *list = sink.queue.exchange(nullptr, std::memory_order_acquire);
+    PrintBlock *oldest_first = nullptr;
+    while (list != nullptr) {
+        PrintBlock *next = list->next;
+        list->next       = oldest_first;
+        oldest_first     = list;
+        list             = next;
+    }
+    return oldest_first;
+}
+
+// Callers hold `write_lock`.
+auto write_blocks(PrintSink &sink) -> void {
+    PrintBlock *block = take_blocks(sink);
+    while (block != nullptr) {
+        write_all(1, block->data.data(), block->data.size());
+        PrintBlock *next = block->next;
+        delete block;
+        block = next;
+    }
+}
+
+// Callers hold `write_lock` and `registry_lock`. Each buffer is queued under
+// its own lock, so a thread's lines stay in order.
+auto queue_buffers(PrintSink &sink) -> void {
+    for (PrintBuffer *buffer : sink.registry) {
+        std::lock_guard buffer_guard{buffer->lock};
+        if (buffer->data.empty()) { continue; }
+        push_block(sink, std::move(buffer->data));
+        buffer->data = {};
+    }
+}
+
+// Queues every thread's partial buffer, then writes the whole queue.
+auto flush_all(PrintSink &sink) -> void {
+    std::lock_guard write_guard{sink.write_lock};
+    {
+        std::lock_guard registry_guard{sink.registry_lock};
+        queue_buffers(sink);
+    }
+    write_blocks(sink);
+}
+
+// Plain pointer for the crash handler, which can't touch `thread_buffer`.
+thread_local PrintBuffer *current_print_buffer = nullptr;
+
+struct ThreadPrintBuffer {
+    ThreadPrintBuffer() {
+        PrintSink &sink = print_sink();
+        std::lock_guard registry_guard{sink.registry_lock};
+        sink.registry.push_back(&this->buffer);
+        current_print_buffer = &this->buffer;
+    }
+
+    ~ThreadPrintBuffer() {
+        PrintSink &sink = print_sink();
+        {
+            std::lock_guard registry_guard{sink.registry_lock};
+            auto &registry = sink.registry;
+            registry.erase(
+                std::find(registry.begin(), registry.end(), &this->buffer));
+            current_print_buffer = nullptr;
+        }
+        if (!this->buffer.data.empty()) {
+            push_block(sink, std::move(this->buffer.data));
+        }
+        // Past exit there is no writer left to pick these up.
+        std::lock_guard wake_guard{sink.wake_lock};
+        if (sink.stopping) {
+            std::lock_guard write_guard{sink.write_lock};
+            write_blocks(sink);
+        }
+    }
+
+    PrintBuffer buffer;
+};
+
+thread_local ThreadPrintBuffer thread_buffer;
+
+const constexpr int CRASH_SIGNALS[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE,
+                                       SIGABRT};
+struct sigaction previous_actions[std::size(CRASH_SIGNALS)];
+
+// Only async-signal-safe work in here: the queue is taken with an atomic
+// exchange and written with write(). Other threads' partial buffers are
+// lost, but the crashing thread's own lines, usually the interesting ones,
+// are written without taking its lock.
+auto flush_on_crash(const int signal) -> void {
+    PrintSink &sink   = print_sink();
+    PrintBlock *block = take_blocks(sink);
+    for (; block != nullptr; block = block->next) {
+        write_all(1, block->data.data(), block->data.size());
+    }
+    if (PrintBuffer *buffer = current_print_buffer; buffer != nullptr) {
+        write_all(1, buffer->data.data(), buffer->data.size());
+    }
+    for (size_t i = 0; i < std::size(CRASH_SIGNALS); i++) {
+        if (CRASH_SIGNALS[i] == signal) {
+            sigaction(signal, &previous_actions[i], nullptr);
+        }
+    }
+    raise(signal);
+}
+
+auto stop_writer() -> void {
+    PrintSink &sink = print_sink();
+    {
+        std::lock_guard wake_guard{sink.wake_lock};
+        sink.stopping = true;
+    }
+    sink.wake.notify_one();
+    // A child forked without the fork hooks has no writer of its own.
+    if (sink.writer != nullptr and sink.writer_pid == getpid()) {
+        sink.writer->join();
+    }
+    flush_all(sink);
+}
+
+// Everything buffered so far is written before the fork, and the locks are
+// held across it, so the child starts with nothing it could print twice.
+auto before_fork() -> void {
+    PrintSink &sink = print_sink();
+    sink.wake_lock.lock();
+    sink.write_lock.lock();
+    sink.registry_lock.lock();
+    queue_buffers(sink);
+    write_blocks(sink);
+}
+
+auto after_fork_parent() -> void {
+    PrintSink &sink = print_sink();
+    sink.registry_lock.unlock();
+    sink.write_lock.unlock();
+    sink.wake_lock.unlock();
+}
+
+// The child has only the forking thread. The writer and the other threads'
+// buffers didn't come along; whatever they queued after the flush above
+// belongs to the parent.
+auto after_fork_child() -> void {
+    PrintSink &sink = print_sink();
+    for (PrintBlock *block = take_blocks(sink); block != nullptr;) {
+        PrintBlock *next = block->next;
+        delete block;
+        block = next;
+    }
+    sink.registry.clear();
+    if (current_print_buffer != nullptr) {
+        sink.registry.push_back(current_print_buffer);
+    }
+    sink.writer = nullptr;
+    sink.started.store(false, std::memory_order_relaxed);
+    after_fork_parent();
+}
+
+auto install_crash_hooks() -> void {
+    struct sigaction action {};
+    action.sa_handler = flush_on_crash;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESETHAND;
+    for (size_t i = 0; i < std::size(CRASH_SIGNALS); i++) {
+        sigaction(CRASH_SIGNALS[i], &action, &previous_actions[i]);
+    }
+}
+
+auto install_fork_hooks() -> void {
+    pthread_atfork(before_fork, after_fork_parent, after_fork_child);
+}
+
+auto start_writer(PrintSink &sink) -> void {
+    std::call_once(sink.installed, [] { std::atexit(stop_writer); });
+    std::lock_guard wake_guard{sink.wake_lock};
+    if (sink.started.load(std::memory_order_relaxed)) { return; }
+    sink.writer = new std::thread{[&sink] {
+        std::unique_lock wake_guard{sink.wake_lock};
+        while (!sink.stopping) {
+            const auto status = sink.wake.wait_for(wake_guard, PRINT_INTERVAL);
+            wake_guard.unlock();
+            if (status == std::cv_status::timeout) {
+                flush_all(sink);
+            } else {
+                std::lock_guard write_guard{sink.write_lock};
+                write_blocks(sink);
+            }
+            wake_guard.lock();
+        }
+    }};
+    sink.writer_pid = getpid();
+    sink.started.store(true, std::memory_order_release);
+}
+} // namespace
+
+auto operator<<(std::ostream &os, const PrintMode &rhs) -> std::ostream & {
+    switch (rhs) {
+    case PrintMode::Sync: return os << "Sync";
+    case PrintMode::Async: return os << "Async";
+    }
+    return os;
+}
+
+auto set_print_mode(const PrintMode mode) -> void {
+    flush_output();
+    print_sink().mode.store(mode, std::memory_order_relaxed);
+}
+
+auto print_mode() -> PrintMode {
+    return print_sink().mode.load(std::memory_order_relaxed);
+}
+
+auto flush_output() -> void {
+    PrintSink &sink = print_sink();
+    flush_all(sink);
+    std::cout.flush();
+    std::cerr.flush();
+}
+
+auto flush_output_on_crash() -> void {
+    std::call_once(print_sink().crash_hooks, install_crash_hooks);
+}
+
+auto flush_output_on_fork() -> void {
+    std::call_once(print_sink().fork_hooks, install_fork_hooks);
+}
+
+auto print_line(const int fd, const std::string_view line) -> void {
+    PrintSink &sink = print_sink();
+    if (sink.mode.load(std::memory_order_relaxed) == PrintMode::Sync) {
+        if (fd == 2) {
+            std::cerr.write(line.data(), line.size()).flush();
+        } else {
+            std::cout.write(line.data(), line.size()).flush();
+        }
+        return;
+    }
+
+    // Nothing sits in a buffer on the way to stderr, so a process killed
+    // before its next flush still leaves its error messages behind.
+    if (fd == 2) {
+        write_all(2, line.data(), line.size());
+        return;
+    }
+
+    if (!sink.started.load(std::memory_order_acquire)) { start_writer(sink); }
+    PrintBuffer &buffer = thread_buffer.buffer;
+    std::lock_guard buffer_guard{buffer.lock};
+    buffer.data.append(line);
+    if (buffer.data.size() >= PRINT_BLOCK_BYTES) {
+        push_block(sink, std::move(buffer.data));
+        buffer.data = {};
+        sink.wake.notify_one();
+    }
+}
+
+auto println_buffer() -> std::string & {
+    thread_local std::string buffer = {};
+    return buffer;
+}
+
+auto println() -> void {
+    print_line(1, "\n");
+}
+auto eprintln() -> void {
+    print_line(2, "\n");
+}
+
+auto is_plain_number_stream(const std::ostream &os) -> bool {
+    const auto flags = os.flags();
+    const auto fancy = std::ios_base::showpos | std::ios_base::showpoint
+                     | std::ios_base::uppercase | std::ios_base::showbase;
+    const auto base  = flags & std::ios_base::basefield;
+    return os.width() == 0 and os.precision() == 6 and (flags & fancy) == 0
+       and (base == std::ios_base::dec or base == 0)
+       and (flags & std::ios_base::floatfield) == 0;
+}
+
+auto operator<<(std::ostream &os, const std::vector<uint8_t> &input)
+    -> std::ostream & {
+    write_number_vec(os, input.data(), input.size());
+    return os;
+}
+
+/// FILE
+namespace {
+auto errno_error(const std::string_view what, const std::string &path)
+    -> Error {
+    const int code = errno;
+    return Error{std::string{what} + " `" + path + "`: " + strerror(code),
+                 code};
+}
+} // namespace
+
+auto file_view(const std::string &path) -> Result<FileView, Error> {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { return Err<FileView, Error>(errno_error("open", path)); }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+        Error err = errno_error("stat", path);
+        close(fd);
+        return Err<FileView, Error>(err);
+    }
+    if (!S_ISREG(info.st_mode)) {
+        close(fd);
+        return Err<FileView, Error>(
+            Error{"not a regular file `" + path + "`", EINVAL});
+    }
+
+    // mmap() refuses zero-length mappings, and there's nothing to map anyway.
+    const size_t size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        close(fd);
+        return Ok<FileView, Error>(FileView{});
+    }
+
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return Err<FileView, Error>(errno_error("mmap", path));
+    }
+    madvise(addr, size, MADV_SEQUENTIAL);
+
+    SPtr<const char> mapping{static_cast<const char *>(addr),
+                             [size](const char *ptr) {
+                                 munmap(const_cast<char *>(ptr), size);
+                             }};
+    return Ok<FileView, Error>(FileView{mapping, size});
+}
+
+auto operator<<(std::ostream &os, const FileView &rhs) -> std::ostream & {
+    os << "FileView { .data = " << static_cast<const void *>(rhs.data())
+       << ", .size = " << rhs.size() << " }";
+    return os;
+}
+
+/// STREAMING
+namespace {
+// Sources for the readers below. Each read returns the number of bytes read,
+// 0 at the end of input, or -1 on error with `errno` set.
+auto fd_reader(const int fd) -> std::function<long(char *, size_t)> {
+    return [fd](char *buf, size_t size) -> long {
+        while (true) {
+            const ssize_t got = ::read(fd, buf, size);
+            if (got >= 0 or errno != EINTR) { return got; }
+        }
+    };
+}
+
+auto stream_reader(std::istream &input) -> std::function<long(char *, size_t)> {
+    return [&input](char *buf, size_t size) -> long {
+        input.read(buf, static_cast<std::streamsize>(size));
+        if (input.bad()) {
+            errno = EIO;
+            return -1;
+        }
+        return static_cast<long>(input.gcount());
+    };
+}
+} // namespace
+
+struct LineReaderState {
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+        bool filled = false;
+        // Set on the chunk that hit end of input or an error.
+        bool last = false;
+    };
+
+    // Returns the number of bytes read, 0 at the end of input, or -1 on error
+    // with `errno` set.
+    std::function<long(char *, size_t)> read;
+    size_t chunk_size;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    Chunk chunks[2];
+    bool stop = false;
+    std::optional<Error> error;
+    std::thread thread;
+
+    // Consumer side. Only touched by the thread calling `next()`.
+    size_t current   = 0;
+    bool holding     = false;
+    size_t pos       = 0;
+    bool finished    = false;
+    bool clear_carry = false;
+    std::string carry;
+
+    auto produce() -> void {
+        for (size_t idx = 0;; idx ^= 1) {
+            Chunk &chunk = this->chunks[idx];
+            {
+                std::unique_lock<std::mutex> lock{this->mutex};
+                this->cv.wait(lock,
+                              [&] { return !chunk.filled or this->stop; });
+                if (this->stop) { return; }
+            }
+
+            // Hand the chunk over as soon as a read completes a line, so an
+            // interactive source isn't held back until a whole chunk
+            // arrives. Reads that end mid-line keep filling: the consumer
+            // could do nothing with them yet.
+            size_t size = 0;
+            bool last   = false;
+            std::optional<Error> err;
+            while (size < this->chunk_size) {
+                const long got = this->read(chunk.data.get() + size,
+                                            this->chunk_size - size);
+                if (got < 0) {
+                    const int code = errno;
+                    err  = Error{std::string{"read: "} + strerror(code), code};
+                    last = true;
+                    break;
+                }
+                if (got == 0) {
+                    last = true;
+                    break;
+                }
+                const char *fresh = chunk.data.get() + size;
+                size += static_cast<size_t>(got);
+                if (memchr(fresh, '\n', static_cast<size_t>(got))
+                    != nullptr) {
+                    break;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock{this->mutex};
+            chunk.size   = size;
+            chunk.last   = last;
+            chunk.filled = true;
+            if (err) { this->error = err; }
+            this->cv.notify_all();
+            if (last) { return; }
+        }
+    }
+
+    auto start() -> void {
+        this->chunks[0].data.reset(new char[this->chunk_size]);
+        this->chunks[1].data.reset(new char[this->chunk_size]);
+        this->carry.reserve(4096);
+        this->thread = std::thread{[this] { this->produce(); }};
+    }
+};
+
+LineReader::LineReader(const int fd, const size_t chunk_size)
+    : state(make_unique<LineReaderState>()) {
+    this->state->read = fd_reader(fd);
+    this->state->chunk_size = chunk_size == 0 ? 1 : chunk_size;
+    this->state->start();
+}
+
+LineReader::LineReader(std::istream &input, const size_t chunk_size)
+    : state(make_unique<LineReaderState>()) {
+    this->state->read = stream_reader(input);
+    this->state->chunk_size = chunk_size == 0 ? 1 : chunk_size;
+    this->state->start();
+}
+
+LineReader::~LineReader() {
+    {
+        std::lock_guard<std::mutex> lock{this->state->mutex};
+        this->state->stop = true;
+    }
+    this->state->cv.notify_all();
+    this->state->thread.join();
+}
+
+auto LineReader::next() -> std::optional<std::string_view> {
+    LineReaderState &st = *this->state;
+    if (st.clear_carry) {
+        // Keeps its capacity, so a run of long lines doesn't reallocate.
+        st.carry.clear();
+        st.clear_carry = false;
+    }
+
+    while (!st.finished) {
+        LineReaderState::Chunk &chunk = st.chunks[st.current];
+        if (!st.holding) {
+            std::unique_lock<std::mutex> lock{st.mutex};
+            st.cv.wait(lock, [&] { return chunk.filled; });
+            st.holding = true;
+            st.pos     = 0;
+        }
+
+        const char *data = chunk.data.get();
+        const size_t nl
+            = st.pos
+            + scan_ops().find_byte(data + st.pos, chunk.size - st.pos, '\n');
+        if (nl < chunk.size) {
+            const size_t start = st.pos;
+            st.pos             = nl + 1;
+            if (st.carry.empty()) {
+                return std::string_view{data + start, nl - start};
+            }
+            st.carry.append(data + start, nl - start);
+            st.clear_carry = true;
+            return std::string_view{st.carry};
+        }
+
+        // The rest of this chunk is the start of a line that finishes in a
+        // later one.
+        st.carry.append(data + st.pos, chunk.size - st.pos);
+        const bool last = chunk.last;
+        {
+            std::lock_guard<std::mutex> lock{st.mutex};
+            chunk.filled = false;
+        }
+        st.cv.notify_all();
+        st.holding = false;
+        st.current ^= 1;
+
+        if (last) {
+            st.finished = true;
+            if (!st.carry.empty()) {
+                st.clear_carry = true;
+                return std::string_view{st.carry};
+            }
+        }
+    }
+    return {};
+}
+
+auto LineReader::error() const -> std::optional<Error> {
+    std::lock_guard<std::mutex> lock{this->state->mutex};
+    return this->state->error;
+}
+
+/// CSV
+namespace {
+// Bit i is set when an odd number of the bits at or below i are set in
+// `mask`. Over the quote bits, that's every byte from an opening quote up to
+// the closing one.
+inline auto prefix_xor(u64 mask) -> u64 {
+    mask ^= mask << 1;
+    mask ^= mask << 2;
+    mask ^= mask << 4;
+    mask ^= mask << 8;
+    mask ^= mask << 16;
+    mask ^= mask << 32;
+    return mask;
+}
+} // namespace
+
+struct CsvReaderState {
+    // Bytes indexed at a time, so the index stays small whatever the size of
+    // the input.
+    static const constexpr size_t WINDOW = 1 << 16;
+
+    char delim;
+    // Only set for streams, with the same contract as `LineReaderState::read`.
+    std::function<long(char *, size_t)> read;
+    size_t chunk_size = 0;
+    std::string buffer;
+    FileView file;
+    const char *data = nullptr;
+    size_t size      = 0;
+    // Nothing will be added after `size`.
+    bool at_end = true;
+    std::optional<Error> error;
+
+    // Stage one: the offset of every quote, and of every delimiter and
+    // newline outside quotes, for the bytes before `scanned`.
+    std::vector<size_t> index;
+    size_t index_pos = 0;
+    size_t scanned   = 0;
+    // All ones when `scanned` is inside quotes.
+    u64 in_quotes = 0;
+
+    // Stage two: the row being put together from the index.
+    size_t row_start = 0;
+    std::vector<std::string_view> fields;
+    std::string decoded;
+    // {field, offset, size} of each decoded field. `decoded` can move while
+    // it grows, so these become views once the row is done.
+    std::vector<std::array<size_t, 3>> pending;
+
+    auto index_more() -> void {
+        const ScanOps &ops = scan_ops();
+        const size_t stop  = std::min(this->size, this->scanned + WINDOW);
+        u64 masks[2];
+        char tail[64];
+        while (this->scanned < stop) {
+            const char *block = this->data + this->scanned;
+            const size_t len  = std::min<size_t>(64, stop - this->scanned);
+            u64 valid         = ~u64{0};
+            if (len < 64) {
+                // The bytes read so far end mid-block. Quote state carries
+                // over, so the block's rest can be scanned after a refill.
+                memcpy(tail, block, len);
+                memset(tail + len, 0, 64 - len);
+                block = tail;
+                valid = ~u64{0} >> (64 - len);
+            }
+            ops.csv_masks(block, this->delim, masks);
+            const u64 quotes = masks[0] & valid;
+            const u64 inside = prefix_xor(quotes) ^ this->in_quotes;
+            this->in_quotes  = static_cast<u64>(static_cast<i64>(inside) >> 63);
+            u64 structural   = quotes | (masks[1] & valid & ~inside);
+            while (structural != 0) {
+                this->index.push_back(this->scanned
+                                      + __builtin_ctzll(structural));
+                structural &= structural - 1;
+            }
+            this->scanned += len;
+        }
+    }
+
+    // Moves the unfinished row to the front of the buffer and reads more
+    // after it. The row is scanned again from its start, where quoting is
+    // known to be off.
+    auto refill() -> void {
+        const size_t keep = this->size - this->row_start;
+        memmove(this->buffer.data(), this->buffer.data() + this->row_start,
+                keep);
+        // Reading at least as much as is kept keeps a very long row linear.
+        const size_t want = std::max(this->chunk_size, keep);
+        if (this->buffer.size() < keep + want) {
+            this->buffer.resize(keep + want);
+        }
+        // Return as soon as a row is complete, so a source that sends a few
+        // rows at a time isn't held back until the chunk fills. Indexing has
+        // reached the end of the kept bytes, so `in_quotes` is the quoting
+        // there, and only the new bytes need a look.
+        bool inside = this->in_quotes != 0;
+        size_t got  = 0;
+        while (got < want) {
+            char *fresh  = this->buffer.data() + keep + got;
+            const long n = this->read(fresh, want - got);
+            if (n < 0) {
+                const int code = errno;
+                this->error
+                    = Error{std::string{"read: "} + strerror(code), code};
+                this->at_end = true;
+                break;
+            }
+            if (n == 0) {
+                this->at_end = true;
+                break;
+            }
+            got += static_cast<size_t>(n);
+            // A read that filled the request ends the loop anyway.
+            if (got == want) { break; }
+            bool row_done = false;
+            for (long i = 0; i < n and !row_done; i++) {
+                if (fresh[i] == '"') {
+                    inside = !inside;
+                } else if (fresh[i] == '\n' and !inside) {
+                    row_done = true;
+                }
+            }
+            if (row_done) { break; }
+        }
+        this->data      = this->buffer.data();
+        this->size      = keep + got;
+        this->row_start = 0;
+        this->scanned   = 0;
+        this->in_quotes = 0;
+        this->index.clear();
+        this->index_pos = 0;
+    }
+
+    auto push_field(const size_t start, size_t end, const bool quoted,
+                    const bool line_end) -> void {
+        if (line_end and end > start and this->data[end - 1] == '\r') { end--; }
+        const std::string_view raw{this->data + start, end - start};
+        if (!quoted) {
+            this->fields.push_back(raw);
+            return;
+        }
+        if (raw.size() >= 2 and raw.front() == '"' and raw.back() == '"'
+            and raw.substr(1, raw.size() - 2).find('"') == raw.npos) {
+            this->fields.push_back(raw.substr(1, raw.size() - 2));
+            return;
+        }
+        const size_t offset = this->decoded.size();
+        bool inside         = false;
+        for (size_t i = 0; i < raw.size(); i++) {
+            if (raw[i] != '"') {
+                this->decoded += raw[i];
+            } else if (inside and i + 1 < raw.size() and raw[i + 1] == '"') {
+                this->decoded += '"';
+                i++;
+            } else {
+                inside = !inside;
+            }
+        }
+        this->pending.push_back(
+            {this->fields.size(), offset, this->decoded.size() - offset});
+        this->fields.emplace_back();
+    }
+
+    auto finish_row() -> const std::vector<std::string_view> * {
+        for (const auto &[field, offset, length] : this->pending) {
+            this->fields[field] = {this->decoded.data() + offset, length};
+        }
+        return &this->fields;
+    }
+
+    auto next() -> const std::vector<std::string_view> * {
+        this->fields.clear();
+        this->decoded.clear();
+        this->pending.clear();
+        size_t field_start = this->row_start;
+        bool quoted        = false;
+        while (true) {
+            if (this->index_pos == this->index.size()) {
+                this->index.clear();
+                this->index_pos = 0;
+                if (this->scanned < this->size) {
+                    this->index_more();
+                    continue;
+                }
+                if (!this->at_end) {
+                    this->refill();
+                    this->fields.clear();
+                    this->decoded.clear();
+                    this->pending.clear();
+                    field_start = this->row_start;
+                    quoted      = false;
+                    continue;
+                }
+                // The last row, without a newline after it.
+                if (field_start == this->size and this->fields.empty()) {
+                    return nullptr;
+                }
+                // A '\r' at the very end is only a line ending when it's
+                // outside quotes.
+                this->push_field(field_start, this->size, quoted,
+                                 this->in_quotes == 0);
+                this->row_start = this->size;
+                if (this->fields.size() == 1 and this->fields[0].empty()
+                    and !quoted) {
+                    return nullptr;
+                }
+                return this->finish_row();
+            }
+
+            const size_t pos = this->index[this->index_pos++];
+            const char c     = this->data[pos];
+            if (c == '"') {
+                quoted = true;
+                continue;
+            }
+            const bool last = c == '\n';
+            this->push_field(field_start, pos, quoted, last);
+            field_start = pos + 1;
+            if (!last) {
+                quoted = false;
+                continue;
+            }
+            const bool blank = this->fields.size() == 1
+                           and this->fields[0].empty() and !quoted;
+            quoted          = false;
+            this->row_start = pos + 1;
+            if (!blank) { return this->finish_row(); }
+            this->fields.clear();
+        }
+    }
+};
+
+CsvReader::CsvReader(const std::string_view input, const char delim)
+    : state(make_unique<CsvReaderState>()) {
+    this->state->delim = delim;
+    this->state->data  = input.data();
+    this->state->size  = input.size();
+}
+
+CsvReader::CsvReader(const FileView &file, const char delim)
+    : state(make_unique<CsvReaderState>()) {
+    this->state->delim = delim;
+    this->state->file  = file;
+    this->state->data  = file.data();
+    this->state->size  = file.size();
+}
+
+CsvReader::CsvReader(const int fd, const char delim, const size_t chunk_size)
+    : state(make_unique<CsvReaderState>()) {
+    this->state->delim      = delim;
+    this->state->read       = fd_reader(fd);
+    this->state->chunk_size = chunk_size == 0 ? 1 : chunk_size;
+    this->state->at_end     = false;
+}
+
+CsvReader::CsvReader(std::istream &input, const char delim,
+                     const size_t chunk_size)
+    : state(make_unique<CsvReaderState>()) {
+    this->state->delim      = delim;
+    this->state->read       = stream_reader(input);
+    this->state->chunk_size = chunk_size == 0 ? 1 : chunk_size;
+    this->state->at_end     = false;
+}
+
+CsvReader::~CsvReader() = default;
+
+auto CsvReader::next() -> const std::vector<std::string_view> * {
+    return this->state->next();
+}
+
+auto CsvReader::error() const -> std::optional<Error> {
+    return this->state->error;
+}
+
+template <typename T>
+auto csv_column(const size_t column, CsvReader &reader) -> Column<T> {
+    Column<T> output = {};
+    size_t row       = 0;
+    while (auto fields = reader.next()) {
+        std::optional<T> value = {};
+        if (column < fields->size()) {
+            const std::string_view field = (*fields)[column];
+            value = parse_field<T>(field, field.data() + field.size());
+        }
+        if (value) {
+            output.values.push_back(value.value());
+        } else {
+            output.bad_rows.push_back(row);
+        }
+        row++;
+    }
+    return output;
+}
+
+template <typename T>
+auto csv_column(const std::string_view name, CsvReader &reader) -> Column<T> {
+    auto header = reader.next();
+    if (header == nullptr) { return {}; }
+    auto it = std::find(header->begin(), header->end(), name);
+    if (it == header->end()) { return {}; }
+    return csv_column<T>(static_cast<size_t>(it - header->begin()), reader);
+}
+
+// clang-format off
+template auto csv_column<i8>(const size_t, CsvReader &)  -> Column<i8>;
+template auto csv_column<i16>(const size_t, CsvReader &) -> Column<i16>;
+template auto csv_column<i32>(const size_t, CsvReader &) -> Column<i32>;
+template auto csv_column<i64>(const size_t, CsvReader &) -> Column<i64>;
+template auto csv_column<u8>(const size_t, CsvReader &)  -> Column<u8>;
+template auto csv_column<u16>(const size_t, CsvReader &) -> Column<u16>;
+template auto csv_column<u32>(const size_t, CsvReader &) -> Column<u32>;
+template auto csv_column<u64>(const size_t, CsvReader &) -> Column<u64>;
+template auto csv_column<f32>(const size_t, CsvReader &) -> Column<f32>;
+template auto csv_column<f64>(const size_t, CsvReader &) -> Column<f64>;
+template auto csv_column<i8>(const std::string_view, CsvReader &)  -> Column<i8>;
+template auto csv_column<i16>(const std::string_view, CsvReader &) -> Column<i16>;
+template auto csv_column<i32>(const std::string_view, CsvReader &) -> Column<i32>;
+template auto csv_column<i64>(const std::string_view, CsvReader &) -> Column<i64>;
+template auto csv_column<u8>(const std::string_view, CsvReader &)  -> Column<u8>;
+template auto csv_column<u16>(const std::string_view, CsvReader &) -> Column<u16>;
+template auto csv_column<u32>(const std::string_view, CsvReader &) -> Column<u32>;
+template auto csv_column<u64>(const std::string_view, CsvReader &) -> Column<u64>;
+template auto csv_column<f32>(const std::string_view, CsvReader &) -> Column<f32>;
+template auto csv_column<f64>(const std::string_view, CsvReader &) -> Column<f64>;
+// clang-format on
+
+/// REGEX
+namespace {
+struct ByteSet {
+    u64 bits[4] = {};
+
+    auto add(const u8 c) -> void { this->bits[c >> 6] |= u64{1} << (c & 63); }
+    auto add_range(const u8 lo, const u8 hi) -> void {
+        for (u32 c = lo; c <= hi; c++) { this->add(static_cast<u8>(c)); }
+    }
+    auto add(const ByteSet &rhs) -> void {
+        for (size_t i = 0; i < 4; i++) { this->bits[i] |= rhs.bits[i]; }
+    }
+    auto negate() -> void {
+        for (auto &it : this->bits) { it = ~it; }
+    }
+    auto contains(const u8 c) const -> bool {
+        return (this->bits[c >> 6] >> (c & 63)) & 1;
+    }
+};
+
+enum class ReOp : u8 {
+    Set,
+    Split,
+    Jmp,
+    Match,
+    AssertStart,
+    AssertEnd,
+    WordBoundary,
+    NotWordBoundary,
+};
+
+// Set: `x` indexes the program's byte sets. Split: try `x` before `y`.
+// Jmp: go to `x`. The assertions fall through to the next instruction.
+struct ReInst {
+    ReOp op;
+    u32 x = 0;
+    u32 y = 0;
+};
+
+enum class ReKind : u8 {
+    Empty,
+    Set,
+    Concat,
+    Alt,
+    Repeat,
+    AssertStart,
+    AssertEnd,
+    WordBoundary,
+    NotWordBoundary,
+};
+
+const u32 RE_UNBOUNDED = std::numeric_limits<u32>::max();
+// Counted repetition is expanded, so it's capped to keep programs small.
+const u32 RE_MAX_REPEAT  = 1000;
+const size_t RE_MAX_INST = 20000;
+// The DFA cache is dropped and rebuilt past this many states.
+const size_t RE_MAX_DFA_STATES = 2048;
+// Each thread keeps the DFAs of this many programs it used most recently.
+const size_t RE_DFA_CACHE_SIZE = 16;
+
+struct ReNode {
+    ReKind kind = ReKind::Empty;
+    ByteSet set = {};
+    std::vector<ReNode> children = {};
+    u32 min     = 0;
+    u32 max     = 0;
+    bool greedy = true;
+};
+
+// Thrown for anything outside the supported subset, valid or not. The
+// pattern then goes to std::regex, which either handles it or rejects it.
+struct ReUnsupported {};
+
+auto re_is_word(const u8 c) -> bool {
+    return (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z')
+        or (c >= '0' and c <= '9') or c == '_';
+}
+
+auto re_class_escape(const char c) -> std::optional<ByteSet> {
+    ByteSet set;
+    switch (c) {
+    case 'd':
+    case 'D': set.add_range('0', '9'); break;
+    case 'w':
+    case 'W':
+        set.add_range('a', 'z');
+        set.add_range('A', 'Z');
+        set.add_range('0', '9');
+        set.add('_');
+        break;
+    case 's':
+    case 'S':
+        set.add_range('\t', '\r');
+        set.add(' ');
+        break;
+    default: return {};
+    }
+    if (c >= 'A' and c <= 'Z') { set.negate(); }
+    return set;
+}
+
+auto re_hex_digit(const char c) -> u32 {
+    if (c >= '0' and c <= '9') { return c - '0'; }
+    if (c >= 'a' and c <= 'f') { return c - 'a' + 10; }
+    if (c >= 'A' and c <= 'F') { return c - 'A' + 10; }
+    throw ReUnsupported{};
+}
+
+struct ReParser {
+    std::string_view pattern;
+    size_t pos = 0;
+
+    auto parse() -> ReNode {
+        auto output = this->parse_alt();
+        if (this->pos != this->pattern.size()) { throw ReUnsupported{}; }
+        return output;
+    }
+
+  private:
+    auto at_end() const -> bool { return this->pos >= this->pattern.size(); }
+    auto peek() const -> char { return this->pattern[this->pos]; }
+    auto next() -> char {
+        if (this->at_end()) { throw ReUnsupported{}; }
+        return this->pattern[this->pos++];
+    }
+
+    auto parse_alt() -> ReNode {
+        ReNode output{ReKind::Alt};
+        output.children.push_back(this->parse_concat());
+        while (not this->at_end() and this->peek() == '|') {
+            this->pos++;
+            output.children.push_back(this->parse_concat());
+        }
+        if (output.children.size() == 1) {
+            return std::move(output.children[0]);
+        }
+        return output;
+    }
+
+    auto parse_concat() -> ReNode {
+        ReNode output{ReKind::Concat};
+        while (not this->at_end() and this->peek() != '|'
+               and this->peek() != ')') {
+            output.children.push_back(this->parse_repeat());
+        }
+        return output;
+    }
+
+    auto parse_number() -> u32 {
+        u32 output = 0;
+        size_t digits = 0;
+        while (not this->at_end() and this->peek() >= '0'
+               and this->peek() <= '9') {
+            output = output * 10 + (this->next() - '0');
+            if (output > RE_MAX_REPEAT) { throw ReUnsupported{}; }
+            digits++;
+        }
+        if (digits == 0) { throw ReUnsupported{}; }
+        return output;
+    }
+
+    auto parse_repeat() -> ReNode {
+        auto atom = this->parse_atom();
+        if (this->at_end()) { return atom; }
+
+        u32 min = 0;
+        u32 max = RE_UNBOUNDED;
+        switch (this->peek()) {
+        case '*': this->pos++; break;
+        case '+':
+            this->pos++;
+            min = 1;
+            break;
+        case '?':
+            this->pos++;
+            max = 1;
+            break;
+        case '{':
+            this->pos++;
+            min = max = this->parse_number();
+            if (this->next() == ',') {
+                if (this->at_end()) { throw ReUnsupported{}; }
+                max = this->peek() == '}' ? RE_UNBOUNDED : this->parse_number();
+                if (this->next() != '}') { throw ReUnsupported{}; }
+            } else if (this->pattern[this->pos - 1] != '}') {
+                throw ReUnsupported{};
+            }
+            if (max < min) { throw ReUnsupported{}; }
+            break;
+        default: return atom;
+        }
+        if (atom.kind != ReKind::Set and atom.kind != ReKind::Concat
+            and atom.kind != ReKind::Alt and atom.kind != ReKind::Empty) {
+            throw ReUnsupported{};
+        }
+
+        ReNode output{ReKind::Repeat};
+        output.min = min;
+        output.max = max;
+        if (not this->at_end() and this->peek() == '?') {
+            this->pos++;
+            output.greedy = false;
+        }
+        output.children.push_back(std::move(atom));
+        if (not this->at_end()
+            and (this->peek() == '*' or this->peek() == '+'
+                 or this->peek() == '?' or this->peek() == '{')) {
+            throw ReUnsupported{};
+        }
+        return output;
+    }
+
+    // A single character from an escape, with the `\` already consumed.
+    auto parse_char_escape() -> u8 {
+        const char c = this->next();
+        switch (c) {
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case '0':
+            if (not this->at_end() and this->peek() >= '0'
+                and this->peek() <= '9') {
+                throw ReUnsupported{};
+            }
+            return '\0';
+        case 'x': {
+            const u32 hi = re_hex_digit(this->next());
+            return static_cast<u8>(hi * 16 + re_hex_digit(this->next()));
+        }
+        default:
+            // Backreferences, `\c`, `\u` and unknown letters aren't handled.
+            if (std::isalnum(static_cast<u8>(c))) { throw ReUnsupported{}; }
+            return static_cast<u8>(c);
+        }
+    }
+
+    auto parse_class() -> ReNode {
+        ReNode output{ReKind::Set};
+        bool negated = false;
+        if (not this->at_end() and this->peek() == '^') {
+            this->pos++;
+            negated = true;
+        }
+        // `[]` and `[^]` are valid ECMAScript but not every std::regex
+        // agrees, so they're left to it.
+        if (this->peek_class_char() == ']') { throw ReUnsupported{}; }
+        while (this->peek_class_char() != ']') {
+            u8 lo = 0;
+            if (this->peek() == '\\') {
+                this->pos++;
+                const char c = this->peek_class_char();
+                if (auto set = re_class_escape(c)) {
+                    this->pos++;
+                    output.set.add(set.value());
+                    if (this->peek_class_char() == '-') {
+                        throw ReUnsupported{};
+                    }
+                    continue;
+                }
+                if (c == 'b') {
+                    this->pos++;
+                    lo = '\b';
+                } else {
+                    lo = this->parse_char_escape();
+                }
+            } else {
+                lo = static_cast<u8>(this->next());
+            }
+
+            if (this->peek_class_char() == '-'
+                and this->pos + 1 < this->pattern.size()
+                and this->pattern[this->pos + 1] != ']') {
+                this->pos++;
+                u8 hi = 0;
+                if (this->peek() == '\\') {
+                    this->pos++;
+                    if (this->peek() == 'b' or re_class_escape(this->peek())) {
+                        throw ReUnsupported{};
+                    }
+                    hi = this->parse_char_escape();
+                } else {
+                    hi = static_cast<u8>(this->next());
+                }
+                if (hi < lo) { throw ReUnsupported{}; }
+                output.set.add_range(lo, hi);
+            } else {
+                output.set.add(lo);
+            }
+        }
+        this->pos++;
+        if (negated) { output.set.negate(); }
+        return output;
+    }
+
+    auto peek_class_char() const -> char {
+        if (this->at_end()) { throw ReUnsupported{}; }
+        return this->peek();
+    }
+
+    auto parse_atom() -> ReNode {
+        const char c = this->next();
+        switch (c) {
+        case '(': {
+            if (not this->at_end() and this->peek() == '?') {
+                // Only non-capturing groups; lookaround goes to std::regex.
+                if (this->pos + 1 >= this->pattern.size()
+                    or this->pattern[this->pos + 1] != ':') {
+                    throw ReUnsupported{};
+                }
+                this->pos += 2;
+            }
+            auto output = this->parse_alt();
+            if (this->next() != ')') { throw ReUnsupported{}; }
+            // Captures aren't reported, so a group is just its contents.
+            // Wrapping keeps a quantified group from being mistaken for an
+            // assertion.
+            if (output.kind != ReKind::Concat and output.kind != ReKind::Alt) {
+                ReNode group{ReKind::Concat};
+                group.children.push_back(std::move(output));
+                return group;
+            }
+            return output;
+        }
+        case '[': return this->parse_class();
+        case '.': {
+            ReNode output{ReKind::Set};
+            output.set.add_range(0, 255);
+            output.set.bits[0] &= ~((u64{1} << '\n') | (u64{1} << '\r'));
+            return output;
+        }
+        case '^': return ReNode{ReKind::AssertStart};
+        case '$': return ReNode{ReKind::AssertEnd};
+        case '\\': {
+            if (this->at_end()) { throw ReUnsupported{}; }
+            if (this->peek() == 'b' or this->peek() == 'B') {
+                return ReNode{this->next() == 'b' ? ReKind::WordBoundary
+                                                  : ReKind::NotWordBoundary};
+            }
+            ReNode output{ReKind::Set};
+            if (auto set = re_class_escape(this->peek())) {
+                this->pos++;
+                output.set = set.value();
+            } else {
+                output.set.add(this->parse_char_escape());
+            }
+            return output;
+        }
+        case ')':
+        case ']':
+        case '{':
+        case '}':
+        case '*':
+        case '+':
+        case '?': throw ReUnsupported{};
+        default: {
+            ReNode output{ReKind::Set};
+            output.set.add(static_cast<u8>(c));
+            return output;
+        }
+        }
+    }
+};
+} // namespace
+
+struct RegexProgram {
+    std::string pattern;
+    std::vector<ReInst> insts;
+    std::vector<ByteSet> sets;
+    bool has_word_boundary = false;
+    std::optional<std::regex> fallback;
+
+    // Identifies the program in the per-thread DFA caches. Unlike its
+    // address, it's never reused by a later program.
+    u64 id = 0;
+
+    // Lazy DFA over sets of instructions, only used without word boundaries.
+    // A state holds its Set, Match and AssertEnd instructions; `next` is
+    // filled in as bytes are seen, with -1 for not yet computed.
+    struct DfaState {
+        std::vector<u32> pcs;
+        bool is_match  = false;
+        bool end_match = false;
+        i32 next[256];
+    };
+    // The DFA grows as it's used, so each thread builds its own, and a const
+    // Regex can be shared between threads. State 0 is the start.
+    struct Dfa {
+        std::vector<DfaState> states;
+        std::map<std::vector<u32>, u32> index;
+    };
+    // Closure of the first instruction away from the start of the input; it
+    // joins every state so the search is unanchored.
+    std::vector<u32> restart;
+
+    auto compile(const ReNode &node) -> void;
+    auto emit(const ReOp op, const u32 x = 0, const u32 y = 0) -> u32;
+
+    auto closure(std::vector<u32> &stack, const bool at_start,
+                 const bool at_end, std::vector<u32> &output) const -> void;
+    auto thread_dfa() const -> Dfa &;
+    auto dfa_reset(Dfa &dfa) const -> void;
+    auto dfa_state(Dfa &dfa, std::vector<u32> pcs) const -> u32;
+    auto dfa_next(Dfa &dfa, const u32 state, const u8 c) const -> u32;
+    auto dfa_is_match(const std::string_view input) const -> bool;
+    auto pike_find(const std::string_view input, const size_t start) const
+        -> std::optional<std::string_view>;
+};
+
+auto RegexProgram::emit(const ReOp op, const u32 x, const u32 y) -> u32 {
+    if (this->insts.size() >= RE_MAX_INST) { throw ReUnsupported{}; }
+    this->insts.push_back({op, x, y});
+    return static_cast<u32>(this->insts.size() - 1);
+}
+
+auto RegexProgram::compile(const ReNode &node) -> void {
+    const auto here = [this]() { return static_cast<u32>(this->insts.size()); };
+    switch (node.kind) {
+    case ReKind::Empty: break;
+    case ReKind::Set:
+        this->sets.push_back(node.set);
+        this->emit(ReOp::Set, static_cast<u32>(this->sets.size() - 1));
+        break;
+    case ReKind::Concat:
+        for (const auto &it : node.children) { this->compile(it); }
+        break;
+    case ReKind::Alt: {
+        std::vector<u32> jumps;
+        for (size_t i = 0; i + 1 < node.children.size(); i++) {
+            const u32 split = this->emit(ReOp::Split, here() + 1);
+            this->compile(node.children[i]);
+            jumps.push_back(this->emit(ReOp::Jmp));
+            this->insts[split].y = here();
+        }
+        this->compile(node.children.back());
+        for (const auto it : jumps) { this->insts[it].x = here(); }
+        break;
+    }
+    case ReKind::Repeat: {
+        const auto &child = node.children[0];
+        for (u32 i = 0; i < node.min; i++) { this->compile(child); }
+        const auto patch = [&](const u32 split, const u32 body, const u32 out) {
+            this->insts[split].x = node.greedy ? body : out;
+            this->insts[split].y = node.greedy ? out : body;
+        };
+        if (node.max == RE_UNBOUNDED) {
+            const u32 split = this->emit(ReOp::Split);
+            this->compile(child);
+            this->emit(ReOp::Jmp, split);
+            patch(split, split + 1, here());
+            break;
+        }
+        // Once one optional copy is skipped, so are the rest.
+        std::vector<u32> splits;
+        for (u32 i = node.min; i < node.max; i++) {
+            splits.push_back(this->emit(ReOp::Split));
+            this->compile(child);
+        }
+        for (const auto it : splits) { patch(it, it + 1, here()); }
+        break;
+    }
+    case ReKind::AssertStart: this->emit(ReOp::AssertStart); break;
+    case ReKind::AssertEnd: this->emit(ReOp::AssertEnd); break;
+    case ReKind::WordBoundary:
+        this->has_word_boundary = true;
+        this->emit(ReOp::WordBoundary);
+        break;
+    case ReKind::NotWordBoundary:
+        this->has_word_boundary = true;
+        this->emit(ReOp::NotWordBoundary);
+        break;
+    }
+}
+
+// Follows jumps, splits and the anchors that hold from the instructions on
+// `stack`, adding the ones that consume input or wait on the end of the
+// input to `output`, sorted.
+auto RegexProgram::closure(std::vector<u32> &stack, const bool at_start,
+                           const bool at_end, std::vector<u32> &output) const
+    -> void {
+    std::vector<bool> seen(this->insts.size());
+    output.clear();
+    while (not stack.empty()) {
+        const u32 pc = stack.back();
+        stack.pop_back();
+        if (seen[pc]) { continue; }
+        seen[pc]          = true;
+        const auto &inst = this->insts[pc];
+        switch (inst.op) {
+        case ReOp::Jmp: stack.push_back(inst.x); break;
+        case ReOp::Split:
+            stack.push_back(inst.y);
+            stack.push_back(inst.x);
+            break;
+        case ReOp::AssertStart:
+            if (at_start) { stack.push_back(pc + 1); }
+            break;
+        case ReOp::AssertEnd:
+            if (at_end) {
+                stack.push_back(pc + 1);
+            } else {
+                output.push_back(pc);
+            }
+            break;
+        case ReOp::Set:
+        case ReOp::Match: output.push_back(pc); break;
+        case ReOp::WordBoundary:
+        case ReOp::NotWordBoundary: break;
+        }
+    }
+    std::sort(output.begin(), output.end());
+}
+
+auto RegexProgram::dfa_state(Dfa &dfa, std::vector<u32> pcs) const -> u32 {
+    if (auto it = dfa.index.find(pcs); it != dfa.index.end()) {
+        return it->second;
+    }
+
+    DfaState state;
+    std::fill(std::begin(state.next), std::end(state.next), -1);
+    std::vector<u32> stack;
+    for (const auto pc : pcs) {
+        const auto op = this->insts[pc].op;
+        if (op == ReOp::Match) { state.is_match = true; }
+        if (op == ReOp::AssertEnd) { stack.push_back(pc); }
+    }
+    if (not stack.empty()) {
+        std::vector<u32> tail;
+        this->closure(stack, false, true, tail);
+        state.end_match = std::any_of(tail.begin(), tail.end(), [&](u32 pc) {
+            return this->insts[pc].op == ReOp::Match;
+        });
+    }
+    state.end_match |= state.is_match;
+    state.pcs = pcs;
+
+    const auto id = static_cast<u32>(dfa.states.size());
+    dfa.states.push_back(std::move(state));
+    dfa.index.emplace(std::move(pcs), id);
+    return id;
+}
+
+auto RegexProgram::dfa_next(Dfa &dfa, const u32 state, const u8 c) const
+    -> u32 {
+    std::vector<u32> stack;
+    for (const auto pc : dfa.states[state].pcs) {
+        const auto &inst = this->insts[pc];
+        if (inst.op == ReOp::Set and this->sets[inst.x].contains(c)) {
+            stack.push_back(pc + 1);
+        }
+    }
+    std::vector<u32> pcs;
+    this->closure(stack, false, false, pcs);
+    const size_t stepped = pcs.size();
+    pcs.insert(pcs.end(), this->restart.begin(), this->restart.end());
+    std::inplace_merge(pcs.begin(), pcs.begin() + stepped, pcs.end());
+    pcs.erase(std::unique(pcs.begin(), pcs.end()), pcs.end());
+
+    if (dfa.states.size() >= RE_MAX_DFA_STATES) {
+        this->dfa_reset(dfa);
+        return this->dfa_state(dfa, std::move(pcs));
+    }
+    const u32 output = this->dfa_state(dfa, std::move(pcs));
+    dfa.states[state].next[c] = static_cast<i32>(output);
+    return output;
+}
+
+auto RegexProgram::dfa_reset(Dfa &dfa) const -> void {
+    dfa.states.clear();
+    dfa.index.clear();
+    std::vector<u32> stack{0};
+    std::vector<u32> pcs;
+    this->closure(stack, true, false, pcs);
+    this->dfa_state(dfa, std::move(pcs));
+}
+
+// This thread's DFA for the program, from a small most-recently-used list.
+auto RegexProgram::thread_dfa() const -> Dfa & {
+    thread_local std::vector<std::pair<u64, UPtr<Dfa>>> cache;
+    for (size_t i = 0; i < cache.size(); i++) {
+        if (cache[i].first != this->id) { continue; }
+        std::rotate(cache.begin(), cache.begin() + i, cache.begin() + i + 1);
+        return *cache.front().second;
+    }
+
+    if (cache.size() >= RE_DFA_CACHE_SIZE) { cache.pop_back(); }
+    auto dfa = make_unique<Dfa>();
+    this->dfa_reset(*dfa);
+    cache.emplace(cache.begin(), this->id, std::move(dfa));
+    return *cache.front().second;
+}
+
+auto RegexProgram::dfa_is_match(const std::string_view input) const -> bool {
+    Dfa &dfa  = this->thread_dfa();
+    u32 state = 0;
+
+    for (const char c : input) {
+        if (dfa.states[state].is_match) { return true; }
+        const u8 byte  = static_cast<u8>(c);
+        const i32 next = dfa.states[state].next[byte];
+        state = next >= 0 ? static_cast<u32>(next)
+                          : this->dfa_next(dfa, state, byte);
+    }
+    return dfa.states[state].end_match;
+}
+
+namespace {
+// An ordered set of threads with O(1) insert and membership.
+struct PikeThreads {
+    std::vector<u32> sparse;
+    std::vector<std::pair<u32, size_t>> dense;
+    size_t size = 0;
+
+    explicit PikeThreads(const size_t capacity)
+        : sparse(capacity), dense(capacity) {}
+
+    auto contains(const u32 pc) const -> bool {
+        const u32 i = this->sparse[pc];
+        return i < this->size and this->dense[i].first == pc;
+    }
+    auto insert(const u32 pc, const size_t start) -> void {
+        this->sparse[pc]       = static_cast<u32>(this->size);
+        this->dense[this->size] = {pc, start};
+        this->size++;
+    }
+};
+} // namespace
+
+// Leftmost-first, like ECMAScript backtracking: threads are kept in priority
+// order and a match drops every thread below it.
+auto RegexProgram::pike_find(const std::string_view input,
+                             const size_t start) const
+    -> std::optional<std::string_view> {
+    const size_t n = this->insts.size();
+    PikeThreads current{n};
+    PikeThreads next{n};
+    std::vector<u32> stack;
+
+    const auto holds = [&](const ReOp op, const size_t pos) {
+        switch (op) {
+        case ReOp::AssertStart: return pos == 0;
+        case ReOp::AssertEnd: return pos == input.size();
+        default: {
+            const bool before = pos > 0 and re_is_word(input[pos - 1]);
+            const bool after =
+                pos < input.size() and re_is_word(input[pos]);
+            return (before != after) == (op == ReOp::WordBoundary);
+        }
+        }
+    };
+    const auto add = [&](PikeThreads &threads, const u32 pc,
+                         const size_t thread_start, const size_t pos) {
+        stack.push_back(pc);
+        while (not stack.empty()) {
+            const u32 at = stack.back();
+            stack.pop_back();
+            if (threads.contains(at)) { continue; }
+            threads.insert(at, thread_start);
+            const auto &inst = this->insts[at];
+            switch (inst.op) {
+            case ReOp::Jmp: stack.push_back(inst.x); break;
+            case ReOp::Split:
+                stack.push_back(inst.y);
+                stack.push_back(inst.x);
+                break;
+            case ReOp::Set:
+            case ReOp::Match: break;
+            default:
+                if (holds(inst.op, pos)) { stack.push_back(at + 1); }
+                break;
+            }
+        }
+    };
+
+    std::optional<std::pair<size_t, size_t>> found;
+    for (size_t pos = start;; pos++) {
+        if (not found) { add(current, 0, pos, pos); }
+        if (current.size == 0) { break; }
+        for (size_t i = 0; i < current.size; i++) {
+            const auto [pc, thread_start] = current.dense[i];
+            const auto &inst             = this->insts[pc];
+            if (inst.op == ReOp::Match) {
+                found = std::make_pair(thread_start, pos);
+                break;
+            }
+            if (inst.op == ReOp::Set and pos < input.size()
+                and this->sets[inst.x].contains(static_cast<u8>(input[pos]))) {
+                add(next, pc + 1, thread_start, pos + 1);
+            }
+        }
+        if (pos >= input.size()) { break; }
+        std::swap(current, next);
+        next.size = 0;
+    }
+    if (not found) { return {}; }
+    return input.substr(found->first, found->second - found->first);
+}
+
+Regex::Regex(const std::string_view pattern)
+    : program(std::make_shared<RegexProgram>()) {
+    static std::atomic<u64> next_id{1};
+    this->program->id      = next_id.fetch_add(1, std::memory_order_relaxed);
+    this->program->pattern = std::string(pattern);
+    try {
+        const auto root = ReParser{pattern}.parse();
+        this->program->compile(root);
+        this->program->emit(ReOp::Match);
+        std::vector<u32> stack{0};
+        this->program->closure(stack, false, false, this->program->restart);
+    } catch (const ReUnsupported &) {
+        this->program->insts.clear();
+        this->program->sets.clear();
+        this->program->fallback.emplace(this->program->pattern);
+    }
+}
+
+auto Regex::is_match(const std::string_view input) const -> bool {
+    auto &program = *this->program;
+    if (program.fallback) {
+        return std::regex_search(input.begin(), input.end(),
+                                 program.fallback.value());
+    }
+    if (program.has_word_boundary or input.empty()) {
+        return program.pike_find(input, 0).has_value();
+    }
+    return program.dfa_is_match(input);
+}
+
+auto Regex::find_at(const std::string_view input, const size_t start) const
+    -> std::optional<std::string_view> {
+    auto &program = *this->program;
+    if (start > input.size()) { return {}; }
+    if (program.fallback) {
+        std::cmatch match;
+        const auto flags = start > 0 ? std::regex_constants::match_prev_avail
+                                     : std::regex_constants::match_default;
+        if (not std::regex_search(input.data() + start,
+                                  input.data() + input.size(), match,
+                                  program.fallback.value(), flags)) {
+            return {};
+        }
+        return input.substr(match.position(0) + start, match.length(0));
+    }
+    // Most inputs don't match at all, and the DFA says so without tracking
+    // threads.
+    if (start == 0 and not program.has_word_boundary and not input.empty()
+        and not program.dfa_is_match(input)) {
+        return {};
+    }
+    return program.pike_find(input, start);
+}
+
+auto Regex::pattern() const -> const std::string & {
+    return this->program->pattern;
+}
+
+auto Regex::is_native() const -> bool {
+    return not this->program->fallback.has_value();
+}
+
+namespace {
+const size_t REGEX_CACHE_SIZE = 64;
+
+// Most recently used first. Keys view the patterns owned by the entries.
+struct RegexCache {
+    std::list<Regex> entries;
+    std::unordered_map<std::string_view, std::list<Regex>::iterator> index;
+};
+} // namespace
+
+auto cached_regex(const std::string_view pattern) -> Regex {
+    thread_local RegexCache cache;
+    if (auto it = cache.index.find(pattern); it != cache.index.end()) {
+        cache.entries.splice(cache.entries.begin(), cache.entries, it->second);
+        return *it->second;
+    }
+
+    cache.entries.emplace_front(pattern);
+    cache.index.emplace(cache.entries.front().pattern(),
+                        cache.entries.begin());
+    if (cache.entries.size() > REGEX_CACHE_SIZE) {
+        cache.index.erase(cache.entries.back().pattern());
+        cache.entries.pop_back();
+    }
+    return cache.entries.front();
+}
+
+auto re_search(const Regex &re, const std::string_view input) -> bool {
+    return re.is_match(input);
+}
+
+auto re_search(const std::string &re, const std::string &input) -> bool {
+    return cached_regex(re).is_match(input);
+}
+
+auto re_find(const Regex &re, const std::string_view input)
+    -> std::optional<std::string_view> {
+    return re.find_at(input);
+}
+
+auto re_find(const std::string_view re, const std::string_view input)
+    -> std::optional<std::string_view> {
+    return cached_regex(re).find_at(input);
+}
+
+auto re_find_all(const Regex &re, const std::string_view input)
+    -> std::vector<std::string_view> {
+    std::vector<std::string_view> output;
+    size_t pos = 0;
+    while (auto match = re.find_at(input, pos)) {
+        output.push_back(match.value());
+        const size_t end = match->data() - input.data() + match->size();
+        pos              = match->empty() ? end + 1 : end;
+        if (pos > input.size()) { break; }
+    }
+    return output;
+}
+
+auto re_find_all(const std::string_view re, const std::string_view input)
+    -> std::vector<std::string_view> {
+    return re_find_all(cached_regex(re), input);
+}
+
+/// PARALLEL
+namespace {
+// A loop being run, linked to the loop whose body started it. Each one lives
+// on the stack of the `run()` call that owns it.
+struct LoopFrame {
+    const ThreadPoolState *pool;
+    const LoopFrame *parent;
+};
+
+// The loop whose range this thread is running, if any. A worker takes on the
+// whole chain of the loop it's helping with, so a loop started from inside
+// one runs serially on any pool already waiting on it, whichever thread
+// starts it, instead of waiting on itself.
+thread_local const LoopFrame *current_loop = nullptr;
+
+// Failed rounds of stealing before an idle thread goes to sleep.
+const size_t POOL_SPIN_ROUNDS = 64;
+
+auto is_running(const ThreadPoolState *pool, const LoopFrame *loop) -> bool {
+    for (; loop != nullptr; loop = loop->parent) {
+        if (loop->pool == pool) { return true; }
+    }
+    return false;
+}
+
+// Marks this thread as running a range of `loop` until the end of the scope,
+// then puts back the loop it was in before.
+struct CurrentLoop {
+    explicit CurrentLoop(const LoopFrame *loop) : previous(current_loop) {
+        current_loop = loop;
+    }
+    CurrentLoop(const CurrentLoop &)            = delete;
+    CurrentLoop &operator=(const CurrentLoop &) = delete;
+    ~CurrentLoop() {
+        current_loop = this->previous;
+    }
+
+    const LoopFrame *previous;
+};
+} // namespace
+
+struct ThreadPoolState {
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+    // Its owner pushes and pops at the back, where the small, recently split
+    // ranges are, and thieves take from the front.
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    // One per thread, with the last one for whoever called `run()`.
+    size_t size;
+    UPtr<Queue[]> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex run_mutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    u64 generation = 0;
+    bool stop      = false;
+
+    // The loop being run. These are set before its first range is queued,
+    // and whoever takes a range off a queue sees them through its mutex.
+    const std::function<void(size_t, size_t)> *func = nullptr;
+    const LoopFrame *frame                          = nullptr;
+    size_t grain                                    = 1;
+    // Indices not yet run or skipped. The loop is done when it reaches 0.
+    std::atomic<size_t> remaining{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    // Threads that found nothing to steal for a while sleep here until a
+    // range is pushed or the loop finishes, rather than spinning through the
+    // tail of an unbalanced loop. `pushes` counts every push, so a thread
+    // that read it before its last look at the queues can tell whether it
+    // missed one.
+    std::mutex park_mutex;
+    std::condition_variable park;
+    std::atomic<u64> pushes{0};
+    std::atomic<size_t> sleepers{0};
+
+    auto wake_sleepers() -> void {
+        if (this->sleepers.load() == 0) { return; }
+        // Taking the lock orders this with a sleeper's check of `pushes`
+        // and `remaining`, so it's either seen or woken.
+        {
+            std::lock_guard<std::mutex> lock{this->park_mutex};
+        }
+        this->park.notify_all();
+    }
+
+    auto push(const size_t queue, const Range range) -> void {
+        {
+            std::lock_guard<std::mutex> lock{this->queues[queue].mutex};
+            this->queues[queue].ranges.push_back(range);
+        }
+        this->pushes.fetch_add(1);
+        this->wake_sleepers();
+    }
+
+    auto pop(const size_t queue) -> std::optional<Range> {
+        std::lock_guard<std::mutex> lock{this->queues[queue].mutex};
+        auto &ranges = this->queues[queue].ranges;
+        if (ranges.empty()) { return {}; }
+        const Range range = ranges.back();
+        ranges.pop_back();
+        return range;
+    }
+
+    auto steal(const size_t queue) -> std::optional<Range> {
+        std::lock_guard<std::mutex> lock{this->queues[queue].mutex};
+        auto &ranges = this->queues[queue].ranges;
+        if (ranges.empty()) { return {}; }
+        const Range range = ranges.front();
+        ranges.pop_front();
+        return range;
+    }
+
+    auto execute(const size_t self, Range range) -> void {
+        // Splits all the way down to the grain now, leaving halves of
+        // decreasing size on the deque for this thread to come back to or for
+        // others to steal.
+        while (range.end - range.begin > this->grain
+               and !this->failed.load(std::memory_order_relaxed)) {
+            const size_t mid = range.begin + (range.end - range.begin) / 2;
+            this->push(self, Range{mid, range.end});
+            range.end = mid;
+        }
+        if (!this->failed.load(std::memory_order_relaxed)) {
+            try {
+                CurrentLoop inside{this->frame};
+                (*this->func)(range.begin, range.end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock{this->mutex};
+                if (!this->error) { this->error = std::current_exception(); }
+                this->failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        const size_t done = range.end - range.begin;
+        if (this->remaining.fetch_sub(done) == done) { this->wake_sleepers(); }
+    }
+
+    // Runs ranges from this thread's own deque, or stolen from the others,
+    // until the whole loop is done.
+    auto work(const size_t self) -> void {
+        size_t idle = 0;
+        while (this->remaining.load() != 0) {
+            const u64 pushed           = this->pushes.load();
+            std::optional<Range> range = this->pop(self);
+            for (size_t i = 1; !range and i < this->size; i++) {
+                range = this->steal((self + i) % this->size);
+            }
+            if (range) {
+                this->execute(self, *range);
+                idle = 0;
+            } else if (++idle < POOL_SPIN_ROUNDS) {
+                // Everything left is already being run somewhere, but a
+                // range is often split off again soon.
+                std::this_thread::yield();
+            } else {
+                std::unique_lock<std::mutex> lock{this->park_mutex};
+                this->sleepers.fetch_add(1);
+                this->park.wait(lock, [&] {
+                    return this->pushes.load() != pushed
+                        or this->remaining.load() == 0;
+                });
+                this->sleepers.fetch_sub(1);
+                idle = 0;
+            }
+        }
+    }
+
+    auto worker(const size_t self) -> void {
+        u64 seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock{this->mutex};
+                this->wake.wait(lock, [&] {
+                    return this->stop or this->generation != seen;
+                });
+                if (this->stop) { return; }
+                seen = this->generation;
+            }
+            this->work(self);
+        }
+    }
+};
+
+ThreadPool::ThreadPool(const size_t threads)
+    : state(make_unique<ThreadPoolState>()) {
+    size_t size = threads;
+    if (size == 0) { size = std::thread::hardware_concurrency(); }
+    if (size == 0) { size = 1; }
+
+    this->state->size   = size;
+    this->state->queues = UPtr<ThreadPoolState::Queue[]>{
+        new ThreadPoolState::Queue[size]};
+    this->state->threads.reserve(size - 1);
+    for (size_t i = 0; i + 1 < size; i++) {
+        ThreadPoolState *st = this->state.get();
+        st->threads.emplace_back([st, i] { st->worker(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock{this->state->mutex};
+        this->state->stop = true;
+    }
+    this->state->wake.notify_all();
+    for (auto &it : this->state->threads) {
+        it.join();
+    }
+}
+
+auto ThreadPool::size() const -> size_t { return this->state->size; }
+
+auto ThreadPool::run(const size_t count, const size_t grain,
+                     const std::function<void(size_t, size_t)> &func)
+    -> void {
+    if (count == 0) { return; }
+    ThreadPoolState &st = *this->state;
+    if (st.size == 1 or is_running(&st, current_loop)) {
+        func(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> running{st.run_mutex};
+    const LoopFrame frame{&st, current_loop};
+    const size_t self = st.size - 1;
+    st.func           = &func;
+    st.frame          = &frame;
+    st.grain          = grain == 0 ? 1 : grain;
+    st.error          = nullptr;
+    st.failed.store(false, std::memory_order_relaxed);
+    st.remaining.store(count, std::memory_order_relaxed);
+    st.push(self, ThreadPoolState::Range{0, count});
+    {
+        std::lock_guard<std::mutex> lock{st.mutex};
+        st.generation++;
+    }
+    st.wake.notify_all();
+
+    st.work(self);
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock{st.mutex};
+        error = st.error;
+        st.error = nullptr;
+    }
+    if (error) { std::rethrow_exception(error); }
+}
+
+auto default_thread_pool() -> ThreadPool & {
+    static ThreadPool pool{};
+    return pool;
+}
+
+/// MISC
+auto lines_from_file(const std::string &input) -> std::vector<std::string> {
+    // Pipes, devices and /proc files can't be mapped, or say they're empty
+    // when they aren't, so those are read through a stream.
+    struct stat info {};
+    if (stat(input.c_str(), &info) == 0
+        and (!S_ISREG(info.st_mode) or info.st_size == 0)) {
+        std::ifstream file{input};
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        return lines(contents.str());
+    }
+
+    auto file = file_view(input);
+    if (!file) { return {}; }
+
+    const std::string_view contents = file.value().view();
+    std::vector<std::string> output = {};
+    output.reserve(count_byte('\n', contents) + 1);
+    for (const auto &it : lines_view(contents)) {
+        output.emplace_back(it);
+    }
+    return output;
 }
 } // namespace khelper
@@ -1,13 +1,23 @@
 #pragma once
 
+#include <atomic>
+#include <charconv>
 #include <cstdint>
 #include <exception>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <memory_resource>
 #include <ostream>
 #include <set>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #if __cplusplus >= 201703L
@@ -15,6 +25,10 @@
 #include <string_view>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 namespace khelper {
 
 using u8    = uint8_t;
@@ -28,6 +42,9 @@ using i16 = int16_t;
 using i32 = int32_t;
 using i64 = int64_t;
 
+using f32 = float;
+using f64 = double;
+
 using String = std::string;
 #if __cplusplus >= 201703L
 using StringV = std::string_view;
@@ -55,6 +72,7 @@ using UPtr = std::unique_ptr<T>;
 using std::make_unique;
 
 using std::literals::string_literals::operator""s;
+using std::literals::string_view_literals::operator""sv;
 
 /// RESULT
 struct BadResultOkAccess : public std::exception {};
@@ -62,19 +80,19 @@ struct BadResultErrAccess : public std::exception {};
 
 template <typename T, typename E>
 struct Result {
-    operator bool() {
+    operator bool() const {
         return (bool)this->value_;
     }
 
-    auto value() -> T {
-        if (this) {
+    auto value() const -> T {
+        if (this->value_) {
             return this->value_.value();
         } else {
             throw BadResultOkAccess();
         }
     }
 
-    auto err_value() -> E {
+    auto err_value() const -> E {
         if (this->err_value_) {
             return this->err_value_.value();
         } else {
@@ -84,7 +102,7 @@ struct Result {
 
     template <typename U, typename Transform>
     auto transform(Transform func) -> Result<U, E> {
-        if (this) {
+        if (this->value_) {
             return Result<U, E>{
                 .value_     = func(this->value_.value()),
                 .err_value_ = this->err_value_,
@@ -114,7 +132,7 @@ struct Result {
 
     template <typename U>
     auto value_or(U alternative) -> U {
-        if (this) {
+        if (this->value_) {
             return this->value_.value();
         } else {
             return alternative;
@@ -135,11 +153,272 @@ auto Err(E input) -> Result<T, E> {
     return Result<T, E>{.err_value_ = std::make_optional(input)};
 }
 
+// For failures that come from outside the program, like I/O.
+// `code` holds the `errno` value when there is one.
+struct Error {
+    std::string message;
+    int code = 0;
+};
+
+auto operator<<(std::ostream &os, const Error &rhs) -> std::ostream &;
+
 /// PARSE
-auto parse_i32(const std::string &input) -> std::optional<int32_t>;
-auto parse_i64(const std::string &input) -> std::optional<int64_t>;
-auto parse_u32(const std::string &input) -> std::optional<uint32_t>;
-auto parse_u64(const std::string &input) -> std::optional<uint64_t>;
+enum class ParseError {
+    Empty,
+    InvalidDigit,
+    // The value doesn't fit in the requested type.
+    Overflow,
+    // A nonzero float too close to zero for the requested type.
+    Underflow,
+    // A number was read, but it didn't use up the whole input.
+    TrailingCharacters,
+};
+
+auto operator<<(std::ostream &os, const ParseError &rhs) -> std::ostream &;
+
+// Implementation details of the templates below; not part of the API.
+namespace detail {
+// Whether the decimal float `number` has a magnitude below 1, from its digits
+// and exponent alone. Tells a float that's out of range by being tiny from
+// one that's out of range by being huge.
+auto is_below_one(const std::string_view number) -> bool;
+} // namespace detail
+
+// Parses all of `input` as an integer or floating point `T`.
+// Built on `std::from_chars`, so it never throws or allocates, and it follows
+// the same grammar: no leading whitespace and no leading '+'.
+template <typename T>
+auto parse(const std::string_view input) -> Result<T, ParseError> {
+    static_assert(std::is_arithmetic_v<T> and !std::is_same_v<T, bool>,
+                  "parse() takes integer and floating point types");
+    if (input.empty()) { return Err<T, ParseError>(ParseError::Empty); }
+
+    T value{};
+    const char *end = input.data() + input.size();
+    auto [ptr, ec]  = std::from_chars(input.data(), end, value);
+    if (ec == std::errc::result_out_of_range) {
+        if constexpr (std::is_floating_point_v<T>) {
+            const std::string_view number{
+                input.data(), static_cast<size_t>(ptr - input.data())};
+            if (detail::is_below_one(number)) {
+                return Err<T, ParseError>(ParseError::Underflow);
+            }
+        }
+        return Err<T, ParseError>(ParseError::Overflow);
+    }
+    if (ec != std::errc{}) {
+        return Err<T, ParseError>(ParseError::InvalidDigit);
+    }
+    if (ptr != end) {
+        return Err<T, ParseError>(ParseError::TrailingCharacters);
+    }
+    return Ok<T, ParseError>(value);
+}
+
+// Shorthands for `parse()` that only say whether it worked.
+auto parse_i32(const std::string_view input) -> std::optional<int32_t>;
+auto parse_i64(const std::string_view input) -> std::optional<int64_t>;
+auto parse_u32(const std::string_view input) -> std::optional<uint32_t>;
+auto parse_u64(const std::string_view input) -> std::optional<uint64_t>;
+auto parse_f32(const std::string_view input) -> std::optional<float>;
+auto parse_f64(const std::string_view input) -> std::optional<double>;
+
+// A column of numbers parsed in bulk by `parse_column()`.
+template <typename T>
+struct Column {
+    std::vector<T> values;
+    // The index of every field that didn't parse. Those fields are left out
+    // of `values`, so `values.size() + bad_rows.size()` is the field count.
+    std::vector<size_t> bad_rows;
+};
+
+// Parses every `delim`-separated field of `input` as a `T`, in one pass over
+// the buffer. A trailing delimiter doesn't start an empty field, and when
+// `delim` is '\n' a '\r' before it is dropped. Fields follow the `parse()`
+// grammar.
+// Defined in khelper.cpp for every integer width plus f32 and f64.
+template <typename T>
+auto parse_column(const char delim, const std::string_view input) -> Column<T>;
+
+/// ARENA
+// A bump allocator for memory that all dies at once, such as everything one
+// request allocates. Allocating moves a pointer through the current chunk,
+// and a full chunk is followed by one twice its size. Freeing a single
+// allocation does nothing; `reset()` takes everything back but keeps the
+// chunks, so a loop that resets once per request stops calling malloc after
+// the first few. It's a std::pmr::memory_resource, so any pmr container can
+// use it, as can the overloads here that take one.
+struct Arena : std::pmr::memory_resource {
+    explicit Arena(const size_t chunk_size = 64 << 10);
+    Arena(const Arena &)            = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // Everything allocated from the arena is invalid afterwards.
+    auto reset() -> void;
+    // Also gives the chunks back to the heap.
+    auto release() -> void;
+    // Bytes handed out since the last reset, counting alignment padding.
+    auto used() const -> size_t;
+    // Bytes held in chunks.
+    auto capacity() const -> size_t;
+
+  private:
+    auto do_allocate(size_t bytes, size_t alignment) -> void * override;
+    auto do_deallocate(void *, size_t, size_t) -> void override;
+    auto do_is_equal(const std::pmr::memory_resource &other) const noexcept
+        -> bool override;
+
+    struct Chunk {
+        UPtr<char[]> data;
+        size_t size;
+    };
+    std::vector<Chunk> chunks;
+    size_t chunk_size;
+    size_t current = 0;
+    size_t offset  = 0;
+    size_t used_   = 0;
+};
+
+/// SCAN
+// The byte-search core behind `split()`, `lines()` and `find_char()`.
+// `Auto` picks the widest implementation the CPU supports at startup.
+// `Scalar` is the plain one-byte-per-iteration loop, kept for testing.
+enum class ScanImpl { Auto, Scalar, SSE2, AVX2, AVX512 };
+
+auto scan_impl_supported(const ScanImpl impl) -> bool;
+// Returns false, and changes nothing, when the CPU can't run `impl`.
+auto set_scan_impl(const ScanImpl impl) -> bool;
+auto scan_impl() -> ScanImpl;
+auto find_byte(const char needle, const std::string_view input)
+    -> std::optional<size_t>;
+auto count_byte(const char needle, const std::string_view input) -> size_t;
+
+auto operator<<(std::ostream &os, const ScanImpl &rhs) -> std::ostream &;
+
+// A set of bytes, usually built at compile time from a literal:
+// `constexpr CharSet separators{" \t\r\n,;"}`. Membership is kept as two
+// 16-entry nibble tables, the form the vectorized lookup shuffles with, so
+// testing a byte costs the same however many bytes are in the set.
+struct CharSet {
+    constexpr CharSet() = default;
+    constexpr explicit CharSet(const std::string_view chars) {
+        for (const char c : chars) { this->add(c); }
+    }
+
+    constexpr auto add(const char c) -> void {
+        this->table[row(c)] |= bit(c);
+    }
+    constexpr auto contains(const char c) const -> bool {
+        return (this->table[row(c)] & bit(c)) != 0;
+    }
+
+    // table[lo] has bit `hi & 7` set when the byte `hi << 4 | lo` is in the
+    // set, for hi < 8; table[16 + lo] covers hi of 8 and up.
+    u8 table[32] = {};
+
+  private:
+    static constexpr auto row(const char c) -> size_t {
+        const u8 byte = static_cast<u8>(c);
+        return (byte >> 7) * 16 + (byte & 15);
+    }
+    static constexpr auto bit(const char c) -> u8 {
+        return static_cast<u8>(1 << ((static_cast<u8>(c) >> 4) & 7));
+    }
+};
+
+inline constexpr CharSet ASCII_WHITESPACE{" \t\n\v\f\r"};
+
+/// SEARCH
+// A needle preprocessed once, for searching many haystacks. The algorithm is
+// picked by needle length: the byte scanner for one byte, a vectorized
+// first/last-byte filter for short needles, and Two-Way, which is linear in
+// the worst case, for long ones.
+struct Searcher {
+    explicit Searcher(const std::string_view needle);
+
+    // Index of the first match at or after `start`, or `haystack.size()`
+    // when there isn't one. An empty needle matches at `start`.
+    auto next(const std::string_view haystack, const size_t start = 0) const
+        -> size_t;
+    auto needle() const -> std::string_view;
+
+  private:
+    enum class Kind { Empty, Byte, Short, Long };
+
+    auto next_two_way(const std::string_view haystack, size_t start) const
+        -> size_t;
+
+    std::string needle_;
+    Kind kind;
+    // Two-Way state, only filled in for Kind::Long.
+    size_t critical_pos = 0;
+    size_t period       = 0;
+    bool is_periodic    = false;
+    // shift[c] is one past the last index of byte c in the needle, or 0.
+    std::vector<size_t> shift;
+};
+
+auto find(const Searcher &needle, const std::string_view haystack)
+    -> std::optional<size_t>;
+// Non-overlapping matches, left to right.
+auto count_matches(const Searcher &needle, const std::string_view haystack)
+    -> size_t;
+
+struct MultiMatch {
+    size_t pos;
+    size_t len;
+    // Index of the needle that matched.
+    size_t needle;
+
+    bool operator==(const MultiMatch &rhs) const {
+        return this->pos == rhs.pos and this->len == rhs.len
+           and this->needle == rhs.needle;
+    }
+    bool operator!=(const MultiMatch &rhs) const { return !(*this == rhs); }
+};
+
+auto operator<<(std::ostream &os, const MultiMatch &rhs) -> std::ostream &;
+
+// Many needles searched for in a single pass, with an Aho-Corasick automaton
+// over byte classes. Matches are leftmost-longest: the match that starts
+// first wins, and of those the longest. Empty needles never match.
+struct MultiSearcher {
+    explicit MultiSearcher(const std::vector<std::string> &needles);
+
+    // The first match that starts at or after `start`.
+    auto next(const std::string_view haystack, const size_t start = 0) const
+        -> std::optional<MultiMatch>;
+    auto needles() const -> const std::vector<std::string> &;
+
+  private:
+    auto skip_to_start(const std::string_view haystack, size_t pos) const
+        -> size_t;
+
+    std::vector<std::string> needles_;
+    // Bytes that occur in no needle share class 0.
+    u16 byte_class[256] = {};
+    size_t class_count = 1;
+    // Row per state, column per byte class. State 0 is the root.
+    std::vector<u32> transitions;
+    std::vector<u32> depth;
+    // One past the index of the longest needle ending at each state, or 0.
+    std::vector<u32> match;
+    // Bytes a match can start with, for skipping ahead from the root.
+    bool is_start[256] = {};
+    std::string start_bytes;
+};
+
+auto find_any(const MultiSearcher &needles, const std::string_view haystack)
+    -> std::optional<MultiMatch>;
+// Non-overlapping matches, left to right.
+auto find_all(const MultiSearcher &needles, const std::string_view haystack)
+    -> std::vector<MultiMatch>;
+// Replaces every match of `from[i]` with `to[i]` in one pass over `input`.
+// Needles past the end of `to` are deleted.
+auto replace_all(const MultiSearcher &from, const std::vector<std::string> &to,
+                 const std::string_view input) -> std::string;
+auto replace_all(const std::map<std::string, std::string> &replacements,
+                 const std::string_view input) -> std::string;
 
 /// STRING
 template <typename Predicate>
@@ -151,6 +430,13 @@ auto find_char(Predicate p, const std::string_view input)
     return {};
 }
 
+// A predicate can't be vectorized, so searching for a known byte goes through
+// `find_byte()` instead.
+auto find_char(const char needle, const std::string_view input)
+    -> std::optional<std::pair<size_t, char>>;
+auto find_char(const CharSet &set, const std::string_view input)
+    -> std::optional<std::pair<size_t, char>>;
+
 auto black(const std::string_view input) -> std::string;
 auto red(const std::string_view input) -> std::string;
 auto green(const std::string_view input) -> std::string;
@@ -185,16 +471,88 @@ auto cyan_bg(const std::string_view input) -> std::string;
 auto white_bg(const std::string_view input) -> std::string;
 
 auto args_vec(int argc, const char **argv) -> std::vector<std::string>;
+// The older tokenizer: escape backslashes stay in the words and a quote always
+// starts a new word. `shell_split()` quotes the way a shell does.
 auto string_break(const std::string_view input) -> std::vector<std::string>;
+
+// Words of a command line as a POSIX shell splits them, without expansions.
+// Whitespace separates words and '...' is taken literally. Inside "..." a
+// backslash only escapes `$`, a backtick, `"`, `\` or a newline; outside
+// quotes it escapes any byte, and a backslash-newline pair is dropped. Quoted
+// and unquoted parts next to each other make one word, and `""` is an empty
+// word. An unterminated quote runs to the end.
+struct ShellWords {
+    std::vector<std::string_view> words;
+    // Words with quotes or escapes are decoded into here. The rest are views
+    // of the input, so it has to outlive them. Null if nothing was decoded.
+    UPtr<char[]> decoded;
+};
+auto shell_split(const std::string_view input) -> ShellWords;
+// Decoded words are allocated from `arena` and live as long as it does. The
+// memory is never handed back, so this is meant for a monotonic resource.
+auto shell_split(std::pmr::memory_resource &arena, const std::string_view input)
+    -> std::vector<std::string_view>;
+
+// `shell_split()` for one line after another. The word list and the decode
+// buffer are kept between calls, so once they've grown nothing is allocated.
+struct ShellSplitter {
+    // The words are only good until the next call, and those that weren't
+    // decoded view `line`.
+    auto split(const std::string_view line)
+        -> const std::vector<std::string_view> &;
+
+  private:
+    std::vector<std::string_view> words;
+    std::string decoded;
+};
 auto quote_string(const std::string_view input) -> std::string;
 auto split(const std::string_view input, const char &delim)
     -> std::vector<std::string>;
+// `split()` and `lines()` with every string allocated from `arena`.
+auto split(std::pmr::memory_resource &arena, const std::string_view input,
+           const char &delim) -> std::pmr::vector<std::pmr::string>;
+auto lines(std::pmr::memory_resource &arena, const std::string_view input)
+    -> std::pmr::vector<std::pmr::string>;
+// Splits on any byte in `delims`. Like `split()`, empty fields are skipped.
+auto split_any(const CharSet &delims, const std::string_view input)
+    -> std::vector<std::string>;
+// Views into `input` with the bytes in `chars`, or whitespace, cut from the
+// ends.
+auto trim(const std::string_view input) -> std::string_view;
+auto trim(const CharSet &chars, const std::string_view input)
+    -> std::string_view;
+auto trim_start(const std::string_view input) -> std::string_view;
+auto trim_start(const CharSet &chars, const std::string_view input)
+    -> std::string_view;
+auto trim_end(const std::string_view input) -> std::string_view;
+auto trim_end(const CharSet &chars, const std::string_view input)
+    -> std::string_view;
 auto find(const std::string_view needle, const std::string_view haystack)
     -> std::optional<size_t>;
 auto replace(const std::string_view input, const std::string_view from,
              const std::string_view to) -> std::string;
 auto replacen(const std::string_view input, const std::string_view from,
               const std::string_view to, const size_t max_count) -> std::string;
+// The same, with `from` already compiled. An empty `from` replaces nothing.
+auto replace(const std::string_view input, const Searcher &from,
+             const std::string_view to) -> std::string;
+auto replacen(const std::string_view input, const Searcher &from,
+              const std::string_view to, const size_t max_count) -> std::string;
+auto replace(std::pmr::memory_resource &arena, const std::string_view input,
+             const std::string_view from, const std::string_view to)
+    -> std::pmr::string;
+auto replace(std::pmr::memory_resource &arena, const std::string_view input,
+             const Searcher &from, const std::string_view to)
+    -> std::pmr::string;
+// `parts` with `sep` between each pair, sized exactly and allocated once.
+auto join(const std::string_view sep, const std::vector<std::string> &parts)
+    -> std::string;
+auto join(const std::string_view sep,
+          const std::vector<std::string_view> &parts) -> std::string;
+auto join(const std::string_view sep,
+          const std::initializer_list<std::string_view> parts) -> std::string;
+auto join(std::pmr::memory_resource &arena, const std::string_view sep,
+          const std::vector<std::string_view> &parts) -> std::pmr::string;
 auto slice(const size_t start, const std::string &input) -> std::string;
 auto slice(const size_t start, const size_t end, const std::string &input)
     -> std::string;
@@ -203,235 +561,2204 @@ auto starts_with(const std::string_view needle, const std::string_view haystack)
     -> bool;
 auto ends_with(const std::string_view needle, const std::string_view haystack)
     -> bool;
+// Case mapping is ASCII only; every other byte, UTF-8 included, passes
+// through unchanged.
 auto to_lowercase(const std::string_view input) -> std::string;
 auto to_uppercase(const std::string_view input) -> std::string;
+auto make_lowercase(std::string &input) -> void;
+auto make_uppercase(std::string &input) -> void;
+// An rvalue string is converted in its own buffer instead of copied.
+template <typename S,
+          typename = std::enable_if_t<std::is_same_v<S, std::string>>>
+auto to_lowercase(S &&input) -> std::string {
+    make_lowercase(input);
+    return std::move(input);
+}
+template <typename S,
+          typename = std::enable_if_t<std::is_same_v<S, std::string>>>
+auto to_uppercase(S &&input) -> std::string {
+    make_uppercase(input);
+    return std::move(input);
+}
+// ASCII case-insensitive comparisons, without lowered copies.
+auto iequals(const std::string_view lhs, const std::string_view rhs) -> bool;
+auto istarts_with(const std::string_view needle,
+                  const std::string_view haystack) -> bool;
+auto iends_with(const std::string_view needle, const std::string_view haystack)
+    -> bool;
+auto ifind(const std::string_view needle, const std::string_view haystack)
+    -> std::optional<size_t>;
 auto strip_prefix(const std::string_view prefix, const std::string_view input)
     -> std::optional<std::string>;
 auto strip_suffix(const std::string_view suffix, const std::string_view input)
     -> std::optional<std::string>;
 
-/// FORMATTING
-template <typename T>
-auto format(const std::string_view fmt_string, T input) -> std::string {
-    if (!find("{}", fmt_string)) { return std::string{fmt_string}; }
+/// UTF-8
+// Strict UTF-8: no overlong forms, surrogates or code points past U+10FFFF.
+auto utf8_validate(const std::string_view input) -> bool;
+// Code points in `input`, counted as the bytes that aren't continuation
+// bytes; on invalid input each stray lead byte counts as one.
+auto char_count(const std::string_view input) -> size_t;
+// Code points [start, end) of `input`, clamped to its length. Unlike
+// `slice()`, which counts bytes, these never cut a character in half.
+auto char_slice(const size_t start, const size_t end,
+                const std::string_view input) -> std::string_view;
+auto char_slice(const size_t start, const std::string_view input)
+    -> std::string_view;
+// The bytes of code point `index`.
+auto char_nth(const size_t index, const std::string_view input)
+    -> std::optional<std::string_view>;
+
+// The byte offset of every 64th code point of a string, so code point
+// slicing of the same string is O(1) rather than a scan from the start. It
+// views `input`, which has to outlive it.
+struct Utf8Index {
+    explicit Utf8Index(const std::string_view input);
+
+    // Byte offset of code point `index`, or `input().size()` past the end.
+    auto offset(const size_t index) const -> size_t;
+    // Code points in the string.
+    auto size() const -> size_t;
+    auto input() const -> std::string_view;
+
+  private:
+    static constexpr size_t STRIDE = 64;
+
+    std::string_view input_;
+    std::vector<size_t> offsets;
+    size_t count = 0;
+};
+
+auto char_slice(const size_t start, const size_t end, const Utf8Index &input)
+    -> std::string_view;
+auto char_nth(const size_t index, const Utf8Index &input)
+    -> std::optional<std::string_view>;
+
+/// STRING VIEWS
+// A lazy, non-owning range of tokens over `input`.
+// Every token is a view into `input`, so the buffer being split has to outlive
+// the SplitView and anything collected from it.
+struct SplitView {
+    enum class Mode {
+        Delim, // Like `split()`. Empty fields are skipped.
+        Lines, // Like `lines()`. A final line without a '\n' is kept.
+        Words, // Whitespace separated, like the words of `string_break()`.
+        Any,   // Like `split_any()`: any byte of `set` ends a token.
+    };
+
+    struct Iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::string_view;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const std::string_view *;
+        using reference         = const std::string_view &;
+
+        auto operator*() const -> const std::string_view & {
+            return this->token;
+        }
+
+        auto operator->() const -> const std::string_view * {
+            return &this->token;
+        }
+
+        auto operator++() -> Iterator &;
+        auto operator++(int) -> Iterator;
+
+        bool operator==(const Iterator &rhs) const {
+            return this->done == rhs.done
+               and (this->done or this->pos == rhs.pos);
+        }
+
+        bool operator!=(const Iterator &rhs) const {
+            return !(*this == rhs);
+        }
+
+        const SplitView *view = nullptr;
+        size_t pos            = 0;
+        std::string_view token{};
+        bool done = true;
+    };
+
+    auto begin() const -> Iterator;
+    auto end() const -> Iterator;
+    auto count() const -> size_t;
+    auto empty() const -> bool;
+    // Collects every token with a single reservation.
+    auto to_vec() const -> std::vector<std::string_view>;
+
+    std::string_view input;
+    char delim;
+    Mode mode;
+    CharSet set = {};
+};
+
+auto split_view(const char delim, const std::string_view input) -> SplitView;
+auto split_any_view(const CharSet &delims, const std::string_view input)
+    -> SplitView;
+auto lines_view(const std::string_view input) -> SplitView;
+auto words_view(const std::string_view input) -> SplitView;
+
+auto operator<<(std::ostream &os, const SplitView &rhs) -> std::ostream &;
+
+/// FORMATTING
+// `std::to_chars`-style number writers: they fill [first, last) and return
+// one past the last byte written, or `errc::value_too_large` with `last`.
+// 24 bytes hold any integer or shortest double.
+auto u64_to_chars(char *first, char *last, const u64 value)
+    -> std::to_chars_result;
+
+template <typename T,
+          std::enable_if_t<std::is_integral_v<T>
+                               and !std::is_same_v<T, bool>,
+                           int> = 0>
+auto to_chars(char *first, char *last, const T value) -> std::to_chars_result {
+    if constexpr (std::is_signed_v<T>) {
+        if (value < 0) {
+            if (first == last) { return {last, std::errc::value_too_large}; }
+            *first = '-';
+            return u64_to_chars(first + 1, last, 0 - static_cast<u64>(value));
+        }
+    }
+    return u64_to_chars(first, last, static_cast<u64>(value));
+}
+
+// The shortest text that parses back to exactly `value`.
+auto to_chars(char *first, char *last, const f32 value) -> std::to_chars_result;
+auto to_chars(char *first, char *last, const f64 value) -> std::to_chars_result;
+// Like printf's %f, %e or %g with the given precision; `fmt` is 'f', 'e' or
+// 'g'.
+auto to_chars(char *first, char *last, const f32 value,
+              const char fmt, const i32 precision)
+    -> std::to_chars_result;
+auto to_chars(char *first, char *last, const f64 value,
+              const char fmt, const i32 precision)
+    -> std::to_chars_result;
+
+// Replacement fields look like
+//     {[index][:[[fill]align][0][width][.precision][type]]}
+// `align` is one of `<`, `>`, `^`; `type` is one of `d x X o b` for integers,
+// `e f g r` for floats and `s` for anything. `{{` and `}}` are literal braces.
+// A float with no type prints like an ostream would, `%g` with a precision of
+// 6 by default; `r` prints its shortest round-trip form instead.
+struct FormatSpec {
+    char fill     = ' ';
+    char align    = '\0';
+    bool zero_pad = false;
+    u32 width     = 0;
+    i32 precision = -1;
+    char type     = '\0';
+};
+
+// The largest width, precision or argument index a field may give. Past it
+// the field is malformed, rather than wrapping around or asking for
+// gigabytes of padding.
+const constexpr u32 FORMAT_SPEC_MAX = 1 << 16;
+
+// One step of a parsed format string. `offset` and `size` always cover the
+// source text of the piece, so an argument that was never passed can be
+// written back out verbatim.
+struct FormatPiece {
+    bool literal  = true;
+    size_t offset = 0;
+    size_t size   = 0;
+    size_t arg    = 0;
+    FormatSpec spec{};
+};
+
+// Parses the piece starting at `pos` into `piece` and moves `pos` past it.
+// Returns false on a malformed field, leaving `pos` alone.
+constexpr auto next_format_piece(const std::string_view fmt, size_t &pos,
+                                 size_t &next_arg, FormatPiece &piece) -> bool {
+    piece           = FormatPiece{};
+    piece.offset    = pos;
+    const char open = fmt[pos];
+    if (open != '{' and open != '}') {
+        size_t end = pos;
+        while (end < fmt.size() and fmt[end] != '{' and fmt[end] != '}') {
+            end++;
+        }
+        piece.size = end - pos;
+        pos        = end;
+        return true;
+    }
+    if (pos + 1 < fmt.size() and fmt[pos + 1] == open) {
+        piece.size = 1;
+        pos += 2;
+        return true;
+    }
+    if (open == '}') { return false; }
+
+    auto is_digit = [](const char c) { return c >= '0' and c <= '9'; };
+    auto at       = [&](const size_t i) {
+        return i < fmt.size() ? fmt[i] : '\0';
+    };
+    size_t i = pos + 1;
+    // Reads a run of digits into `out`; false once it passes the limit.
+    auto read_number = [&](auto &out) {
+        while (is_digit(at(i))) {
+            out = out * 10 + (at(i++) - '0');
+            if (static_cast<u64>(out) > FORMAT_SPEC_MAX) { return false; }
+        }
+        return true;
+    };
+
+    const bool is_implicit = !is_digit(at(i));
+    if (is_implicit) {
+        piece.arg = next_arg;
+    } else if (!read_number(piece.arg)) {
+        return false;
+    }
+
+    FormatSpec &spec = piece.spec;
+    if (at(i) == ':') {
+        i++;
+        auto is_align = [](const char c) {
+            return c == '<' or c == '>' or c == '^';
+        };
+        if (at(i) != '\0' and at(i) != '}' and is_align(at(i + 1))) {
+            spec.fill  = at(i);
+            spec.align = at(i + 1);
+            i += 2;
+        } else if (is_align(at(i))) {
+            spec.align = at(i++);
+        }
+        if (at(i) == '0') {
+            spec.zero_pad = true;
+            i++;
+        }
+        if (!read_number(spec.width)) { return false; }
+        if (at(i) == '.') {
+            i++;
+            if (!is_digit(at(i))) { return false; }
+            spec.precision = 0;
+            if (!read_number(spec.precision)) { return false; }
+        }
+        switch (at(i)) {
+            case 'd': case 'x': case 'X': case 'o': case 'b':
+            case 'e': case 'f': case 'g': case 'r': case 's':
+                spec.type = at(i++);
+                break;
+            default:
+                break;
+        }
+    }
+    if (at(i) != '}') { return false; }
+
+    if (is_implicit) { next_arg++; }
+    piece.literal = false;
+    piece.size    = i + 1 - pos;
+    pos           = i + 1;
+    return true;
+}
+
+// A format string parsed at compile time; build one with `kfmt("...")`.
+// A malformed literal fails to compile instead of printing garbage.
+template <size_t N>
+struct FormatString {
+    constexpr FormatString(const char (&input)[N]) : text{input, N - 1} {
+        size_t pos      = 0;
+        size_t next_arg = 0;
+        while (pos < this->text.size()) {
+            if (!next_format_piece(this->text, pos, next_arg,
+                                   this->pieces[this->count])) {
+                throw std::invalid_argument("malformed format string");
+            }
+            this->count++;
+        }
+    }
+
+    std::string_view text;
+    // Every piece consumes at least one byte, so N slots always suffice.
+    FormatPiece pieces[N]{};
+    size_t count = 0;
+};
+
+#define kfmt(x)                                                                \
+    ([]() -> const auto & {                                                    \
+        static constexpr ::khelper::FormatString fmt_{x};                      \
+        return fmt_;                                                           \
+    }())
+
+// Type-erased reference to one argument, so the formatting loop itself is
+// compiled once rather than once per argument list.
+struct FormatArg {
+    const void *value;
+    void (*write)(std::string &out, const void *value, const FormatSpec &spec);
+};
+
+auto format_write_int(std::string &out, const u64 magnitude,
+                      const bool negative, const FormatSpec &spec) -> void;
+auto format_write_float(std::string &out, const f32 input,
+                        const FormatSpec &spec) -> void;
+auto format_write_float(std::string &out, const f64 input,
+                        const FormatSpec &spec) -> void;
+auto format_write_str(std::string &out, const std::string_view input,
+                      const FormatSpec &spec) -> void;
+
+// Pads the text appended to `out` since `start` out to the spec's width.
+auto format_pad_tail(std::string &out, const size_t start,
+                     const FormatSpec &spec) -> void;
+
+// A streambuf that appends to a string, so an operator<< can write straight
+// into a format buffer without an ostringstream and its copy.
+struct StringAppendBuf : std::streambuf {
+    explicit StringAppendBuf(std::string &out) : out(out) {}
+
+  protected:
+    auto overflow(int_type c) -> int_type override;
+    auto xsputn(const char *data, std::streamsize size)
+        -> std::streamsize override;
+
+  private:
+    std::string &out;
+};
+
+// Builtin types skip the ostream; anything else is streamed with the
+// `operator<<` it already has, so output matches `std::cout << input`.
+template <typename T>
+auto format_write(std::string &out, const void *value, const FormatSpec &spec)
+    -> void {
+    const T &input = *static_cast<const T *>(value);
+    using D        = std::decay_t<T>;
+    constexpr bool is_char = std::is_same_v<D, char>
+                          or std::is_same_v<D, signed char>
+                          or std::is_same_v<D, unsigned char>;
+
+    if constexpr (std::is_same_v<D, bool>) {
+        format_write_int(out, input ? 1 : 0, false, spec);
+    } else if constexpr (std::is_integral_v<D>) {
+        if (is_char and (spec.type == '\0' or spec.type == 's')) {
+            const char c = static_cast<char>(input);
+            format_write_str(out, std::string_view{&c, 1}, spec);
+        } else if constexpr (std::is_signed_v<D>) {
+            const u64 magnitude = input < 0 ? 0 - static_cast<u64>(input)
+                                            : static_cast<u64>(input);
+            format_write_int(out, magnitude, input < 0, spec);
+        } else {
+            format_write_int(out, static_cast<u64>(input), false, spec);
+        }
+    } else if constexpr (std::is_same_v<D, f32> or std::is_same_v<D, f64>) {
+        format_write_float(out, input, spec);
+    } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+        format_write_str(out, std::string_view{input}, spec);
+    } else {
+        const size_t start = out.size();
+        {
+            StringAppendBuf appender{out};
+            std::ostream os{&appender};
+            os << input;
+        }
+        format_pad_tail(out, start, spec);
+    }
+}
+
+template <typename T>
+auto make_format_arg(const T &input) -> FormatArg {
+    return FormatArg{&input, &format_write<T>};
+}
+
+// The single-pass cores. A field naming an argument past `arg_count` is
+// written out as-is.
+auto vformat_to(std::string &out, const std::string_view fmt,
+                const FormatArg *args, const size_t arg_count) -> void;
+auto vformat_to(std::string &out, const std::string_view text,
+                const FormatPiece *pieces, const size_t piece_count,
+                const FormatArg *args, const size_t arg_count) -> void;
+
+// Appends to `out`, so a buffer can be reused across calls.
+template <typename... Args>
+auto format_to(std::string &out, const std::string_view fmt_string,
+               const Args &...args) -> void {
+    const FormatArg packed[sizeof...(Args) + 1] = {make_format_arg(args)...};
+    vformat_to(out, fmt_string, packed, sizeof...(Args));
+}
+
+template <size_t N, typename... Args>
+auto format_to(std::string &out, const FormatString<N> &fmt,
+               const Args &...args) -> void {
+    const FormatArg packed[sizeof...(Args) + 1] = {make_format_arg(args)...};
+    vformat_to(out, fmt.text, fmt.pieces, fmt.count, packed, sizeof...(Args));
+}
+
+template <typename... Args>
+auto format(const std::string_view fmt_string, const Args &...args)
+    -> std::string {
+    std::string output = {};
+    output.reserve(fmt_string.size() + 16 * sizeof...(Args));
+    format_to(output, fmt_string, args...);
+    return output;
+}
+
+template <size_t N, typename... Args>
+auto format(const FormatString<N> &fmt, const Args &...args) -> std::string {
+    std::string output = {};
+    output.reserve(fmt.text.size() + 16 * sizeof...(Args));
+    format_to(output, fmt, args...);
+    return output;
+}
+
+// Formats in a scratch buffer kept per thread, then copies the result into
+// memory from `arena`, so once the scratch buffer has grown the arena is the
+// only allocator involved.
+auto vformat(std::pmr::memory_resource &arena, const std::string_view fmt,
+             const FormatArg *args, const size_t arg_count)
+    -> std::pmr::string;
+auto vformat(std::pmr::memory_resource &arena, const std::string_view text,
+             const FormatPiece *pieces, const size_t piece_count,
+             const FormatArg *args, const size_t arg_count)
+    -> std::pmr::string;
+
+template <typename... Args>
+auto format(std::pmr::memory_resource &arena, const std::string_view fmt_string,
+            const Args &...args) -> std::pmr::string {
+    const FormatArg packed[sizeof...(Args) + 1] = {make_format_arg(args)...};
+    return vformat(arena, fmt_string, packed, sizeof...(Args));
+}
+
+template <size_t N, typename... Args>
+auto format(std::pmr::memory_resource &arena, const FormatString<N> &fmt,
+            const Args &...args) -> std::pmr::string {
+    const FormatArg packed[sizeof...(Args) + 1] = {make_format_arg(args)...};
+    return vformat(arena, fmt.text, fmt.pieces, fmt.count, packed,
+                   sizeof...(Args));
+}
+
+/// SLICE
+template <typename T>
+struct SliceChunks;
+template <typename T>
+struct SliceWindows;
+
+// A view of contiguous elements, like std::span: a pointer and a length,
+// owning nothing. `Slice<const T>` reads and `Slice<T>` can also write
+// through. Copies are free, and a Slice is only good for as long as the
+// memory it points into.
+template <typename T>
+struct Slice {
+    using value_type = std::remove_cv_t<T>;
+
+    constexpr Slice() = default;
+    constexpr Slice(T *data, const size_t size) : ptr(data), len(size) {}
+    // A const vector only gives a `Slice<const T>`.
+    template <typename U, typename = std::enable_if_t<
+                              std::is_same_v<const U, const value_type>
+                              and (std::is_const_v<T> or !std::is_const_v<U>)>>
+    constexpr Slice(std::vector<U> &input)
+        : ptr(input.data()), len(input.size()) {}
+    template <typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+    constexpr Slice(const std::vector<value_type> &input)
+        : ptr(input.data()), len(input.size()) {}
+    // `[start, end)` of `input`, which has to be in range.
+    template <typename V>
+    constexpr Slice(const size_t start, const size_t end, V &input)
+        : ptr(input.data() + start), len(end - start) {}
+    // A `Slice<T>` passes for a `Slice<const T>`.
+    template <typename U, typename = std::enable_if_t<
+                              std::is_const_v<T>
+                              and std::is_same_v<const U, T>>>
+    constexpr Slice(const Slice<U> &other)
+        : ptr(other.data()), len(other.size()) {}
+
+    constexpr auto data() const -> T * {
+        return this->ptr;
+    }
+
+    constexpr auto size() const -> size_t {
+        return this->len;
+    }
+
+    constexpr auto empty() const -> bool {
+        return this->len == 0;
+    }
+
+    constexpr auto begin() const -> T * {
+        return this->ptr;
+    }
+
+    constexpr auto end() const -> T * {
+        return this->ptr + this->len;
+    }
+
+    constexpr auto operator[](const size_t index) const -> T & {
+        return this->ptr[index];
+    }
+
+    constexpr auto front() const -> T & {
+        return this->ptr[0];
+    }
+
+    constexpr auto back() const -> T & {
+        return this->ptr[this->len - 1];
+    }
+
+    auto to_vec() const -> std::vector<value_type> {
+        return std::vector<value_type>(this->begin(), this->end());
+    }
+
+    // `[start, end)` of this slice, or nothing if that's out of range.
+    constexpr auto subslice(const size_t start, const size_t end) const
+        -> std::optional<Slice> {
+        if (start > end or end > this->len) { return {}; }
+        return Slice{this->ptr + start, end - start};
+    }
+
+    // `[0, mid)` and `[mid, size())`. Throws std::out_of_range if `mid` is
+    // past the end.
+    auto split_at(const size_t mid) const -> std::pair<Slice, Slice> {
+        if (mid > this->len) { throw std::out_of_range("split_at"); }
+        return {Slice{this->ptr, mid},
+                Slice{this->ptr + mid, this->len - mid}};
+    }
+
+    // Runs of `size` elements, with whatever is left over as a shorter last
+    // one. Throws std::invalid_argument if `size` is 0.
+    auto chunks(const size_t size) const -> SliceChunks<T>;
+    // Every run of `size` neighbouring elements, overlapping, and none at all
+    // if there are fewer than `size`. Throws std::invalid_argument if `size`
+    // is 0.
+    auto windows(const size_t size) const -> SliceWindows<T>;
+
+    // The runs between elements that match `pred`, which are left out. Two
+    // matches next to each other give an empty run between them.
+    // `rsplit()` gives the same runs starting from the back.
+    template <typename Predicate>
+    auto split(Predicate pred) const -> std::vector<Slice> {
+        std::vector<Slice> output = {};
+        size_t start              = 0;
+        for (size_t i = 0; i < this->len; i++) {
+            if (pred(this->ptr[i])) {
+                output.push_back(Slice{this->ptr + start, i - start});
+                start = i + 1;
+            }
+        }
+        output.push_back(Slice{this->ptr + start, this->len - start});
+        return output;
+    }
+
+    template <typename Predicate>
+    auto rsplit(Predicate pred) const -> std::vector<Slice> {
+        std::vector<Slice> output = {};
+        size_t end                = this->len;
+        for (size_t i = this->len; i > 0; i--) {
+            if (pred(this->ptr[i - 1])) {
+                output.push_back(Slice{this->ptr + i, end - i});
+                end = i - 1;
+            }
+        }
+        output.push_back(Slice{this->ptr, end});
+        return output;
+    }
+
+    // Compares the elements, not where they are.
+    template <typename U>
+    auto operator==(const Slice<U> &rhs) const -> bool {
+        if (this->len != rhs.size()) { return false; }
+        for (size_t i = 0; i < this->len; i++) {
+            if (!(this->ptr[i] == rhs[i])) { return false; }
+        }
+        return true;
+    }
+
+    template <typename U>
+    auto operator!=(const Slice<U> &rhs) const -> bool {
+        return !(*this == rhs);
+    }
+
+  private:
+    T *ptr     = nullptr;
+    size_t len = 0;
+};
+
+template <typename T>
+Slice(std::vector<T> &) -> Slice<T>;
+template <typename T>
+Slice(const std::vector<T> &) -> Slice<const T>;
+
+template <typename T>
+struct SliceChunks {
+    struct Iterator {
+        auto operator*() const -> Slice<T> {
+            return Slice<T>{this->ptr, this->taken()};
+        }
+
+        auto operator++() -> Iterator & {
+            const size_t taken = this->taken();
+            this->ptr += taken;
+            this->left -= taken;
+            return *this;
+        }
+
+        auto taken() const -> size_t {
+            return this->step < this->left ? this->step : this->left;
+        }
+
+        auto operator==(const Iterator &rhs) const -> bool {
+            return this->left == rhs.left;
+        }
+
+        auto operator!=(const Iterator &rhs) const -> bool {
+            return this->left != rhs.left;
+        }
+
+        T *ptr;
+        size_t left;
+        size_t step;
+    };
+
+    auto begin() const -> Iterator {
+        return Iterator{this->input.data(), this->input.size(), this->step};
+    }
+
+    auto end() const -> Iterator {
+        return Iterator{this->input.end(), 0, this->step};
+    }
+
+    auto size() const -> size_t {
+        return (this->input.size() + this->step - 1) / this->step;
+    }
+
+    Slice<T> input;
+    size_t step;
+};
+
+template <typename T>
+struct SliceWindows {
+    struct Iterator {
+        auto operator*() const -> Slice<T> {
+            return Slice<T>{this->ptr, this->width};
+        }
+
+        auto operator++() -> Iterator & {
+            this->ptr++;
+            return *this;
+        }
+
+        auto operator==(const Iterator &rhs) const -> bool {
+            return this->ptr == rhs.ptr;
+        }
+
+        auto operator!=(const Iterator &rhs) const -> bool {
+            return this->ptr != rhs.ptr;
+        }
+
+        T *ptr;
+        size_t width;
+    };
+
+    auto begin() const -> Iterator {
+        return Iterator{this->input.data(), this->width};
+    }
+
+    auto end() const -> Iterator {
+        return Iterator{this->input.data() + this->size(), this->width};
+    }
+
+    auto size() const -> size_t {
+        const size_t len = this->input.size();
+        return len < this->width ? 0 : len - this->width + 1;
+    }
+
+    Slice<T> input;
+    size_t width;
+};
+
+template <typename T>
+auto Slice<T>::chunks(const size_t size) const -> SliceChunks<T> {
+    if (size == 0) { throw std::invalid_argument("chunks: size is 0"); }
+    return SliceChunks<T>{*this, size};
+}
+
+template <typename T>
+auto Slice<T>::windows(const size_t size) const -> SliceWindows<T> {
+    if (size == 0) { throw std::invalid_argument("windows: size is 0"); }
+    return SliceWindows<T>{*this, size};
+}
+
+template <typename T>
+auto operator<<(std::ostream &os, const Slice<T> &rhs) -> std::ostream & {
+    os << "Slice { ";
+    for (size_t i = 0; i < rhs.size(); i++) {
+        if (i != 0) { os << ", "; }
+        os << rhs[i];
+    }
+    os << " }";
+    return os;
+}
+
+/// VECTOR
+template <typename T>
+auto nth(const size_t index, const std::vector<T> &input) -> std::optional<T> {
+    if (index < input.size()) { return std::make_optional(input[index]); }
+    return {};
+}
+
+template <typename Transform, typename T,
+          typename U = std::decay_t<decltype(std::declval<Transform &>()(
+                                                 std::declval<const T &>())
+                                                 .value())>>
+auto flat_map(Transform func, const std::vector<T> &input) -> std::vector<U> {
+    std::vector<U> output = {};
+    for (const auto &it : input) {
+        if (auto elem = func(it); elem) { output.push_back(elem.value()); }
+    }
+    return output;
+}
+
+// The overloads taking `std::vector<T> &&` consume their input: elements are
+// moved into `func` rather than copied, and where the output has the input's
+// element type it is built in the input's buffer, so a chain of them on a
+// vector the caller owns allocates nothing.
+template <typename Transform, typename T,
+          typename U = std::decay_t<decltype(std::declval<Transform &>()(
+                                                 std::declval<T &&>())
+                                                 .value())>>
+auto flat_map(Transform func, std::vector<T> &&input) -> std::vector<U> {
+    std::vector<U> output = {};
+    for (auto &&it : input) {
+        if (auto elem = func(std::move(it)); elem) {
+            output.push_back(std::move(elem).value());
+        }
+    }
+    return output;
+}
+
+/// F is f(acc, elem) -> new_acc.
+template <typename T, typename U, typename F>
+auto fold(U init, F func, const std::vector<T> &input) -> U {
+    U acc{init};
+    for (const auto &it : input) {
+        acc = func(acc, it);
+    }
+    return acc;
+}
+
+template <typename T, typename U, typename F>
+auto fold(U init, F func, std::vector<T> &&input) -> U {
+    U acc{std::move(init)};
+    for (auto &&it : input) {
+        acc = func(std::move(acc), std::move(it));
+    }
+    return acc;
+}
+
+/// F is f(acc, elem) -> <Some type that converts to bool>.
+template <typename T, typename U, typename F>
+auto try_fold(U init, F func, const std::vector<T> &input) -> U {
+    U acc{init};
+    for (const auto &it : input) {
+        if (auto new_acc = func(acc, it); new_acc) {
+            acc = new_acc;
+        } else {
+            return acc;
+        }
+    }
+    return acc;
+}
+
+// `acc` isn't moved into `func`, since it's the result when `func` fails.
+template <typename T, typename U, typename F>
+auto try_fold(U init, F func, std::vector<T> &&input) -> U {
+    U acc{std::move(init)};
+    for (auto &&it : input) {
+        if (auto new_acc = func(acc, std::move(it)); new_acc) {
+            acc = std::move(new_acc);
+        } else {
+            return acc;
+        }
+    }
+    return acc;
+}
+
+// `[start, end)` of `input` without copying, or nothing if `start` isn't an
+// index of `input` or `end` is out of range. A temporary vector would leave
+// the Slice dangling, so those don't compile.
+template <typename T>
+auto slice(const size_t start, const size_t end, std::vector<T> &input)
+    -> std::optional<Slice<T>> {
+    if (end < start or start >= input.size() or end > input.size()) {
+        return {};
+    }
+    return Slice<T>{start, end, input};
+}
+
+template <typename T>
+auto slice(const size_t start, const size_t end, const std::vector<T> &input)
+    -> std::optional<Slice<const T>> {
+    if (end < start or start >= input.size() or end > input.size()) {
+        return {};
+    }
+    return Slice<const T>{start, end, input};
+}
+
+template <typename T>
+auto slice(const size_t start, std::vector<T> &input)
+    -> std::optional<Slice<T>> {
+    return slice(start, input.size(), input);
+}
+
+template <typename T>
+auto slice(const size_t start, const std::vector<T> &input)
+    -> std::optional<Slice<const T>> {
+    return slice(start, input.size(), input);
+}
+
+template <typename T>
+auto slice(const size_t, const size_t, const std::vector<T> &&) = delete;
+template <typename T>
+auto slice(const size_t, const std::vector<T> &&) = delete;
+
+template <typename Predicate, typename T>
+auto take_while(Predicate pred, const std::vector<T> &input) -> std::vector<T> {
+    std::vector<T> output = {};
+    for (const auto &it : input) {
+        if (pred(it)) {
+            output.push_back(it);
+        } else {
+            break;
+        }
+    }
+
+    return output;
+}
+
+template <typename Predicate, typename T>
+auto take_while(Predicate pred, std::vector<T> &&input) -> std::vector<T> {
+    size_t taken = 0;
+    while (taken < input.size() and pred(input[taken])) {
+        taken++;
+    }
+    input.erase(input.begin() + taken, input.end());
+    return std::move(input);
+}
+
+// `destination` is being extended by `source`. A sized insert grows the
+// buffer geometrically, so appending in a loop stays linear, and copies
+// trivially copyable elements of the same type with one memmove.
+template <typename T, typename U>
+auto append(std::vector<T> &dest, const std::vector<U> &src) {
+    dest.insert(dest.end(), src.begin(), src.end());
+}
+
+// Consumes `src`, moving its elements.
+template <typename T, typename U>
+auto append(std::vector<T> &dest, std::vector<U> &&src) {
+    dest.insert(dest.end(), std::make_move_iterator(src.begin()),
+                std::make_move_iterator(src.end()));
+}
+
+// Takes any number of vectors and returns them concatenated. The output type
+// is the first vector's, and the others' elements are converted to it. The
+// output is sized exactly up front, so it's allocated once, and vectors
+// passed as rvalues have their elements moved.
+template <typename T, typename... Rest>
+auto concat(const std::vector<T> &first, Rest &&...rest) -> std::vector<T> {
+    std::vector<T> output = {};
+    output.reserve(first.size() + (size_t{0} + ... + rest.size()));
+    append(output, first);
+    (append(output, std::forward<Rest>(rest)), ...);
+    return output;
+}
+
+// Builds on the first vector's buffer, which only reallocates if it's too
+// small for the rest.
+template <typename T, typename... Rest>
+auto concat(std::vector<T> &&first, Rest &&...rest) -> std::vector<T> {
+    first.reserve(first.size() + (size_t{0} + ... + rest.size()));
+    (append(first, std::forward<Rest>(rest)), ...);
+    return std::move(first);
+}
+
+template <typename T, typename... Rest>
+auto concat(std::pmr::memory_resource &arena, const std::vector<T> &first,
+            const Rest &...rest) -> std::pmr::vector<T> {
+    std::pmr::vector<T> output{&arena};
+    output.reserve(first.size() + (size_t{0} + ... + rest.size()));
+    output.insert(output.end(), first.begin(), first.end());
+    (output.insert(output.end(), rest.begin(), rest.end()), ...);
+    return output;
+}
+
+template <typename T>
+auto flatten(const std::vector<std::optional<T>> &input) -> std::vector<T> {
+    std::vector<T> output = {};
+    for (size_t i = 0; i < input.size(); i++) {
+        if (input[i]) { output.push_back(input[i].value()); }
+    }
+    return output;
+}
+
+template <typename T>
+auto flatten(const std::vector<std::vector<T>> &input) -> std::vector<T> {
+    std::vector<T> output = {};
+    for (const auto &it : input) {
+        for (const auto &elem : it) {
+            output.push_back(elem);
+        }
+    }
+    return output;
+}
+
+template <typename T, typename U, typename Transform>
+auto fmap(Transform func, const std::vector<T> &input) -> std::vector<U> {
+    std::vector<U> output = {};
+    output.reserve(input.size());
+    for (const auto &it : input) {
+        output.push_back(func(it));
+    }
+    return output;
+}
+
+template <typename T, typename U, typename Transform>
+auto fmap(Transform func, std::vector<T> &&input) -> std::vector<U> {
+    if constexpr (std::is_same_v<T, U>) {
+        for (size_t i = 0; i < input.size(); i++) {
+            input[i] = func(std::move(input[i]));
+        }
+        return std::move(input);
+    } else {
+        std::vector<U> output = {};
+        output.reserve(input.size());
+        for (auto &&it : input) {
+            output.push_back(func(std::move(it)));
+        }
+        return output;
+    }
+}
+
+template <typename T, typename Predicate>
+auto filter(Predicate pred, const std::vector<T> &input) -> std::vector<T> {
+    std::vector<T> output = {};
+    for (const auto &it : input) {
+        if (pred(it)) { output.push_back(it); }
+    }
+    return output;
+}
+
+// Kept elements are moved down over the dropped ones, keeping their order.
+template <typename T, typename Predicate>
+auto filter(Predicate pred, std::vector<T> &&input) -> std::vector<T> {
+    size_t kept = 0;
+    for (size_t i = 0; i < input.size(); i++) {
+        if (!pred(input[i])) { continue; }
+        if (kept != i) { input[kept] = std::move(input[i]); }
+        kept++;
+    }
+    input.erase(input.begin() + kept, input.end());
+    return std::move(input);
+}
+
+// `fmap()` and `filter()` with the output allocated from `arena`. Elements
+// that allocate for themselves only use the arena if their type is
+// allocator-aware, such as std::pmr::string.
+template <typename T, typename Transform,
+          typename U = std::decay_t<std::invoke_result_t<Transform, const T &>>>
+auto fmap(std::pmr::memory_resource &arena, Transform func,
+          const std::vector<T> &input) -> std::pmr::vector<U> {
+    std::pmr::vector<U> output{&arena};
+    output.reserve(input.size());
+    for (const auto &it : input) {
+        output.push_back(func(it));
+    }
+    return output;
+}
+
+template <typename T, typename Predicate>
+auto filter(std::pmr::memory_resource &arena, Predicate pred,
+            const std::vector<T> &input) -> std::pmr::vector<T> {
+    std::pmr::vector<T> output{&arena};
+    for (const auto &it : input) {
+        if (pred(it)) { output.push_back(it); }
+    }
+    return output;
+}
+
+// The in-place family below makes one pass, moving each element it keeps
+// down over the ones dropped before it and erasing the leftover tail once, so
+// it stays O(n) however many go. Kept elements keep their order. Each
+// returns the number of elements removed.
+
+// Keeps the elements `pred` returns true for. `pred` may modify them. If it
+// throws, the element it threw on and everything after it are kept, so
+// nothing is left moved-from.
+template <typename T, typename Predicate>
+auto retain_mut(Predicate pred, std::vector<T> &input) -> size_t {
+    const size_t size = input.size();
+    size_t kept       = 0;
+    size_t i          = 0;
+    try {
+        for (; i < size; i++) {
+            if (!pred(input[i])) { continue; }
+            if (kept != i) { input[kept] = std::move(input[i]); }
+            kept++;
+        }
+    } catch (...) {
+        for (; i < size; i++, kept++) {
+            if (kept != i) { input[kept] = std::move(input[i]); }
+        }
+        input.erase(input.begin() + kept, input.end());
+        throw;
+    }
+    input.erase(input.begin() + kept, input.end());
+    return size - kept;
+}
+
+template <typename T, typename Predicate>
+auto retain(Predicate pred, std::vector<T> &input) -> size_t {
+    return retain_mut([&](const auto &it) { return pred(it); }, input);
+}
+
+// Removes each element for which same(last_kept, elem) is true, so runs of
+// "same" elements collapse to their first.
+template <typename T, typename Same>
+auto dedup_by(Same same, std::vector<T> &input) -> size_t {
+    // `retain_mut` has moved every kept element into place by the time it
+    // looks at the next one, so the last one kept is at `kept - 1`.
+    size_t kept = 0;
+    return retain_mut(
+        [&](const auto &it) {
+            if (kept != 0 and same(input[kept - 1], it)) { return false; }
+            kept++;
+            return true;
+        },
+        input);
+}
+
+// Removes consecutive repeats, like `uniq`. Sort first to remove them all.
+template <typename T>
+auto dedup(std::vector<T> &input) -> size_t {
+    return dedup_by([](const T &a, const T &b) { return a == b; }, input);
+}
+
+template <typename T, typename Key>
+auto dedup_by_key(Key key, std::vector<T> &input) -> size_t {
+    return dedup_by([&](const T &a, const T &b) { return key(a) == key(b); },
+                    input);
+}
+
+// Removes the elements `pred` returns true for and returns them, in order.
+template <typename T, typename Predicate>
+auto drain_filter(Predicate pred, std::vector<T> &input) -> std::vector<T> {
+    std::vector<T> output = {};
+    retain_mut(
+        [&](auto &&it) {
+            if (!pred(it)) { return true; }
+            output.push_back(std::move(it));
+            return false;
+        },
+        input);
+    return output;
+}
+
+// The elements `pred` returns true for, then the rest, each in order.
+template <typename T, typename Predicate>
+auto partition(Predicate pred, const std::vector<T> &input)
+    -> std::pair<std::vector<T>, std::vector<T>> {
+    std::pair<std::vector<T>, std::vector<T>> output = {};
+    for (const auto &it : input) {
+        if (pred(it)) {
+            output.first.push_back(it);
+        } else {
+            output.second.push_back(it);
+        }
+    }
+    return output;
+}
+
+// Consumes `input`, and the matches stay behind in its buffer.
+template <typename T, typename Predicate>
+auto partition(Predicate pred, std::vector<T> &&input)
+    -> std::pair<std::vector<T>, std::vector<T>> {
+    std::vector<T> rest
+        = drain_filter([&](const auto &it) { return !pred(it); }, input);
+    return {std::move(input), std::move(rest)};
+}
+
+template <typename T, typename U>
+auto find(const U &needle, const std::vector<T> &haystack)
+    -> std::optional<size_t> {
+    for (size_t i = 0; i < haystack.size(); i++) {
+        if (haystack[i] == needle) { return i; }
+    }
+
+    return {};
+}
+
+// Slice overloads, for working on part of a vector, such as one of its
+// `chunks()`, without copying it out first.
+template <typename T>
+auto nth(const size_t index, const Slice<T> input)
+    -> std::optional<std::remove_cv_t<T>> {
+    if (index < input.size()) { return input[index]; }
+    return {};
+}
+
+template <typename Transform, typename T>
+auto flat_map(Transform func, const Slice<T> input) {
+    using U = std::decay_t<decltype(func(input[0]).value())>;
+    std::vector<U> output = {};
+    for (const auto &it : input) {
+        if (auto elem = func(it); elem) { output.push_back(elem.value()); }
+    }
+    return output;
+}
+
+template <typename T, typename U, typename F>
+auto fold(U init, F func, const Slice<T> input) -> U {
+    U acc{init};
+    for (const auto &it : input) {
+        acc = func(acc, it);
+    }
+    return acc;
+}
+
+template <typename T, typename U, typename F>
+auto try_fold(U init, F func, const Slice<T> input) -> U {
+    U acc{init};
+    for (const auto &it : input) {
+        if (auto new_acc = func(acc, it); new_acc) {
+            acc = new_acc;
+        } else {
+            return acc;
+        }
+    }
+    return acc;
+}
+
+template <typename Predicate, typename T>
+auto take_while(Predicate pred, const Slice<T> input)
+    -> std::vector<std::remove_cv_t<T>> {
+    std::vector<std::remove_cv_t<T>> output = {};
+    for (const auto &it : input) {
+        if (!pred(it)) { break; }
+        output.push_back(it);
+    }
+    return output;
+}
+
+template <typename T, typename U>
+auto append(std::vector<T> &dest, const Slice<U> src) {
+    dest.insert(dest.end(), src.begin(), src.end());
+}
+
+template <typename T, typename Transform>
+auto fmap(Transform func, const Slice<T> input)
+    -> std::vector<std::decay_t<std::invoke_result_t<Transform, T &>>> {
+    std::vector<std::decay_t<std::invoke_result_t<Transform, T &>>> output
+        = {};
+    output.reserve(input.size());
+    for (auto &it : input) {
+        output.push_back(func(it));
+    }
+    return output;
+}
+
+template <typename T, typename Predicate>
+auto filter(Predicate pred, const Slice<T> input)
+    -> std::vector<std::remove_cv_t<T>> {
+    std::vector<std::remove_cv_t<T>> output = {};
+    for (const auto &it : input) {
+        if (pred(it)) { output.push_back(it); }
+    }
+    return output;
+}
+
+template <typename T, typename U>
+auto find(const U &needle, const Slice<T> haystack) -> std::optional<size_t> {
+    for (size_t i = 0; i < haystack.size(); i++) {
+        if (haystack[i] == needle) { return i; }
+    }
+    return {};
+}
+
+// SplitView overloads. These walk the tokens lazily, so nothing past the
+// point where the predicate stops (or the index is reached) gets scanned.
+template <typename Predicate>
+auto filter(Predicate pred, const SplitView &input)
+    -> std::vector<std::string_view> {
+    std::vector<std::string_view> output = {};
+    for (const auto &it : input) {
+        if (pred(it)) { output.push_back(it); }
+    }
+    return output;
+}
+
+template <typename Predicate>
+auto take_while(Predicate pred, const SplitView &input)
+    -> std::vector<std::string_view> {
+    std::vector<std::string_view> output = {};
+    for (const auto &it : input) {
+        if (pred(it)) {
+            output.push_back(it);
+        } else {
+            break;
+        }
+    }
+    return output;
+}
+
+inline auto nth(const size_t index, const SplitView &input)
+    -> std::optional<std::string_view> {
+    size_t i = 0;
+    for (const auto &it : input) {
+        if (i++ == index) { return it; }
+    }
+    return {};
+}
+
+auto flag_value(const std::string_view lead_value,
+                const std::vector<std::string> &input)
+    -> std::optional<std::string>;
+
+/// LAZY
+// Lazy counterparts of the vector helpers, in the same subject-last style:
+//
+//     auto output = lazy::collect(
+//                   lazy::take(3,
+//                   lazy::fmap(f,
+//                   lazy::filter(p,
+//                   lines_view(v1)))));
+//
+// Each adaptor only wraps the stage it's given. Nothing runs until a terminal
+// (`collect`, `for_each`, `fold`, `nth`, `count`) drives the chain, and then
+// every stage runs in a single pass that stops as soon as the output is done.
+//
+// A stage pushes its elements into a sink with `run(sink)`, and the sink
+// returns false to stop early. `run()` itself returns false only when the sink
+// stopped it. `size_hint()` is an upper bound on the element count, when one
+// is known without doing the work.
+//
+// Lvalue vectors and SplitViews are borrowed, so they have to outlive the
+// chain. Rvalue vectors are moved into it.
+namespace lazy {
+template <typename T, typename = void>
+struct is_stage : std::false_type {};
+
+template <typename T>
+struct is_stage<T, std::void_t<decltype(T::is_lazy_stage)>> : std::true_type {
+};
+
+template <typename T>
+struct Borrowed {
+    static constexpr bool is_lazy_stage = true;
+    using value_type                    = T;
+
+    auto size_hint() const -> std::optional<size_t> {
+        return this->size;
+    }
+
+    template <typename Sink>
+    auto run(Sink &&sink) -> bool {
+        for (size_t i = 0; i < this->size; i++) {
+            if (!sink(this->data[i])) { return false; }
+        }
+        return true;
+    }
+
+    const T *data;
+    size_t size;
+};
+
+template <typename T>
+struct Owned {
+    static constexpr bool is_lazy_stage = true;
+    using value_type                    = T;
+
+    auto size_hint() const -> std::optional<size_t> {
+        return this->data.size();
+    }
+
+    // The chain owns these, so they're moved down it rather than copied.
+    template <typename Sink>
+    auto run(Sink &&sink) -> bool {
+        for (auto &it : this->data) {
+            if (!sink(std::move(it))) { return false; }
+        }
+        return true;
+    }
+
+    std::vector<T> data;
+};
+
+struct Split {
+    static constexpr bool is_lazy_stage = true;
+    using value_type                    = std::string_view;
+
+    auto size_hint() const -> std::optional<size_t> {
+        return {};
+    }
+
+    template <typename Sink>
+    auto run(Sink &&sink) -> bool {
+        for (const auto &it : this->view) {
+            if (!sink(it)) { return false; }
+        }
+        return true;
+    }
+
+    SplitView view;
+};
+
+template <typename T>
+auto source(const std::vector<T> &input) -> Borrowed<T> {
+    return Borrowed<T>{input.data(), input.size()};
+}
+
+template <typename T>
+auto source(std::vector<T> &&input) -> Owned<T> {
+    return Owned<T>{std::move(input)};
+}
+
+template <typename T>
+auto source(const Slice<T> input) -> Borrowed<std::remove_cv_t<T>> {
+    return Borrowed<std::remove_cv_t<T>>{input.data(), input.size()};
+}
+
+inline auto source(const SplitView &input) -> Split {
+    return Split{input};
+}
+
+template <typename S,
+          typename = std::enable_if_t<is_stage<std::decay_t<S>>::value>>
+auto source(S &&stage) -> std::decay_t<S> {
+    return std::forward<S>(stage);
+}
+
+template <typename Input>
+using stage_t = decltype(source(std::declval<Input>()));
+
+template <typename Src, typename Predicate>
+struct Filter {
+    static constexpr bool is_lazy_stage = true;
+    using value_type                    = typename Src::value_type;
+
+    auto size_hint() const -> std::optional<size_t> {
+        return this->src.size_hint();
+    }
+
+    template <typename Sink>
+    auto run(Sink &&sink) -> bool {
+        return this->src.run([&](auto &&it) {
+            return this->pred(it) ? sink(std::forward<decltype(it)>(it)) : true;
+        });
+    }
+
+    Src src;
+    Predicate pred;
+};
+
+template <typename Src, typename Transform>
+struct Fmap {
+    static constexpr bool is_lazy_stage = true;
+    using value_type                    = std::decay_t<
+        std::invoke_result_t<Transform &, typename Src::value_type &&>>;
+
+    auto size_hint() const -> std::optional<size_t> {
+        return this->src.size_hint();
+    }
+
+    template <typename Sink>
+    auto run(Sink &&sink) -> bool {
+        return this->src.run([&](auto &&it) {
+            return sink(this->func(std::forward<decltype(it)>(it)));
+        });
+    }
+
+    Src src;
+    Transform func;
+};
+
+template <typename Src, typename Predicate>
+struct TakeWhile {
+    static constexpr bool is_lazy_stage = true;
+    using value_type                    = typename Src::value_type;
+
+    auto size_hint() const -> std::optional<size_t> {
+        return this->src.size_hint();
+    }
+
+    template <typename Sink>
+    auto run(Sink &&sink) -> bool {
+        bool stopped = false;
+        this->src.run([&](auto &&it) {
+            if (!this->pred(it)) { return false; }
+            stopped = !sink(std::forward<decltype(it)>(it));
+            return !stopped;
+        });
+        return !stopped;
+    }
+
+    Src src;
+    Predicate pred;
+};
+
+template <typename Src>
+struct Take {
+    static constexpr bool is_lazy_stage = true;
+    using value_type                    = typename Src::value_type;
+
+    auto size_hint() const -> std::optional<size_t> {
+        auto hint = this->src.size_hint();
+        return (hint and hint.value() < this->count) ? hint.value()
+                                                     : this->count;
+    }
+
+    template <typename Sink>
+    auto run(Sink &&sink) -> bool {
+        if (this->count == 0) { return true; }
+        size_t remaining = this->count;
+        bool stopped     = false;
+        this->src.run([&](auto &&it) {
+            stopped = !sink(std::forward<decltype(it)>(it));
+            return !stopped and --remaining > 0;
+        });
+        return !stopped;
+    }
+
+    Src src;
+    size_t count;
+};
+
+// Unwraps `std::optional`s, dropping the empty ones, or concatenates vectors.
+template <typename Src>
+struct Flatten {
+    static constexpr bool is_lazy_stage = true;
+    using inner_type                    = typename Src::value_type;
+    using value_type                    = typename inner_type::value_type;
+
+    auto size_hint() const -> std::optional<size_t> {
+        if constexpr (std::is_same_v<inner_type, std::optional<value_type>>) {
+            return this->src.size_hint();
+        } else {
+            return {};
+        }
+    }
+
+    template <typename Sink>
+    auto run(Sink &&sink) -> bool {
+        return this->src.run([&](auto &&it) {
+            constexpr bool owned = !std::is_lvalue_reference_v<decltype(it)>;
+            if constexpr (std::is_same_v<inner_type,
+                                         std::optional<value_type>>) {
+                if (!it) { return true; }
+                if constexpr (owned) {
+                    return sink(std::move(*it));
+                } else {
+                    return sink(*it);
+                }
+            } else {
+                for (auto &elem : it) {
+                    if constexpr (owned) {
+                        if (!sink(std::move(elem))) { return false; }
+                    } else {
+                        if (!sink(elem)) { return false; }
+                    }
+                }
+                return true;
+            }
+        });
+    }
+
+    Src src;
+};
+
+template <typename Predicate, typename Input>
+auto filter(Predicate pred, Input &&input) {
+    return Filter<stage_t<Input>, Predicate>{
+        source(std::forward<Input>(input)), pred};
+}
+
+template <typename Transform, typename Input>
+auto fmap(Transform func, Input &&input) {
+    return Fmap<stage_t<Input>, Transform>{source(std::forward<Input>(input)),
+                                           func};
+}
+
+template <typename Predicate, typename Input>
+auto take_while(Predicate pred, Input &&input) {
+    return TakeWhile<stage_t<Input>, Predicate>{
+        source(std::forward<Input>(input)), pred};
+}
+
+template <typename Input>
+auto take(const size_t count, Input &&input) {
+    return Take<stage_t<Input>>{source(std::forward<Input>(input)), count};
+}
+
+template <typename Input>
+auto flatten(Input &&input) {
+    return Flatten<stage_t<Input>>{source(std::forward<Input>(input))};
+}
+
+// Like the eager `flat_map`, `func` returns a `std::optional`, and only the
+// values that are present come out.
+template <typename Transform, typename Input>
+auto flat_map(Transform func, Input &&input) {
+    return flatten(fmap(func, std::forward<Input>(input)));
+}
+
+// Reserves once, from `size_hint()`, when the chain can give one.
+template <typename Input>
+auto collect(Input &&input)
+    -> std::vector<typename stage_t<Input>::value_type> {
+    auto stage = source(std::forward<Input>(input));
+    std::vector<typename stage_t<Input>::value_type> output = {};
+    if (auto hint = stage.size_hint(); hint) { output.reserve(hint.value()); }
+    stage.run([&](auto &&it) {
+        output.push_back(std::forward<decltype(it)>(it));
+        return true;
+    });
+    return output;
+}
+
+template <typename F, typename Input>
+auto for_each(F func, Input &&input) -> void {
+    source(std::forward<Input>(input)).run([&](auto &&it) {
+        func(std::forward<decltype(it)>(it));
+        return true;
+    });
+}
+
+/// F is f(acc, elem) -> new_acc.
+template <typename U, typename F, typename Input>
+auto fold(U init, F func, Input &&input) -> U {
+    U acc{init};
+    source(std::forward<Input>(input)).run([&](auto &&it) {
+        acc = func(acc, std::forward<decltype(it)>(it));
+        return true;
+    });
+    return acc;
+}
+
+template <typename Input>
+auto nth(const size_t index, Input &&input)
+    -> std::optional<typename stage_t<Input>::value_type> {
+    std::optional<typename stage_t<Input>::value_type> output = {};
+    size_t i                                                  = 0;
+    source(std::forward<Input>(input)).run([&](auto &&it) {
+        if (i++ < index) { return true; }
+        output = std::forward<decltype(it)>(it);
+        return false;
+    });
+    return output;
+}
+
+template <typename Input>
+auto count(Input &&input) -> size_t {
+    size_t output = 0;
+    source(std::forward<Input>(input)).run([&](auto &&) {
+        output++;
+        return true;
+    });
+    return output;
+}
+} // namespace lazy
+
+/// HASH
+// Hashes like std::hash, except that anything that converts to a
+// std::string_view hashes as one, so a table keyed by std::string can be
+// searched with a string_view or a literal without building a string.
+struct KHash {
+    using is_transparent = void;
+
+    template <typename K>
+    auto operator()(const K &key) const -> size_t {
+        if constexpr (std::is_convertible_v<const K &, std::string_view>) {
+            return std::hash<std::string_view>{}(key);
+        } else {
+            return std::hash<K>{}(key);
+        }
+    }
+};
+
+struct KEqual {
+    using is_transparent = void;
+
+    template <typename A, typename B>
+    auto operator()(const A &lhs, const B &rhs) const -> bool {
+        return lhs == rhs;
+    }
+};
+
+// The open-addressing table behind HashMap and HashSet, laid out like a Swiss
+// table. Every slot has a control byte that says it's empty, deleted, or full
+// and holds 7 bits of its key's hash, and the bytes sit in one array apart
+// from the slots. A probe loads 16 control bytes at once and compares them
+// all with the hash bits in a couple of SSE2 instructions, so the slots
+// themselves are only read for likely matches, and a miss usually costs one
+// group. `Slot` is the key itself, or a pair of the key and its value.
+template <typename K, typename Slot, typename Hash, typename Eq>
+struct HashTable {
+    static constexpr size_t GROUP = 16;
+    static constexpr i8 EMPTY     = -128;
+    static constexpr i8 DELETED   = -2;
+
+    // Lookups with another key type only go through `Hash` and `Eq` when
+    // both are strings and `Hash` says it can; anything else is converted to
+    // `K` first, so the hash is always the one `K` was inserted with.
+    template <typename Q>
+    static constexpr bool transparent
+        = std::is_same_v<std::decay_t<Q>, K>
+       or (std::is_convertible_v<const Q &, std::string_view>
+           and std::is_convertible_v<const K &, std::string_view>
+           and std::is_same_v<Hash, KHash>);
+
+    HashTable() = default;
+    HashTable(const HashTable &other) : hash(other.hash), eq(other.eq) {
+        if (other.cap == 0) { return; }
+        this->allocate(other.cap);
+        // Same capacity and hash, so every slot can stay where it is. The
+        // tombstones come along too: a key placed past a group that was full
+        // at the time is only reachable while that group has no empty slot.
+        for (size_t i = 0; i < other.cap; i++) {
+            if (other.ctrl[i] == DELETED) { this->ctrl[i] = DELETED; }
+            if (other.ctrl[i] < 0) { continue; }
+            new (&this->slots[i]) Slot(other.slots[i]);
+            this->ctrl[i] = other.ctrl[i];
+            this->len++;
+        }
+        this->growth_left = other.growth_left;
+    }
+    HashTable(HashTable &&other) noexcept {
+        this->swap(other);
+    }
+    auto operator=(HashTable other) -> HashTable & {
+        this->swap(other);
+        return *this;
+    }
+    ~HashTable() {
+        this->destroy();
+    }
+
+    auto swap(HashTable &other) noexcept -> void {
+        std::swap(this->ctrl, other.ctrl);
+        std::swap(this->slots, other.slots);
+        std::swap(this->cap, other.cap);
+        std::swap(this->len, other.len);
+        std::swap(this->growth_left, other.growth_left);
+        std::swap(this->hash, other.hash);
+        std::swap(this->eq, other.eq);
+    }
+
+    static auto key_of(const Slot &slot) -> const K & {
+        if constexpr (std::is_same_v<Slot, K>) {
+            return slot;
+        } else {
+            return slot.first;
+        }
+    }
+
+    // Bit i is set where group[i] == byte.
+    static auto match(const i8 *group, const i8 byte) -> u32 {
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128i ctrl
+            = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<u32>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte))));
+#else
+        u32 mask = 0;
+        for (size_t i = 0; i < GROUP; i++) {
+            if (group[i] == byte) { mask |= u32{1} << i; }
+        }
+        return mask;
+#endif
+    }
+
+    // Bit i is set where group[i] is empty or deleted, which are the
+    // negative control bytes.
+    static auto match_free(const i8 *group) -> u32 {
+#if defined(__SSE2__) || defined(_M_X64)
+        return static_cast<u32>(_mm_movemask_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(group))));
+#else
+        u32 mask = 0;
+        for (size_t i = 0; i < GROUP; i++) {
+            if (group[i] < 0) { mask |= u32{1} << i; }
+        }
+        return mask;
+#endif
+    }
+
+    static auto first_bit(const u32 mask) -> size_t {
+#if defined(__GNUC__)
+        return static_cast<size_t>(__builtin_ctz(mask));
+#else
+        size_t i = 0;
+        while (!(mask & (u32{1} << i))) {
+            i++;
+        }
+        return i;
+#endif
+    }
+
+    // std::hash is the identity for integers on some standard libraries,
+    // which would leave the low 7 bits to pick the group as well as the
+    // control byte. Mixing spreads every input bit over the whole hash.
+    template <typename Q>
+    auto hash_of(const Q &key) const -> size_t {
+        u64 x = static_cast<u64>(this->hash(key));
+        x ^= x >> 32;
+        x *= 0xd6e8feb86659fd93u;
+        x ^= x >> 32;
+        return static_cast<size_t>(x);
+    }
+
+    // The slot holding `key`, or `cap` if there isn't one. The control byte
+    // is the low 7 bits of the hash and the groups are picked by the rest.
+    template <typename Q>
+    auto find_index(const Q &key, const size_t h) const -> size_t {
+        if (this->len == 0) { return this->cap; }
+        const size_t mask = this->cap / GROUP - 1;
+        const i8 h2       = static_cast<i8>(h & 0x7f);
+        size_t group      = (h >> 7) & mask;
+        // Triangular steps visit every group when there's a power of two of
+        // them, and the load limit guarantees one has an empty slot.
+        for (size_t step = 1;; step++) {
+            const i8 *ctrl = this->ctrl.get() + group * GROUP;
+            for (u32 m = match(ctrl, h2); m != 0; m &= m - 1) {
+                const size_t i = group * GROUP + first_bit(m);
+                if (this->eq(key_of(this->slots[i]), key)) { return i; }
+            }
+            if (match(ctrl, EMPTY) != 0) { return this->cap; }
+            group = (group + step) & mask;
+        }
+    }
+
+    auto find_free(const size_t h) const -> size_t {
+        const size_t mask = this->cap / GROUP - 1;
+        size_t group      = (h >> 7) & mask;
+        for (size_t step = 1;; step++) {
+            const u32 m = match_free(this->ctrl.get() + group * GROUP);
+            if (m != 0) { return group * GROUP + first_bit(m); }
+            group = (group + step) & mask;
+        }
+    }
+
+    template <typename Q>
+    auto find(const Q &key) const -> size_t {
+        if constexpr (transparent<Q>) {
+            return this->find_index(key, this->hash_of(key));
+        } else {
+            const K converted(key);
+            return this->find_index(converted, this->hash_of(converted));
+        }
+    }
+
+    // The slot holding `key`, and true if `make()` was called to fill it
+    // because there wasn't one.
+    template <typename Q, typename Make>
+    auto find_or_insert(const Q &key, Make make) -> std::pair<size_t, bool> {
+        if constexpr (!transparent<Q>) {
+            return this->find_or_insert(K(key), make);
+        } else {
+            const size_t h     = this->hash_of(key);
+            const size_t found = this->find_index(key, h);
+            if (found != this->cap) { return {found, false}; }
+
+            if (this->growth_left == 0) {
+                size_t capacity = this->cap * 2;
+                if (this->cap == 0) {
+                    capacity = GROUP;
+                } else if (this->len * 2 <= this->cap / 8 * 7) {
+                    // Mostly tombstones, so clearing them out makes room.
+                    capacity = this->cap;
+                }
+                this->rehash(capacity);
+            }
+            const size_t i = this->find_free(h);
+            new (&this->slots[i]) Slot(make());
+            if (this->ctrl[i] == EMPTY) { this->growth_left--; }
+            this->ctrl[i] = static_cast<i8>(h & 0x7f);
+            this->len++;
+            return {i, true};
+        }
+    }
+
+    auto erase_at(const size_t i) -> void {
+        this->slots[i].~Slot();
+        this->len--;
+        // A probe only moves past a group that had no empty slot, so if this
+        // group still has one, nothing was placed beyond it on account of
+        // this slot, and it can go back to empty instead of becoming a
+        // tombstone.
+        const i8 *group = this->ctrl.get() + i / GROUP * GROUP;
+        if (match(group, EMPTY) != 0) {
+            this->ctrl[i] = EMPTY;
+            this->growth_left++;
+        } else {
+            this->ctrl[i] = DELETED;
+        }
+    }
+
+    auto allocate(const size_t capacity) -> void {
+        this->ctrl.reset(new i8[capacity]);
+        for (size_t i = 0; i < capacity; i++) {
+            this->ctrl[i] = EMPTY;
+        }
+        this->slots       = std::allocator<Slot>{}.allocate(capacity);
+        this->cap         = capacity;
+        this->len         = 0;
+        this->growth_left = capacity / 8 * 7;
+    }
+
+    auto rehash(const size_t capacity) -> void {
+        HashTable old{};
+        old.swap(*this);
+        this->hash = old.hash;
+        this->eq   = old.eq;
+        this->allocate(capacity);
+        for (size_t i = 0; i < old.cap; i++) {
+            if (old.ctrl[i] < 0) { continue; }
+            const size_t h = this->hash_of(key_of(old.slots[i]));
+            const size_t j = this->find_free(h);
+            new (&this->slots[j]) Slot(std::move(old.slots[i]));
+            this->ctrl[j] = static_cast<i8>(h & 0x7f);
+            this->len++;
+            this->growth_left--;
+        }
+    }
+
+    // Enough room for `count` entries without another rehash.
+    auto reserve(const size_t count) -> void {
+        if (count <= this->len + this->growth_left) { return; }
+        size_t capacity = this->cap == 0 ? GROUP : this->cap;
+        while (capacity / 8 * 7 < count) {
+            capacity *= 2;
+        }
+        this->rehash(capacity);
+    }
+
+    auto clear() -> void {
+        for (size_t i = 0; i < this->cap; i++) {
+            if (this->ctrl[i] >= 0) { this->slots[i].~Slot(); }
+            this->ctrl[i] = EMPTY;
+        }
+        this->len         = 0;
+        this->growth_left = this->cap / 8 * 7;
+    }
+
+    auto destroy() -> void {
+        if (this->cap == 0) { return; }
+        this->clear();
+        std::allocator<Slot>{}.deallocate(this->slots, this->cap);
+        this->ctrl.reset();
+        this->slots       = nullptr;
+        this->cap         = 0;
+        this->growth_left = 0;
+    }
+
+    auto next_full(size_t i) const -> size_t {
+        while (i < this->cap and this->ctrl[i] < 0) {
+            i++;
+        }
+        return i;
+    }
+
+    template <typename T>
+    struct Iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::remove_const_t<T>;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = T *;
+        using reference         = T &;
+
+        auto operator*() const -> T & {
+            return this->table->slots[this->index];
+        }
+        auto operator->() const -> T * {
+            return &this->table->slots[this->index];
+        }
+        auto operator++() -> Iterator & {
+            this->index = this->table->next_full(this->index + 1);
+            return *this;
+        }
+        auto operator==(const Iterator &rhs) const -> bool {
+            return this->index == rhs.index;
+        }
+        auto operator!=(const Iterator &rhs) const -> bool {
+            return this->index != rhs.index;
+        }
+
+        const HashTable *table;
+        size_t index;
+    };
+
+    UPtr<i8[]> ctrl    = nullptr;
+    Slot *slots        = nullptr;
+    size_t cap         = 0;
+    size_t len         = 0;
+    size_t growth_left = 0;
+    Hash hash          = {};
+    Eq eq              = {};
+};
 
-    std::ostringstream oss;
-    if (auto it = find("{}", fmt_string); it) {
-        oss << fmt_string.substr(0, it.value());
-        oss << input;
-        oss << ((it.value() + 2 < fmt_string.size())
-                    ? fmt_string.substr(it.value() + 2)
-                    : "");
+// A hash map with open addressing, for when `std::unordered_map`'s node per
+// entry and pointer chase per lookup are too slow. Lookups with a key of
+// another type, such as a string_view into a map keyed by std::string,
+// don't build a key. Inserting or erasing invalidates iterators and pointers
+// to values. Iteration is in no particular order, over pairs whose keys
+// mustn't be changed.
+template <typename K, typename V, typename Hash = KHash, typename Eq = KEqual>
+struct HashMap {
+    using value_type = std::pair<K, V>;
+    using Table      = HashTable<K, value_type, Hash, Eq>;
+    using iterator   = typename Table::template Iterator<value_type>;
+    using const_iterator =
+        typename Table::template Iterator<const value_type>;
+
+    HashMap() = default;
+    HashMap(std::initializer_list<value_type> items) {
+        this->reserve(items.size());
+        for (const auto &it : items) {
+            this->insert_or_assign(it.first, it.second);
+        }
     }
-    return oss.str();
-}
 
-template <typename T, typename... Args>
-auto format(const std::string_view fmt_string, T first, Args... rest)
-    -> std::string {
-    std::string processed = format(fmt_string, first);
+    auto size() const -> size_t { return this->table.len; }
+    auto empty() const -> bool { return this->table.len == 0; }
+    auto reserve(const size_t count) -> void { this->table.reserve(count); }
+    auto clear() -> void { this->table.clear(); }
 
-    return format(processed, rest...);
-}
+    // The value for `key`, or nullptr if it isn't there.
+    template <typename Q>
+    auto find(const Q &key) -> V * {
+        const size_t i = this->table.find(key);
+        return i == this->table.cap ? nullptr : &this->table.slots[i].second;
+    }
+    template <typename Q>
+    auto find(const Q &key) const -> const V * {
+        const size_t i = this->table.find(key);
+        return i == this->table.cap ? nullptr : &this->table.slots[i].second;
+    }
+    template <typename Q>
+    auto contains(const Q &key) const -> bool {
+        return this->table.find(key) != this->table.cap;
+    }
 
-/// SLICE
-template <typename T>
-struct Slice {
-    size_t start_idx;
-    size_t end_idx;
-    const std::vector<T> &data;
+    // Builds the key and value from `key` and `args` only if `key` isn't
+    // there yet. Returns the value, and whether it was inserted.
+    template <typename Q, typename... Args>
+    auto try_emplace(Q &&key, Args &&...args) -> std::pair<V *, bool> {
+        auto [i, inserted] = this->table.find_or_insert(key, [&] {
+            return value_type{std::piecewise_construct,
+                              std::forward_as_tuple(std::forward<Q>(key)),
+                              std::forward_as_tuple(
+                                  std::forward<Args>(args)...)};
+        });
+        return {&this->table.slots[i].second, inserted};
+    }
 
-    auto to_vec() -> std::vector<T> {
-        std::vector<T> output;
-        for (size_t i = this->start_idx; i < this->end_idx; i++) {
-            output.push_back(this->data[i]);
-        }
-        return output;
+    template <typename Q>
+    auto operator[](Q &&key) -> V & {
+        return *this->try_emplace(std::forward<Q>(key)).first;
     }
 
-    auto size() -> size_t {
-        return this->end_idx - this->start_idx;
+    // Leaves an existing value alone. Returns whether `value` went in.
+    auto insert(K key, V value) -> bool {
+        return this->try_emplace(std::move(key), std::move(value)).second;
     }
 
-    auto begin() {
-        return data.begin() + this->start_idx;
+    // Returns whether `key` is new.
+    auto insert_or_assign(K key, V value) -> bool {
+        auto [i, inserted] = this->table.find_or_insert(key, [&] {
+            return value_type{std::move(key), std::move(value)};
+        });
+        if (!inserted) { this->table.slots[i].second = std::move(value); }
+        return inserted;
     }
 
-    auto end() {
-        return data.begin() + this->end_idx;
+    template <typename Q>
+    auto erase(const Q &key) -> bool {
+        const size_t i = this->table.find(key);
+        if (i == this->table.cap) { return false; }
+        this->table.erase_at(i);
+        return true;
     }
 
-    bool operator==(const Slice<T> &rhs) {
-        return this->start_idx == rhs.start_idx and this->end_idx == rhs.end_idx
-            and &this->data == &rhs.data;
-    };
+    auto begin() -> iterator {
+        return {&this->table, this->table.next_full(0)};
+    }
+    auto end() -> iterator { return {&this->table, this->table.cap}; }
+    auto begin() const -> const_iterator {
+        return {&this->table, this->table.next_full(0)};
+    }
+    auto end() const -> const_iterator {
+        return {&this->table, this->table.cap};
+    }
 
-    bool operator!=(const Slice<T> &rhs) {
-        return !(*this == rhs);
-    };
+  private:
+    Table table;
 };
 
-template <typename T>
-std::ostream &operator<<(std::ostream &os, const Slice<T> &rhs) {
-    os << "Slice { .start_idx  = " << rhs.start_idx
-       << ", .end_idx = " << rhs.end_idx << ", .data = " << &rhs.data << " }";
-    return os;
-};
+// The same table as HashMap, holding only keys.
+template <typename K, typename Hash = KHash, typename Eq = KEqual>
+struct HashSet {
+    using value_type     = K;
+    using Table          = HashTable<K, K, Hash, Eq>;
+    using const_iterator = typename Table::template Iterator<const K>;
+    using iterator       = const_iterator;
+
+    HashSet() = default;
+    HashSet(std::initializer_list<K> items) {
+        this->reserve(items.size());
+        for (const auto &it : items) {
+            this->insert(it);
+        }
+    }
 
-/// VECTOR
-template <typename T>
-auto nth(const size_t index, const std::vector<T> &input) -> std::optional<T> {
-    if (index < input.size()) { return std::make_optional(input[index]); }
-    return {};
-}
+    auto size() const -> size_t { return this->table.len; }
+    auto empty() const -> bool { return this->table.len == 0; }
+    auto reserve(const size_t count) -> void { this->table.reserve(count); }
+    auto clear() -> void { this->table.clear(); }
 
-template <typename Transform, typename T, typename U>
-auto flat_map(Transform func, std::vector<T> input) -> std::vector<U> {
-    std::vector<U> output = {};
-    for (const auto &it : input) {
-        if (auto elem = func(it); elem) { output.push_back(elem.value()); }
+    template <typename Q>
+    auto contains(const Q &key) const -> bool {
+        return this->table.find(key) != this->table.cap;
     }
-    return output;
-}
 
-/// F is f(acc, elem) -> new_acc.
-template <typename T, typename U, typename F>
-auto fold(U init, F func, std::vector<T> input) -> U {
-    U acc{init};
-    for (const auto &it : input) {
-        acc = func(acc, it);
+    // Only builds a `K` from `key` if it isn't there yet. Returns whether it
+    // was inserted.
+    template <typename Q>
+    auto insert(Q &&key) -> bool {
+        return this->table
+            .find_or_insert(key, [&] { return K(std::forward<Q>(key)); })
+            .second;
     }
-    return acc;
-}
 
-/// F is f(acc, elem) -> <Some type that converts to bool>.
-template <typename T, typename U, typename F>
-auto try_fold(U init, F func, std::vector<T> input) -> U {
-    U acc{init};
-    for (const auto &it : input) {
-        if (auto new_acc = func(acc, it); new_acc) {
-            acc = new_acc;
-        } else {
-            return acc;
-        }
+    template <typename Q>
+    auto erase(const Q &key) -> bool {
+        const size_t i = this->table.find(key);
+        if (i == this->table.cap) { return false; }
+        this->table.erase_at(i);
+        return true;
     }
-    return acc;
-}
 
-template <typename T>
-auto slice(size_t start, size_t end, const std::vector<T> &input)
-    -> std::optional<Slice<T>> {
-    if (end < start or start >= input.size()) { return {}; }
-    return Slice<T>{start, end, input};
-}
+    auto begin() const -> const_iterator {
+        return {&this->table, this->table.next_full(0)};
+    }
+    auto end() const -> const_iterator {
+        return {&this->table, this->table.cap};
+    }
 
-template <typename T>
-auto slice(size_t start, const std::vector<T> input)
-    -> std::optional<Slice<T>> {
-    return slice(start, input.size(), input);
-}
+  private:
+    Table table;
+};
 
-template <typename Predicate, typename T>
-auto take_while(Predicate pred, const std::vector<T> &input) -> std::vector<T> {
-    std::vector<T> output = {};
-    for (const auto &it : input) {
-        if (pred(it)) {
-            output.push_back(it);
-        } else {
-            break;
-        }
+template <typename K, typename V, typename Hash, typename Eq>
+auto operator==(const HashMap<K, V, Hash, Eq> &lhs,
+                const HashMap<K, V, Hash, Eq> &rhs) -> bool {
+    if (lhs.size() != rhs.size()) { return false; }
+    for (const auto &it : lhs) {
+        const V *value = rhs.find(it.first);
+        if (value == nullptr or !(*value == it.second)) { return false; }
     }
-
-    return output;
+    return true;
 }
 
-// `destination` is being extended by `source`.
-template <typename T, typename U>
-auto append(std::vector<T> &dest, const std::vector<U> &src) {
-    dest.reserve(dest.size() + src.size());
-    dest.insert(dest.end(), src.begin(), src.end());
+template <typename K, typename V, typename Hash, typename Eq>
+auto operator!=(const HashMap<K, V, Hash, Eq> &lhs,
+                const HashMap<K, V, Hash, Eq> &rhs) -> bool {
+    return !(lhs == rhs);
 }
 
-// Takes two vectors and returns them concatenated.
-// While it can take two types, the output type is determined by the type of the
-// first vector.
-template <typename T, typename U>
-auto concat(const std::vector<T> &first, const std::vector<U> &second)
-    -> std::vector<T> {
-    std::vector<T> output(first.size() + second.size());
-    for (size_t i = 0; i < first.size(); i++) {
-        output.push_back(first[i]);
+template <typename K, typename Hash, typename Eq>
+auto operator==(const HashSet<K, Hash, Eq> &lhs,
+                const HashSet<K, Hash, Eq> &rhs) -> bool {
+    if (lhs.size() != rhs.size()) { return false; }
+    for (const auto &it : lhs) {
+        if (!rhs.contains(it)) { return false; }
     }
-    for (size_t i = 0; i < second.size(); i++) {
-        output.push_back(second[i]);
-    }
-    return output;
+    return true;
+}
+
+template <typename K, typename Hash, typename Eq>
+auto operator!=(const HashSet<K, Hash, Eq> &lhs,
+                const HashSet<K, Hash, Eq> &rhs) -> bool {
+    return !(lhs == rhs);
 }
 
+// The helpers below replace a `find()` per element, which makes a loop over
+// one vector searching another O(n * m), with one pass to build a table and
+// one to probe it.
+
+// Each distinct element once, in the order they first appear.
 template <typename T>
-auto flatten(const std::vector<std::optional<T>> &input) -> std::vector<T> {
+auto unique(const std::vector<T> &input) -> std::vector<T> {
+    HashSet<T> seen       = {};
     std::vector<T> output = {};
-    for (size_t i = 0; i < input.size(); i++) {
-        if (input[i]) { output.push_back(input[i].value()); }
+    seen.reserve(input.size());
+    for (const auto &it : input) {
+        if (seen.insert(it)) { output.push_back(it); }
     }
     return output;
 }
 
+// How many times each distinct element appears.
 template <typename T>
-auto flatten(const std::vector<std::vector<T>> &input) -> std::vector<T> {
-    std::vector<T> output = {};
+auto counts(const std::vector<T> &input) -> HashMap<T, size_t> {
+    HashMap<T, size_t> output = {};
     for (const auto &it : input) {
-        for (const auto &elem : it) {
-            output.push_back(elem);
-        }
+        output[it]++;
     }
     return output;
 }
 
-template <typename T, typename U, typename Transform>
-auto fmap(Transform func, const std::vector<T> &input) -> std::vector<U> {
-    std::vector<T> output = {};
+// The elements with each key, in their input order. Key is key(elem) -> K.
+template <typename T, typename Key,
+          typename K = std::decay_t<std::invoke_result_t<Key, const T &>>>
+auto group_by(Key key, const std::vector<T> &input)
+    -> HashMap<K, std::vector<T>> {
+    HashMap<K, std::vector<T>> output = {};
     for (const auto &it : input) {
-        output.push_back(func(it));
+        output[key(it)].push_back(it);
     }
     return output;
 }
 
-template <typename T, typename Predicate>
-auto filter(Predicate pred, const std::vector<T> &input) -> std::vector<T> {
-    std::vector<T> output = {};
+// Each element by its key. When several share a key, the last one is kept.
+template <typename T, typename Key,
+          typename K = std::decay_t<std::invoke_result_t<Key, const T &>>>
+auto index_by(Key key, const std::vector<T> &input) -> HashMap<K, T> {
+    HashMap<K, T> output = {};
+    output.reserve(input.size());
     for (const auto &it : input) {
-        if (pred(it)) { output.push_back(it); }
+        output.insert_or_assign(key(it), it);
     }
     return output;
 }
 
-template <typename T, typename Predicate>
-auto retain(Predicate pred, std::vector<T> &input) -> std::vector<T> {
-    std::vector<size_t> remove_indices = {};
-    for (size_t i = 0; i < input.size(); i++) {
-        if (!pred(input[i])) { remove_indices.push_back(i); }
+// The elements of `input` that are also in `other`, in order and with any
+// repeats in `input` kept, like a `filter()`.
+template <typename T, typename U>
+auto intersection(const std::vector<U> &other, const std::vector<T> &input)
+    -> std::vector<T> {
+    HashSet<U> lookup = {};
+    lookup.reserve(other.size());
+    for (const auto &it : other) {
+        lookup.insert(it);
     }
-
-    for (size_t i = 0; i < remove_indices.size(); i++) {
-        input.erase(remove_indices[remove_indices.size() - 1 - i]);
+    std::vector<T> output = {};
+    for (const auto &it : input) {
+        if (lookup.contains(it)) { output.push_back(it); }
     }
+    return output;
 }
 
+// The elements of `input` that aren't in `other`, in order.
 template <typename T, typename U>
-auto find(const U &needle, const std::vector<T> &haystack)
-    -> std::optional<size_t> {
-    for (size_t i = 0; i < haystack.size(); i++) {
-        if (haystack[i] == needle) { return i; }
+auto difference(const std::vector<U> &other, const std::vector<T> &input)
+    -> std::vector<T> {
+    HashSet<U> lookup = {};
+    lookup.reserve(other.size());
+    for (const auto &it : other) {
+        lookup.insert(it);
     }
-
-    return {};
+    std::vector<T> output = {};
+    for (const auto &it : input) {
+        if (!lookup.contains(it)) { output.push_back(it); }
+    }
+    return output;
 }
 
-auto flag_value(const std::string_view lead_value,
-                const std::vector<std::string> &input)
-    -> std::optional<std::string>;
-
 /// OPTIONAL
 struct ExpectedOptionalValue : public std::exception {
     explicit ExpectedOptionalValue(const char *input) : value_(input) {
@@ -662,8 +2989,50 @@ auto operator<<(std::ostream &os, const std::optional<T> &rhs)
     return os;
 }
 
+// True when `os` would print a number exactly like `to_chars` does: decimal,
+// no width, and floats at the default `%g` precision.
+auto is_plain_number_stream(const std::ostream &os) -> bool;
+
+// Writes "Vec { a, b }" through a stack buffer rather than one stream
+// insertion per element.
+template <typename T>
+auto write_number_vec(std::ostream &os, const T *data, const size_t size)
+    -> void {
+    char buffer[4096];
+    char *const end = buffer + sizeof(buffer);
+    char *pos       = buffer;
+    os.write("Vec { ", 6);
+    for (size_t i = 0; i < size; i++) {
+        if (end - pos < 64) {
+            os.write(buffer, pos - buffer);
+            pos = buffer;
+        }
+        if (i != 0) {
+            *pos++ = ',';
+            *pos++ = ' ';
+        }
+        if constexpr (std::is_floating_point_v<T>) {
+            pos = to_chars(pos, end, data[i], 'g', 6).ptr;
+        } else {
+            pos = to_chars(pos, end, data[i]).ptr;
+        }
+    }
+    os.write(buffer, pos - buffer);
+    os.write(" }", 2);
+}
+
 template <typename T>
 auto operator<<(std::ostream &os, const std::vector<T> &rhs) -> std::ostream & {
+    using D = std::decay_t<T>;
+    // Char-sized and bool elements print as characters and words, not digits.
+    constexpr bool is_number = (std::is_integral_v<D> and sizeof(D) > 1)
+                            or std::is_same_v<D, f32> or std::is_same_v<D, f64>;
+    if constexpr (is_number) {
+        if (is_plain_number_stream(os)) {
+            write_number_vec(os, rhs.data(), rhs.size());
+            return os;
+        }
+    }
     os << "Vec { ";
     for (size_t i = 0; i < rhs.size(); i++) {
         os << rhs[i];
@@ -673,6 +3042,34 @@ auto operator<<(std::ostream &os, const std::vector<T> &rhs) -> std::ostream & {
     return os;
 }
 
+template <typename K, typename V, typename Hash, typename Eq>
+auto operator<<(std::ostream &os, const HashMap<K, V, Hash, Eq> &rhs)
+    -> std::ostream & {
+    os << "HashMap { ";
+    bool first = true;
+    for (const auto &it : rhs) {
+        if (!first) { os << ", "; }
+        os << it.first << ": " << it.second;
+        first = false;
+    }
+    os << " }";
+    return os;
+}
+
+template <typename K, typename Hash, typename Eq>
+auto operator<<(std::ostream &os, const HashSet<K, Hash, Eq> &rhs)
+    -> std::ostream & {
+    os << "HashSet { ";
+    bool first = true;
+    for (const auto &it : rhs) {
+        if (!first) { os << ", "; }
+        os << it;
+        first = false;
+    }
+    os << " }";
+    return os;
+}
+
 template <typename T>
 auto to_string(const std::optional<T> &input) -> std::string {
     std::ostringstream os;
@@ -719,22 +3116,111 @@ auto to_string(const std::set<T> &input) -> std::string {
     return oss.str();
 }
 
+// Sync writes and flushes each line through std::cout / std::cerr before
+// returning, as a plain `std::cout << x << std::endl` would. Async (the
+// default) appends whole stdout lines to a per-thread buffer that a
+// background writer drains, so lines from different threads never
+// interleave and no line pays for a flush. Async output goes straight to
+// file descriptor 1, past std::cout's own buffer, so call `flush_output()`
+// when switching between the two. stderr lines are never buffered; each
+// goes out with a single write().
+enum class PrintMode { Sync, Async };
+
+auto operator<<(std::ostream &os, const PrintMode &rhs) -> std::ostream &;
+
+// Switching modes flushes everything printed so far first.
+auto set_print_mode(const PrintMode mode) -> void;
+auto print_mode() -> PrintMode;
+// Blocks until every line printed before the call, from any thread, has been
+// written, and flushes std::cout and std::cerr. It's the ordering point with
+// std::cout: whatever either printed before it comes out before anything
+// printed after. Also runs at exit.
+auto flush_output() -> void;
+// Opt-in: a best-effort flush of buffered lines on SIGSEGV, SIGBUS, SIGILL,
+// SIGFPE and SIGABRT, before the previous handler runs.
+auto flush_output_on_crash() -> void;
+// Opt-in: buffered lines are written before a fork(), so the child never
+// repeats them, and a child that prints gets a writer of its own.
+auto flush_output_on_fork() -> void;
+// Hands one finished line, newline included, to stdout (fd 1) or stderr
+// (fd 2).
+auto print_line(const int fd, const std::string_view line) -> void;
+
 auto println() -> void;
 auto eprintln() -> void;
 
+// The calling thread's scratch buffer for println, so a log line costs no
+// allocation once it has warmed up.
+auto println_buffer() -> std::string &;
+
+// Formats one line into the scratch buffer and hands it to the sink. The
+// buffer is moved out rather than borrowed, in case an argument's operator<<
+// prints something itself.
+template <typename F>
+auto print_line_with(const int fd, F write) {
+    std::string buffer = std::move(println_buffer());
+    buffer.clear();
+    write(buffer);
+    buffer += '\n';
+    print_line(fd, buffer);
+    println_buffer() = std::move(buffer);
+}
+
+// Streams `input` with std::cout's current flags, exactly as
+// `std::cout << input` would print it.
+template <typename T>
+auto print_streamed(const int fd, const T &input) {
+    print_line_with(fd, [&](std::string &buffer) {
+        StringAppendBuf appender{buffer};
+        std::ostream os{&appender};
+        if (fd == 2) {
+            os.copyfmt(std::cerr);
+        } else {
+            os.copyfmt(std::cout);
+        }
+        // copyfmt() also copies the tie, and flushing std::cout on every
+        // line would defeat the buffering.
+        os.tie(nullptr);
+        os << input;
+    });
+}
+
 template <typename T>
 auto println(const T &input) {
-    std::cout << input << std::endl;
+    print_streamed(1, input);
 }
 
 template <typename... Args>
-auto println(const std::string_view fmt_string, Args... args) {
-    std::cout << format(fmt_string, args...) << std::endl;
+auto println(const std::string_view fmt_string, const Args &...args) {
+    print_line_with(1, [&](std::string &buffer) {
+        format_to(buffer, fmt_string, args...);
+    });
+}
+
+template <size_t N, typename... Args>
+auto println(const FormatString<N> &fmt, const Args &...args) {
+    print_line_with(1, [&](std::string &buffer) {
+        format_to(buffer, fmt, args...);
+    });
 }
 
 template <typename T>
 auto eprintln(const T &input) {
-    std::cerr << input << std::endl;
+    print_streamed(2, input);
+}
+
+template <typename... Args>
+auto eprintln(const std::string_view fmt_string, const Args &...args) {
+    print_line_with(2, [&](std::string &buffer) {
+        format_to(buffer, fmt_string, args...);
+    });
+}
+
+template <size_t N, typename... Args>
+auto eprintln(const FormatString<N> &fmt, const Args &...args) {
+    print_line_with(2, [&](std::string &buffer) {
+        format_to(buffer, fmt, args...);
+    });
 }
 
 template <typename T>
@@ -826,8 +3312,441 @@ auto assert_eq_helper(T lhs, U rhs, const std::string &error_msg = "",
     if (lhs != rhs) { throw KhelperBadAssert(error_msg); }
 }
 
-/// MISC
+/// FILE
+// A read-only, memory-mapped view of a whole file.
+// Nothing is copied out of the page cache. Copies of a FileView share one
+// mapping, which is unmapped when the last copy goes away, so views taken from
+// it stay valid for as long as some copy is alive.
+struct FileView {
+    auto view() const -> std::string_view {
+        return {this->mapping.get(), this->size_};
+    }
+
+    auto data() const -> const char * {
+        return this->mapping.get();
+    }
+
+    auto size() const -> size_t {
+        return this->size_;
+    }
+
+    auto lines() const -> SplitView {
+        return lines_view(this->view());
+    }
+
+    SPtr<const char> mapping = nullptr;
+    size_t size_             = 0;
+};
+
+auto operator<<(std::ostream &os, const FileView &rhs) -> std::ostream &;
+
+// Maps `path` with a sequential-access hint. Fails for anything that isn't a
+// regular file, since pipes and the like can't be mapped.
+auto file_view(const std::string &path) -> Result<FileView, Error>;
+
+/// STREAMING
+struct LineReaderState;
+
+// Reads lines from a pipe, stdin or any other stream that can't be mapped.
+// A background thread fills two fixed-size chunks in turn, so reading overlaps
+// with whatever the caller does with each line. Memory stays at two chunks
+// plus the longest line that straddles a chunk boundary, whatever the size of
+// the input.
+struct LineReader {
+    explicit LineReader(const int fd, const size_t chunk_size = 1 << 20);
+    explicit LineReader(std::istream &input, const size_t chunk_size = 1 << 20);
+    LineReader(const LineReader &)            = delete;
+    LineReader &operator=(const LineReader &) = delete;
+    // Waits for a read that's in flight, so a blocking source that never
+    // closes will hold this up.
+    ~LineReader();
+
+    // The next line without its '\n'. The view is only good until the next
+    // call. A final line without a '\n' is still returned.
+    auto next() -> std::optional<std::string_view>;
+    // Set once a read fails. The lines before the failure are still returned.
+    auto error() const -> std::optional<Error>;
+
+  private:
+    UPtr<LineReaderState> state;
+};
+
+/// F is f(std::string_view line). Returns the number of lines read.
+template <typename F>
+auto for_each_line(F func, LineReader &reader) -> Result<size_t, Error> {
+    size_t count = 0;
+    while (auto line = reader.next()) {
+        func(line.value());
+        count++;
+    }
+    if (auto err = reader.error(); err) {
+        return Err<size_t, Error>(err.value());
+    }
+    return Ok<size_t, Error>(count);
+}
+
+template <typename F>
+auto for_each_line(F func, const int fd) -> Result<size_t, Error> {
+    LineReader reader{fd};
+    return for_each_line(func, reader);
+}
+
+template <typename F>
+auto for_each_line(F func, std::istream &input) -> Result<size_t, Error> {
+    LineReader reader{input};
+    return for_each_line(func, reader);
+}
+
+/// F is f(const std::vector<std::string_view> &words), called with the shell
+/// words of each line. The words are only good during the call, and quotes
+/// don't carry over from one line to the next. Returns the number of lines
+/// read.
+template <typename F>
+auto for_each_shell_line(F func, LineReader &reader) -> Result<size_t, Error> {
+    ShellSplitter splitter = {};
+    return for_each_line(
+        [&](const std::string_view line) { func(splitter.split(line)); },
+        reader);
+}
+
+template <typename F>
+auto for_each_shell_line(F func, const int fd) -> Result<size_t, Error> {
+    LineReader reader{fd};
+    return for_each_shell_line(func, reader);
+}
+
+template <typename F>
+auto for_each_shell_line(F func, std::istream &input) -> Result<size_t, Error> {
+    LineReader reader{input};
+    return for_each_shell_line(func, reader);
+}
+
+/// CSV
+struct CsvReaderState;
+
+// Reads RFC 4180 CSV, or TSV and the like with another `delim`, from memory,
+// a mapped file or a stream. Inside a quoted field a delimiter or newline is
+// data and `""` is a quote. Quotes and separators are found 64 bytes at a
+// time with vectorized compares, and a prefix XOR over the quote bits tells
+// which separators are inside quotes, so quoting costs nothing per byte.
+// Fields are views of the input; only those with quotes inside are decoded
+// into a buffer of the reader's. A '\r' before the newline is dropped and
+// blank lines are skipped.
+struct CsvReader {
+    explicit CsvReader(const std::string_view input, const char delim = ',');
+    // Holds on to the mapping, so `file` can go away before the reader.
+    explicit CsvReader(const FileView &file, const char delim = ',');
+    // A stream is read `chunk_size` bytes at a time, or more when a single
+    // row is longer than that.
+    explicit CsvReader(const int fd, const char delim = ',',
+                       const size_t chunk_size = 1 << 20);
+    explicit CsvReader(std::istream &input, const char delim = ',',
+                       const size_t chunk_size = 1 << 20);
+    CsvReader(const CsvReader &)            = delete;
+    CsvReader &operator=(const CsvReader &) = delete;
+    ~CsvReader();
+
+    // The fields of the next row, or null after the last one. Only good until
+    // the next call.
+    auto next() -> const std::vector<std::string_view> *;
+    // Set once a read fails. The rows before the failure are still returned.
+    auto error() const -> std::optional<Error>;
+
+  private:
+    UPtr<CsvReaderState> state;
+};
+
+// Parses field `column` of every row left in `reader` as a `T`, without
+// keeping the rows around. Rows are counted from the reader's next one, and a
+// row that's too short counts as a field that didn't parse.
+// Defined in khelper.cpp for the same types as `parse_column()`.
+template <typename T>
+auto csv_column(const size_t column, CsvReader &reader) -> Column<T>;
+// Reads the header, which is the next row, to find `name`. An empty Column if
+// it's not there.
+template <typename T>
+auto csv_column(const std::string_view name, CsvReader &reader) -> Column<T>;
+
+/// REGEX
+struct RegexProgram;
+
+// A compiled ECMAScript regular expression, the same syntax std::regex takes.
+// The common subset (literals, `.`, classes, `\d \w \s`, groups,
+// alternation, greedy and lazy repetition, `^ $ \b \B`) runs on a built-in
+// engine that's linear in the input: a lazily built DFA answers whether there
+// is a match, and a Pike VM finds where it is. Anything else, such as
+// backreferences or lookahead, falls back to std::regex. Invalid patterns
+// throw std::regex_error. A repeated group that matches the empty string ends
+// the repetition, as ECMAScript specifies; libstdc++ can match less there.
+//
+// Copies share the compiled program, which is never modified after
+// construction; the DFA is cached per thread. One Regex can be used from
+// several threads at once.
+struct Regex {
+    explicit Regex(const std::string_view pattern);
+
+    auto is_match(const std::string_view input) const -> bool;
+    // The leftmost match that starts at or after `start`. Anchors and word
+    // boundaries still see the input before `start`.
+    auto find_at(const std::string_view input, const size_t start = 0) const
+        -> std::optional<std::string_view>;
+    auto pattern() const -> const std::string &;
+    // False when the pattern is handled by std::regex.
+    auto is_native() const -> bool;
+
+  private:
+    SPtr<RegexProgram> program;
+};
+
+// The compiled form of `pattern` from a small per-thread LRU cache, so
+// calling the string overloads below in a loop compiles each pattern once.
+auto cached_regex(const std::string_view pattern) -> Regex;
+
+auto re_search(const Regex &re, const std::string_view input) -> bool;
 auto re_search(const std::string &re, const std::string &input) -> bool;
+auto re_find(const Regex &re, const std::string_view input)
+    -> std::optional<std::string_view>;
+auto re_find(const std::string_view re, const std::string_view input)
+    -> std::optional<std::string_view>;
+// Non-overlapping matches, left to right. An empty match moves the search on
+// by one byte.
+auto re_find_all(const Regex &re, const std::string_view input)
+    -> std::vector<std::string_view>;
+auto re_find_all(const std::string_view re, const std::string_view input)
+    -> std::vector<std::string_view>;
+
+/// PARALLEL
+struct ThreadPoolState;
+
+// Worker threads that share out loops by work stealing. A loop starts as one
+// range of indices. A thread holding a range bigger than the grain splits it
+// in half, pushes one half onto its own deque and keeps going with the other,
+// and an idle thread steals the oldest, so biggest, range from someone else's
+// deque. Pieces stay large while everyone is busy and only get small where
+// there's an imbalance to even out.
+struct ThreadPool {
+    // `threads` counts the thread calling `run()`, which works on the loop
+    // too, so a pool of 1 starts no threads at all. 0 means one per hardware
+    // thread.
+    explicit ThreadPool(const size_t threads = 0);
+    ThreadPool(const ThreadPool &)            = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    auto size() const -> size_t;
+    // Calls func(begin, end) on disjoint ranges that cover [0, count), none
+    // shorter than `grain` unless the whole loop is, and returns once all of
+    // them are done. The first exception thrown is rethrown here, and ranges
+    // that hadn't started by then are skipped. One loop runs at a time, so
+    // other callers wait, and a loop started from inside one of this pool's
+    // loops runs on the calling thread, even from another pool's thread
+    // working on a loop that one started.
+    auto run(const size_t count, const size_t grain,
+             const std::function<void(size_t, size_t)> &func) -> void;
+
+  private:
+    UPtr<ThreadPoolState> state;
+};
+
+// The pool behind the `par_` functions that aren't given one. Made on first
+// use, with a thread per hardware thread.
+auto default_thread_pool() -> ThreadPool &;
+
+// Inputs shorter than this run serially, since waking the workers would cost
+// more than they save on cheap work.
+inline constexpr size_t PAR_SERIAL_CUTOFF = 2048;
+
+// Calls func(begin, end) over [0, count) on `pool`, or in one call on this
+// thread when `count` is under the cutoff. The grain is set so each thread
+// sees about 16 pieces when nothing gets stolen.
+template <typename F>
+auto par_for(ThreadPool &pool, const size_t count, F func) -> void {
+    if (count < PAR_SERIAL_CUTOFF or pool.size() == 1) {
+        func(size_t{0}, count);
+        return;
+    }
+    const size_t grain = count / (16 * pool.size());
+    pool.run(count, grain == 0 ? 1 : grain, func);
+}
+
+// The `par_` functions take anything with contiguous `data()` and `size()`,
+// such as a vector or a Slice, and give the same results as their serial
+// counterparts.
+template <typename Input>
+using par_elem_t = std::remove_cv_t<
+    std::remove_pointer_t<decltype(std::declval<const Input &>().data())>>;
+
+// The output type has to be default constructible, since every element is
+// written in place by whichever thread gets to it.
+template <typename Transform, typename Input>
+auto par_fmap(ThreadPool &pool, Transform func, const Input &input) {
+    using T          = par_elem_t<Input>;
+    using U          = std::decay_t<std::invoke_result_t<Transform, const T &>>;
+    const T *data    = input.data();
+    const size_t len = input.size();
+    // Threads writing neighbouring bits of a vector<bool> would race.
+    using Slot = std::conditional_t<std::is_same_v<U, bool>, char, U>;
+    std::vector<Slot> output(len);
+    par_for(pool, len, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            output[i] = func(data[i]);
+        }
+    });
+    if constexpr (std::is_same_v<U, bool>) {
+        return std::vector<bool>(output.begin(), output.end());
+    } else {
+        return output;
+    }
+}
+
+template <typename Transform, typename Input>
+auto par_fmap(Transform func, const Input &input) {
+    return par_fmap(default_thread_pool(), func, input);
+}
+
+// Keeps the input order. Blocks are tested in parallel, a prefix sum of their
+// counts gives each one its place in the output, and then they're copied
+// there in parallel.
+template <typename Predicate, typename Input>
+auto par_filter(ThreadPool &pool, Predicate pred, const Input &input)
+    -> std::vector<par_elem_t<Input>> {
+    using T          = par_elem_t<Input>;
+    const T *data    = input.data();
+    const size_t len = input.size();
+    if (len < PAR_SERIAL_CUTOFF or pool.size() == 1) {
+        std::vector<T> output = {};
+        for (size_t i = 0; i < len; i++) {
+            if (pred(data[i])) { output.push_back(data[i]); }
+        }
+        return output;
+    }
+
+    const size_t block  = PAR_SERIAL_CUTOFF / 2;
+    const size_t blocks = (len + block - 1) / block;
+    std::vector<char> keep(len);
+    std::vector<size_t> offsets(blocks + 1);
+    pool.run(blocks, 1, [&](const size_t first, const size_t last) {
+        for (size_t b = first; b < last; b++) {
+            size_t kept = 0;
+            const size_t stop = (b + 1) * block < len ? (b + 1) * block : len;
+            for (size_t i = b * block; i < stop; i++) {
+                keep[i] = static_cast<char>(static_cast<bool>(pred(data[i])));
+                kept += keep[i];
+            }
+            offsets[b + 1] = kept;
+        }
+    });
+    for (size_t b = 0; b < blocks; b++) {
+        offsets[b + 1] += offsets[b];
+    }
+
+    std::vector<T> output(offsets[blocks]);
+    pool.run(blocks, 1, [&](const size_t first, const size_t last) {
+        for (size_t b = first; b < last; b++) {
+            size_t out = offsets[b];
+            const size_t stop = (b + 1) * block < len ? (b + 1) * block : len;
+            for (size_t i = b * block; i < stop; i++) {
+                if (keep[i]) { output[out++] = data[i]; }
+            }
+        }
+    });
+    return output;
+}
+
+template <typename Predicate, typename Input>
+auto par_filter(Predicate pred, const Input &input)
+    -> std::vector<par_elem_t<Input>> {
+    return par_filter(default_thread_pool(), pred, input);
+}
+
+/// F is f(acc, elem) -> new_acc and Combine is combine(acc, acc) -> acc.
+/// Each block is folded from `init`, and the blocks' results are combined in
+/// order, so `init` has to be an identity of `combine` and `combine` has to
+/// be associative. It needn't be commutative.
+template <typename U, typename F, typename Combine, typename Input>
+auto par_fold(ThreadPool &pool, U init, F func, Combine combine,
+              const Input &input) -> U {
+    using T          = par_elem_t<Input>;
+    const T *data    = input.data();
+    const size_t len = input.size();
+    if (len < PAR_SERIAL_CUTOFF or pool.size() == 1) {
+        U acc{init};
+        for (size_t i = 0; i < len; i++) {
+            acc = func(acc, data[i]);
+        }
+        return acc;
+    }
+
+    const size_t blocks = 16 * pool.size();
+    const size_t block  = (len + blocks - 1) / blocks;
+    std::vector<std::optional<U>> partial(blocks);
+    pool.run(blocks, 1, [&](const size_t first, const size_t last) {
+        for (size_t b = first; b < last; b++) {
+            U acc{init};
+            const size_t stop = (b + 1) * block < len ? (b + 1) * block : len;
+            for (size_t i = b * block; i < stop; i++) {
+                acc = func(acc, data[i]);
+            }
+            partial[b] = std::move(acc);
+        }
+    });
+    U acc{init};
+    for (auto &it : partial) {
+        acc = combine(acc, std::move(it.value()));
+    }
+    return acc;
+}
+
+template <typename U, typename F, typename Combine, typename Input>
+auto par_fold(U init, F func, Combine combine, const Input &input) -> U {
+    return par_fold(default_thread_pool(), init, func, combine, input);
+}
+
+/// Op is op(elem, elem) -> elem, associative, with `identity` as its
+/// identity. A `par_fold` that uses `op` both ways.
+template <typename T, typename Op, typename Input>
+auto par_reduce(ThreadPool &pool, T identity, Op op, const Input &input) -> T {
+    return par_fold(pool, identity, op, op, input);
+}
+
+template <typename T, typename Op, typename Input>
+auto par_reduce(T identity, Op op, const Input &input) -> T {
+    return par_reduce(default_thread_pool(), identity, op, input);
+}
+
+// The index of the first element that matches, like `find_if`. Once a match
+// is found, ranges after it are skipped and scans in progress past it stop.
+template <typename Predicate, typename Input>
+auto par_find(ThreadPool &pool, Predicate pred, const Input &input)
+    -> std::optional<size_t> {
+    using T          = par_elem_t<Input>;
+    const T *data    = input.data();
+    const size_t len = input.size();
+    std::atomic<size_t> best{len};
+    par_for(pool, len, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            // Checked each time, so a match elsewhere stops this scan.
+            size_t current = best.load(std::memory_order_relaxed);
+            if (i >= current) { return; }
+            if (!pred(data[i])) { continue; }
+            while (i < current
+                   and !best.compare_exchange_weak(current, i,
+                                                   std::memory_order_relaxed)) {
+            }
+            return;
+        }
+    });
+    const size_t found = best.load();
+    if (found == len) { return {}; }
+    return found;
+}
+
+template <typename Predicate, typename Input>
+auto par_find(Predicate pred, const Input &input) -> std::optional<size_t> {
+    return par_find(default_thread_pool(), pred, input);
+}
+
+/// MISC
 
 auto lines_from_file(const std::string &input) -> std::vector<std::string>;
 
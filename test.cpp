@@ -1,14 +1,49 @@
+#include "alloc_count.hpp"
 #include "khelper.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
 #include <optional>
+#include <random>
+#include <regex>
+#include <thread>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace khelper;
 
 const constexpr bool TEST_ALL     = false;
 const constexpr bool TEST_STRING  = TEST_ALL || true;
+const constexpr bool TEST_SHELL   = TEST_ALL || true;
+const constexpr bool TEST_VIEW    = TEST_ALL || true;
+const constexpr bool TEST_UTF8    = TEST_ALL || true;
+const constexpr bool TEST_SCAN    = TEST_ALL || true;
+const constexpr bool TEST_SEARCH  = TEST_ALL || true;
+const constexpr bool TEST_REGEX   = TEST_ALL || true;
+const constexpr bool TEST_FILE    = TEST_ALL || true;
+const constexpr bool TEST_STREAM  = TEST_ALL || true;
+const constexpr bool TEST_CSV     = TEST_ALL || true;
 const constexpr bool TEST_RESULT  = TEST_ALL || true;
+const constexpr bool TEST_PARSE   = TEST_ALL || true;
+const constexpr bool TEST_FORMAT  = TEST_ALL || true;
+const constexpr bool TEST_PRINT   = TEST_ALL || true;
 const constexpr bool TEST_VECTOR  = TEST_ALL || true;
+const constexpr bool TEST_ARENA   = TEST_ALL || true;
+const constexpr bool TEST_LAZY    = TEST_ALL || true;
 const constexpr bool TEST_COLOR   = TEST_ALL || true;
 const constexpr bool TEST_SLICE   = TEST_ALL || true;
+const constexpr bool TEST_HASH    = TEST_ALL || true;
+const constexpr bool TEST_PAR     = TEST_ALL || true;
 const constexpr bool TEST_KOPTION = TEST_ALL || true;
 const constexpr bool TEST_OTHER   = TEST_ALL || true;
 
@@ -22,6 +57,38 @@ auto test_string() {
     String s2 = "ASDF"s;
     kexpect_eq(to_lowercase(s2), "asdf"s);
     kexpect_eq(to_lowercase("AKSi{}"s), "aksi{}"s);
+    kexpect_eq(to_uppercase("Grüße, @[`{"), "GRüßE, @[`{"s);
+    String header      = "Access-Control-Allow-Origin";
+    const char *buffer = header.data();
+    header             = to_lowercase(std::move(header));
+    kexpect_eq(header, "access-control-allow-origin"s);
+    kexpect(header.data() == buffer);
+    kexpect(iequals("Content-Length", "content-LENGTH"));
+    kexpect(!iequals("Content-Length", "Content-Lengths"));
+    kexpect(!iequals("[", "{"));
+    kexpect(istarts_with("HTTP/", "http/1.1 200 OK"));
+    kexpect(iends_with(".JPG", "photo.jpg"));
+    kexpect(!iends_with(".jpeg", "photo.jpg"));
+    kexpect_eq(ifind("KEEP-alive", "Connection: keep-Alive"),
+               make_optional(12));
+    kexpect(!ifind("close", "Connection: keep-alive").has_value());
+    kexpect_eq(ifind("", "abc"), make_optional(0));
+
+    constexpr CharSet punctuation{".,;:!?"};
+    static_assert(punctuation.contains(';') and !punctuation.contains('a'));
+    static_assert(CharSet{"\xff"}.contains('\xff'));
+    kexpect_eq(find_char(punctuation, "Hello, world!").value().first, 5u);
+    kexpect(!find_char(punctuation, "Hello world").has_value());
+    kexpect_eq(split_any(CharSet{" \t,;"}, "a, b;;c\td ,"),
+               (Vec<String>{"a", "b", "c", "d"}));
+    kexpect(split_any(CharSet{","}, ",,,").empty());
+    kexpect_eq(split_any_view(CharSet{"/"}, "/usr//local/bin").to_vec(),
+               (Vec<std::string_view>{"usr", "local", "bin"}));
+    kexpect_eq(trim("  \t padded \r\n"), "padded"sv);
+    kexpect_eq(trim_start("  x "), "x "sv);
+    kexpect_eq(trim_end("  x "), "  x"sv);
+    kexpect_eq(trim(CharSet{"-="}, "==-title-=="), "title"sv);
+    kexpect_eq(trim(" \n "), ""sv);
     String s3 = "One Two Three";
     kexpect_eq(slice(0, 3, s3), "One"s);
     kexpect_eq(slice(4, s3), "Two Three"s);
@@ -56,6 +123,771 @@ auto test_string() {
     expect_eq_helper(
         string_break(R"(--option --flag -t -s "one two")"),
         std::vector<std::string>{"--option", "--flag", "-t", "-s", "one two"});
+
+    Vec<String> fields = {"id", "name", "email"};
+    kexpect_eq(join(", ", fields), "id, name, email"s);
+    kexpect_eq(join("", fields), "idnameemail"s);
+    kexpect_eq(join(",", Vec<String>{}), ""s);
+    kexpect_eq(join(",", Vec<String>{"only"}), "only"s);
+    kexpect_eq(join("\t", Vec<StringV>{"a", "", "c"}), "a\t\tc"s);
+    kexpect_eq(join("::", {"khelper", fields[1], "join"}),
+               "khelper::name::join"s);
+    // Sized up front, so it only allocates once.
+    size_t before = allocation_count;
+    String record = join(" | ", fields);
+    kexpect_eq(allocation_count - before, size_t{1});
+    kexpect_eq(record, "id | name | email"s);
+}
+
+auto test_shell() {
+    using Words = Vec<StringV>;
+    kexpect_eq(shell_split("one two\tthree\r\n").words,
+               (Words{"one", "two", "three"}));
+    kexpect_eq(shell_split(R"(o\"ne "two three")").words,
+               (Words{"o\"ne", "two three"}));
+    kexpect_eq(shell_split(R"(--option -s "one two" 'it''s' a"b c"d)").words,
+               (Words{"--option", "-s", "one two", "its", "ab cd"}));
+    kexpect_eq(shell_split(R"('a \ "b"' "c \d \$ \` \\ \"")").words,
+               (Words{R"(a \ "b")", R"(c \d $ ` \ ")"}));
+    kexpect_eq(shell_split("\"\" '' x").words, (Words{"", "", "x"}));
+    kexpect_eq(shell_split("a\\ b c\\\nd \"e\\\nf\" g\\").words,
+               (Words{"a b", "cd", "ef", "g\\"}));
+    kexpect_eq(shell_split("\"unterminated word").words,
+               (Words{"unterminated word"}));
+    kexpect_eq(shell_split("'unterminated").words, (Words{"unterminated"}));
+    kexpect(shell_split("  \t ").words.empty());
+
+    // Plain words view the input and nothing is decoded for them.
+    String line = "ls -la 'my dir' /tmp";
+    auto plain  = shell_split(line);
+    kexpect_eq(plain.words.size(), 4);
+    kexpect(plain.words[0].data() == line.data());
+    kexpect(plain.words[3].data() == line.data() + 16);
+    kexpect(plain.words[2].data() != line.data() + 7);
+    kexpect(shell_split("ls -la /tmp").decoded == nullptr);
+
+    // Moving the result keeps the decoded words where they are.
+    auto moved = std::move(plain);
+    kexpect_eq(moved.words[2], "my dir");
+
+    char memory[64];
+    std::pmr::monotonic_buffer_resource arena{memory, sizeof(memory)};
+    auto words = shell_split(arena, R"(cp "a b" 'c d')");
+    kexpect_eq(words, (Words{"cp", "a b", "c d"}));
+    kexpect(words[1].data() >= memory and words[1].data() < memory + 64);
+
+    ShellSplitter splitter = {};
+    kexpect_eq(splitter.split(R"(echo "hi there")"),
+               (Words{"echo", "hi there"}));
+    kexpect_eq(splitter.split("a 'b'"), (Words{"a", "b"}));
+    kexpect(splitter.split("").empty());
+
+    std::istringstream input{"a 'b c'\n\nd \"e\nf\"\n"};
+    Vec<Vec<String>> lines = {};
+    auto count             = for_each_shell_line(
+        [&](const Words &words) {
+            lines.emplace_back(words.begin(), words.end());
+        },
+        input);
+    kexpect_eq(count.value(), 4);
+    kexpect_eq(lines[0], (Vec<String>{"a", "b c"}));
+    kexpect(lines[1].empty());
+    kexpect_eq(lines[2], (Vec<String>{"d", "e"}));
+    kexpect_eq(lines[3], (Vec<String>{"f"}));
+}
+
+auto test_search() {
+    // Small alphabets make for periodic needles and plenty of near misses.
+    std::mt19937 rng{7};
+    auto random_text = [&](const size_t size, const char alphabet) {
+        String output(size, 'a');
+        for (auto &it : output) {
+            it = static_cast<char>('a' + rng() % (alphabet - 'a' + 1));
+        }
+        return output;
+    };
+    size_t mismatches = 0;
+    for (const auto impl : {ScanImpl::Scalar, ScanImpl::SSE2, ScanImpl::AVX2,
+                            ScanImpl::AVX512}) {
+        if (!set_scan_impl(impl)) { continue; }
+        for (size_t trial = 0; trial < 400; trial++) {
+            const char alphabet   = trial % 2 == 0 ? 'b' : 'd';
+            const String haystack = random_text(rng() % 300, alphabet);
+            String needle         = random_text(rng() % 80, alphabet);
+            if (trial % 3 == 0 and haystack.size() > 0) {
+                // A needle that's known to occur somewhere.
+                const size_t start = rng() % haystack.size();
+                needle = haystack.substr(start, rng() % 70);
+            }
+            const Searcher searcher{needle};
+            for (size_t start = 0; start <= haystack.size(); start += 37) {
+                size_t expected
+                    = std::string_view{haystack}.find(needle, start);
+                if (expected == String::npos) { expected = haystack.size(); }
+                mismatches += searcher.next(haystack, start) != expected;
+            }
+            const auto expected = std::string_view{haystack}.find(needle);
+            const auto actual   = find(needle, haystack);
+            mismatches += actual.has_value() != (expected != String::npos);
+            mismatches += actual and actual.value() != expected;
+        }
+    }
+    set_scan_impl(ScanImpl::Auto);
+    kexpect_eq(mismatches, 0u);
+
+    // Periodic needles, where a naive search backs up the most.
+    const String a_run = String(1000, 'a');
+    kexpect_eq(find(String(40, 'a') + "b", a_run + "b").value(), 960u);
+    kexpect(!find(String(40, 'a') + "b", a_run).has_value());
+    kexpect_eq(count_matches(Searcher{"aa"}, "aaaaa"), 2u);
+    kexpect_eq(find(Searcher{""}, "abc").value(), 0u);
+
+    // A one-shot find() of a long needle doesn't allocate; only a Searcher,
+    // kept for reuse, builds a shift table.
+    const String run_needle    = String(40, 'a') + "b";
+    const String run_haystack  = a_run + "b";
+    const size_t allocs_before = allocation_count.load();
+    const auto run_found       = find(run_needle, run_haystack);
+    const auto run_missing     = find(run_needle, a_run);
+    const size_t allocs        = allocation_count.load() - allocs_before;
+    kexpect_eq(allocs, 0u);
+    kexpect_eq(run_found.value(), 960u);
+    kexpect(!run_missing.has_value());
+
+    kexpect_eq(replace("aaaa", "aa", "b"), "bb"s);
+    kexpect_eq(replace("abcabc", "abc", "xyzw"), "xyzwxyzw"s);
+    kexpect_eq(replace("abc", "", "x"), "abc"s);
+    kexpect_eq(replace("ab", "abc", "x"), "ab"s);
+    kexpect_eq(replacen("a.b.c.d", ".", "::", 2), "a::b::c.d"s);
+    kexpect_eq(replacen("a.b", ".", "::", 0), "a.b"s);
+    // MultiSearcher against a brute-force leftmost-longest scan.
+    auto brute_force = [](const Vec<String> &needles,
+                          const std::string_view haystack) {
+        Vec<MultiMatch> output = {};
+        for (size_t pos = 0; pos < haystack.size();) {
+            std::optional<MultiMatch> best = {};
+            for (size_t i = 0; i < needles.size(); i++) {
+                const auto &it = needles[i];
+                if (it.empty() or !starts_with(it, haystack.substr(pos))) {
+                    continue;
+                }
+                if (!best or it.size() > best->len) {
+                    best = MultiMatch{pos, it.size(), i};
+                }
+            }
+            if (best) {
+                output.push_back(best.value());
+                pos += best->len;
+            } else {
+                pos++;
+            }
+        }
+        return output;
+    };
+    size_t multi_mismatches = 0;
+    for (size_t trial = 0; trial < 300; trial++) {
+        Vec<String> needles(1 + rng() % 12);
+        for (auto &it : needles) {
+            it = random_text(rng() % 6, trial % 2 == 0 ? 'c' : 'h');
+        }
+        const String haystack = random_text(rng() % 200, 'h');
+        const MultiSearcher searcher{needles};
+        multi_mismatches
+            += find_all(searcher, haystack) != brute_force(needles, haystack);
+    }
+    kexpect_eq(multi_mismatches, 0u);
+
+    const MultiSearcher secrets{{"password", "pass", "token", "key"}};
+    kexpect_eq(find_any(secrets, "my passport").value(),
+               (MultiMatch{3, 4, 1}));
+    kexpect_eq(find_all(secrets, "password=hunter2 token=x").size(), 2u);
+    kexpect(!find_any(secrets, "nothing here").has_value());
+    kexpect_eq(replace_all(secrets, {"***", "*", "<token>"},
+                           "password: pass, token, key"),
+               "***: *, <token>, "s);
+    kexpect_eq(replace_all({{"a", "b"}, {"b", "a"}, {"abc", "!"}}, "abcab"),
+               "!ba"s);
+    kexpect(!find_any(MultiSearcher{{"", ""}}, "abc").has_value());
+
+    const Searcher one_shot_needle{String(40, '-')};
+    const String rule = "x" + String(90, '-') + "y";
+    kexpect_eq(replace(rule, one_shot_needle, "="), "x==" + String(10, '-') + "y");
+}
+
+auto test_regex() {
+    // The built-in engine against std::regex on the same pattern.
+    const Vec<String> patterns = {
+        "T[wh]",        "a|ab|abc",      "(a|ab)(c|bcd)", "^ab",
+        "b$",           "a.c",           "[^a-c]+",       "\\d{2,3}",
+        "\\w+\\s\\w+", "x*",            "a+?b",          "(?:ab){2}",
+        "\\bab\\b",     "\\Bb",           "[a\\-]+",       "\\x41|\\.",
+        "colou?r",      "a{2,}",         "(a|b)*c",       "[\\D]+$",
+    };
+    const Vec<String> inputs = {
+        "",        "ab",      "abcd",     "ab ab",     "xabx",
+        "The cat", "Two",     "A.c a\nc", "12 345 6",  "aaab",
+        "colour",  "color",   "a-a--",    "ab\nab",    "bcabc",
+    };
+    size_t mismatches = 0;
+    for (const auto &pattern : patterns) {
+        const Regex re{pattern};
+        kexpect(re.is_native());
+        const std::regex expected{pattern};
+        for (const auto &input : inputs) {
+            std::smatch match;
+            const bool found = std::regex_search(input, match, expected);
+            const auto actual = re_find(re, input);
+            mismatches += found != re_search(re, input);
+            mismatches += found != actual.has_value();
+            if (found and actual) {
+                const auto pos = actual->data() - input.data();
+                mismatches += actual.value() != match.str(0)
+                           or pos != match.position(0);
+            }
+        }
+    }
+    kexpect_eq(mismatches, 0u);
+
+    kexpect_eq(re_find("a+|b+", "xxbbbaa").value(), "bbb"sv);
+    kexpect_eq(re_find("(a|ab)(c|bcd)", "abcd").value(), "abcd"sv);
+    kexpect_eq(re_find("a+?", "aaa").value(), "a"sv);
+    kexpect(!re_find("^b", "ab").has_value());
+    kexpect_eq(re_find_all("\\d+", "a1b22c333"),
+               (Vec<std::string_view>{"1", "22", "333"}));
+    kexpect_eq(re_find_all("a*", "baac"),
+               (Vec<std::string_view>{"", "aa", "", ""}));
+    // The boundary before `start` still counts.
+    const std::string_view spaced = "ab b";
+    const auto boundary           = Regex{"\\bb"}.find_at(spaced, 1).value();
+    kexpect_eq(static_cast<size_t>(boundary.data() - spaced.data()), 3u);
+
+    // Linear time where a backtracking engine isn't.
+    const String as(100000, 'a');
+    kexpect(!re_search(Regex{"(a*)*b"}, as));
+    kexpect_eq(re_find("(a|aa)+$", as).value().size(), as.size());
+
+    // Backreferences and lookahead go to std::regex.
+    const Regex repeated{"(\\w)\\1"};
+    kexpect(!repeated.is_native());
+    kexpect_eq(re_find(repeated, "abccd").value(), "cc"sv);
+    kexpect(re_search("a(?=b)", "cab"s));
+    bool threw = false;
+    try {
+        Regex{"a("};
+    } catch (const std::regex_error &) { threw = true; }
+    kexpect(threw);
+
+    kexpect_eq(cached_regex("T[wh]").pattern(), "T[wh]"s);
+    for (size_t i = 0; i < 100; i++) {
+        kexpect(re_search("x" + std::to_string(i), "x" + std::to_string(i)));
+    }
+
+    // One const Regex shared by several threads, each growing its own DFA.
+    const Regex shared{"([a-f]+[0-9]|z{2,}q)[^x]*x$"};
+    Vec<String> subjects(20000);
+    std::mt19937 rng{11};
+    for (String &line : subjects) {
+        line.resize(8 + rng() % 24);
+        for (char &c : line) {
+            c = "abcdefz0123456789qx"[rng() % 19];
+        }
+    }
+    auto matches = [&](const String &it) { return shared.is_match(it); };
+    Vec<String> expected_matches = filter(matches, subjects);
+    kexpect(!expected_matches.empty());
+    ThreadPool pool{4};
+    for (size_t round = 0; round < 3; round++) {
+        kexpect_eq(par_filter(pool, matches, subjects), expected_matches);
+    }
+}
+
+auto test_utf8() {
+    // Well-formed byte sequences, straight from Table 3-7 of the Unicode
+    // standard.
+    auto reference_valid = [](const std::string_view input) {
+        const auto *bytes = reinterpret_cast<const u8 *>(input.data());
+        for (size_t i = 0; i < input.size();) {
+            const u8 b0 = bytes[i];
+            size_t len  = 0;
+            u8 lo = 0x80, hi = 0xbf;
+            if (b0 <= 0x7f) {
+                len = 1;
+            } else if (b0 >= 0xc2 and b0 <= 0xdf) {
+                len = 2;
+            } else if (b0 >= 0xe0 and b0 <= 0xef) {
+                len = 3;
+                if (b0 == 0xe0) { lo = 0xa0; }
+                if (b0 == 0xed) { hi = 0x9f; }
+            } else if (b0 >= 0xf0 and b0 <= 0xf4) {
+                len = 4;
+                if (b0 == 0xf0) { lo = 0x90; }
+                if (b0 == 0xf4) { hi = 0x8f; }
+            } else {
+                return false;
+            }
+            if (i + len > input.size()) { return false; }
+            for (size_t k = 1; k < len; k++) {
+                const u8 lower = k == 1 ? lo : 0x80;
+                const u8 upper = k == 1 ? hi : 0xbf;
+                if (bytes[i + k] < lower or bytes[i + k] > upper) {
+                    return false;
+                }
+            }
+            i += len;
+        }
+        return true;
+    };
+
+    const String text = "Grüße, Jürgen! Привет, мир. 你好，世界。"
+                        "مرحبا بالعالم 🎉🚀 done";
+    const Vec<String> invalid = {
+        "\x80",             "\xc0\x80",         "\xc1\xbf",
+        "\xe0\x80\x80",     "\xed\xa0\x80",     "\xf0\x80\x80\x80",
+        "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff",
+        "\xc3",             "\xe4\xbd",         "a\xf0\x9f\x8e",
+    };
+    std::mt19937 rng{7};
+    for (auto impl : {ScanImpl::Scalar, ScanImpl::SSE2, ScanImpl::AVX2,
+                      ScanImpl::AVX512}) {
+        if (!set_scan_impl(impl)) { continue; }
+        kexpect_msg(utf8_validate(text), format("{}", impl));
+        kexpect(utf8_validate(""));
+        for (const auto &it : invalid) {
+            // At the start, the end, and across a block boundary.
+            kexpect_msg(!utf8_validate(it), format("{} {}", impl, it));
+            kexpect(!utf8_validate(String(31, 'a') + it + String(40, 'b')));
+            kexpect(!utf8_validate(text + text + it));
+        }
+        // Corrupt a byte or two of valid text at random.
+        size_t mismatches = 0;
+        for (size_t trial = 0; trial < 2000; trial++) {
+            String input = text.substr(rng() % 20);
+            input.resize(rng() % input.size());
+            for (size_t k = rng() % 3; k > 0 and !input.empty(); k--) {
+                input[rng() % input.size()] = static_cast<char>(rng());
+            }
+            mismatches += utf8_validate(input) != reference_valid(input);
+        }
+        kexpect_eq_msg(mismatches, 0u, format("{}", impl));
+        kexpect_eq(char_count(text), 55u);
+        kexpect_eq(char_count(text + text + text), 165u);
+    }
+    kexpect(set_scan_impl(ScanImpl::Auto));
+
+    kexpect_eq(char_slice(0, 5, text), "Grüße"sv);
+    kexpect_eq(char_slice(15, 21, text), "Привет"sv);
+    kexpect_eq(char_slice(48, 50, text), "🎉🚀"sv);
+    kexpect_eq(char_slice(51, text), "done"sv);
+    kexpect_eq(char_slice(47, 1000, text), " 🎉🚀 done"sv);
+    kexpect_eq(char_slice(5, 2, text), ""sv);
+    kexpect_eq(char_nth(2, text).value(), "ü"sv);
+    kexpect_eq(char_nth(49, text).value(), "🚀"sv);
+    kexpect(!char_nth(55, text).has_value());
+
+    String long_text = {};
+    for (size_t i = 0; i < 20; i++) { long_text += text; }
+    const Utf8Index index{long_text};
+    kexpect_eq(index.size(), char_count(long_text));
+    size_t index_mismatches = 0;
+    for (size_t i = 0; i <= index.size() + 1; i++) {
+        index_mismatches += char_nth(i, index) != char_nth(i, long_text);
+        index_mismatches
+            += char_slice(i, i + 7, index) != char_slice(i, i + 7, long_text);
+    }
+    kexpect_eq(index_mismatches, 0u);
+    kexpect_eq(Utf8Index{""}.size(), 0u);
+    kexpect_eq(char_slice(0, 3, Utf8Index{"añb"}), "añb"sv);
+}
+
+auto test_view() {
+    String csv = ",one,,two,three,";
+    Vec<StringV> expected1 = {"one", "two", "three"};
+    kexpect_eq(split_view(',', csv).to_vec(), expected1);
+    kexpect_eq(split_view(',', csv).count(), 3);
+    kexpect(split_view(',', ",,,").empty());
+
+    String text = "One\nTwo\n\nThree\nFour";
+    Vec<StringV> expected2 = {"One", "Two", "", "Three", "Four"};
+    kexpect_eq(lines_view(text).to_vec(), expected2);
+    kexpect_eq(lines_view("One\n").to_vec(), Vec<StringV>{"One"});
+    kexpect(lines_view("").empty());
+
+    Vec<StringV> expected3 = {"one", "two", "three"};
+    kexpect_eq(words_view("  one\t\r\ntwo      three ").to_vec(), expected3);
+
+    // The tokens point back into the original buffer.
+    kexpect_eq(split_view(',', csv).to_vec()[1].data(), csv.data() + 6);
+
+    Vec<StringV> expected4 = {"Two", "Three"};
+    kexpect_eq(filter([](auto it) { return starts_with("T", it); },
+                      lines_view(text)),
+               expected4);
+    kexpect_eq(
+        take_while([](auto it) { return !it.empty(); }, lines_view(text)),
+        (Vec<StringV>{"One", "Two"}));
+    kexpect_eq(nth(2, words_view("one two three")), make_optional("three"sv));
+    kexpect(!nth(3, words_view("one two three")).has_value());
+}
+
+auto test_scan() {
+    // Needles at every offset and lengths around every block size, so each
+    // implementation's tail handling gets hit.
+    for (auto impl : {ScanImpl::Scalar, ScanImpl::SSE2, ScanImpl::AVX2,
+                      ScanImpl::AVX512}) {
+        if (!set_scan_impl(impl)) { continue; }
+        for (size_t len = 0; len < 150; len++) {
+            String haystack(len, 'a');
+            kexpect_eq_msg(find_byte(',', haystack).has_value(), false,
+                           format("{}", impl));
+            for (size_t pos = 0; pos < len; pos++) {
+                haystack[pos] = ',';
+                kexpect_eq(find_byte(',', haystack), make_optional(pos));
+                kexpect_eq(count_byte(',', haystack), 1);
+                haystack[pos] = 'a';
+            }
+            kexpect_eq(count_byte(',', String(len, ',')), len);
+        }
+        kexpect_eq(split("one,two,,three,", ','),
+                   (Vec<String>{"one", "two", "three"}));
+        kexpect_eq(find_char('w', "one two").value().first, 5);
+
+        // Case kernels against a per-byte reference, over every byte value.
+        String bytes(150, '\0');
+        for (size_t i = 0; i < bytes.size(); i++) {
+            bytes[i] = static_cast<char>((i * 37 + 11) % 256);
+        }
+        for (size_t len = 0; len <= bytes.size(); len++) {
+            const auto input = std::string_view{bytes}.substr(0, len);
+            String lower{input};
+            for (auto &it : lower) {
+                if (it >= 'A' and it <= 'Z') { it = it + 32; }
+            }
+            kexpect_eq_msg(to_lowercase(input), lower, format("{}", impl));
+            kexpect(iequals(to_uppercase(input), lower));
+            kexpect_eq(to_lowercase(to_uppercase(input)), lower);
+        }
+        // CharSet lookups against `contains()`, with sets of one byte up to
+        // every other byte.
+        for (const size_t stride : {256, 97, 13, 2}) {
+            CharSet set;
+            for (size_t c = 7; c < 256; c += stride) {
+                set.add(static_cast<char>(c));
+            }
+            for (size_t start = 0; start < 150; start += 5) {
+                const auto input = std::string_view{bytes}.substr(start);
+                size_t expected  = 0;
+                while (expected < input.size()
+                       and !set.contains(input[expected])) {
+                    expected++;
+                }
+                const auto found = find_char(set, input);
+                kexpect_eq_msg(found ? found->first : input.size(), expected,
+                               format("{} stride {}", impl, stride));
+            }
+        }
+        const String csv_line(100, ' ');
+        kexpect_eq(split_any(CharSet{" ,"}, csv_line + "a, b,c" + csv_line),
+                   (Vec<String>{"a", "b", "c"}));
+        kexpect_eq(trim(csv_line + "x y" + csv_line), "x y"sv);
+
+        const String text = "xx The Quick BROWN fox, the quick brown FOX. "
+                            "The Quick Brown Fox Jumps Over The Lazy Dog";
+        for (size_t start = 0; start < text.size(); start += 7) {
+            for (size_t len = 1; len < 24 and start + len <= text.size();
+                 len++) {
+                const String needle = to_uppercase(text.substr(start, len));
+                kexpect_eq(ifind(needle, text),
+                           find(to_lowercase(needle), to_lowercase(text)));
+            }
+        }
+    }
+    kexpect(set_scan_impl(ScanImpl::Auto));
+    kexpect(scan_impl() != ScanImpl::Auto);
+
+    kexpect_eq(lines("One\nTwo\n\nThree"),
+               (Vec<String>{"One", "Two", "", "Three"}));
+    kexpect_eq(lines("One\n"), Vec<String>{"One"});
+}
+
+auto test_file() {
+    const String path = "khelper_test_file.txt";
+    std::ofstream{path} << "One\nTwo\n\nThree";
+
+    auto file = file_view(path);
+    kexpect(file);
+    kexpect_eq(file.value().view(), "One\nTwo\n\nThree"sv);
+    kexpect_eq(file.value().lines().to_vec(),
+               (Vec<StringV>{"One", "Two", "", "Three"}));
+    kexpect_eq(lines_from_file(path), (Vec<String>{"One", "Two", "", "Three"}));
+
+    std::ofstream{path};
+    auto empty = file_view(path);
+    kexpect(empty);
+    kexpect_eq(empty.value().size(), 0);
+    kexpect(empty.value().lines().empty());
+    std::remove(path.c_str());
+
+    auto missing = file_view(path);
+    kexpect(!missing);
+    kexpect_eq(missing.err_value().code, ENOENT);
+    kexpect(lines_from_file(path).empty());
+    kexpect(!file_view("."));
+
+    // Files that can't be mapped, or that report a size of 0, are still read.
+    const auto status = lines_from_file("/proc/self/status");
+    kexpect(!status.empty() and starts_with("Name:", status[0]));
+    int fds[2];
+    kassert(pipe(fds) == 0);
+    kassert(write(fds[1], "a\nb\n", 4) == 4);
+    close(fds[1]);
+    kexpect_eq(lines_from_file(format("/dev/fd/{}", fds[0])),
+               (Vec<String>{"a", "b"}));
+    close(fds[0]);
+}
+
+// Writes each message to `fd` a few bytes at a time, then waits for the
+// reader to count it in `seen` before sending the next. Sets `stalled` and
+// gives up if a message is never seen, which means the reader held it back
+// waiting for more input. Closes `fd` when done.
+auto trickle_writer(const int fd, const Vec<String> messages,
+                    std::atomic<size_t> &seen, std::atomic<bool> &stalled) {
+    for (size_t i = 0; i < messages.size(); i++) {
+        const String &message = messages[i];
+        for (size_t at = 0; at < message.size(); at += 3) {
+            const size_t size
+                = message.size() - at < 3 ? message.size() - at : 3;
+            kassert(write(fd, message.data() + at, size) > 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        const auto deadline
+            = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+        while (seen.load() <= i and std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        if (seen.load() <= i) {
+            stalled = true;
+            break;
+        }
+    }
+    close(fd);
+}
+
+auto test_stream() {
+    // Small chunks, so lines straddle one or more chunk boundaries.
+    String text = "One\nTwo\n\nA line longer than a chunk\nThree";
+    Vec<String> expected = {"One", "Two", "", "A line longer than a chunk",
+                            "Three"};
+    for (size_t chunk_size : {1, 3, 7, 64}) {
+        std::istringstream input{text};
+        LineReader reader{input, chunk_size};
+        Vec<String> actual = {};
+        auto count = for_each_line(
+            [&](StringV line) { actual.emplace_back(line); }, reader);
+        kexpect_eq_msg(actual, expected, format("chunk_size = {}", chunk_size));
+        kexpect_eq(count.value(), 5);
+    }
+
+    int fds[2];
+    kassert(pipe(fds) == 0);
+    std::thread writer{[&] {
+        for (int i = 0; i < 1000; i++) {
+            String line = format("line {}\n", i);
+            kassert(write(fds[1], line.data(), line.size()) > 0);
+        }
+        close(fds[1]);
+    }};
+    size_t count  = 0;
+    bool in_order = true;
+    LineReader reader{fds[0], 100};
+    while (auto line = reader.next()) {
+        in_order = in_order and line.value() == format("line {}", count);
+        count++;
+    }
+    writer.join();
+    close(fds[0]);
+    kexpect_eq(count, 1000);
+    kexpect(in_order);
+    kexpect(!reader.error().has_value());
+
+    // A line that trickles in a few bytes at a time is handed over once it
+    // is complete, not when a whole chunk has arrived.
+    kassert(pipe(fds) == 0);
+    std::atomic<size_t> seen{0};
+    std::atomic<bool> stalled{false};
+    std::thread trickle{trickle_writer, fds[1],
+                        Vec<String>{"piece 0\n", "piece 1\n", "piece 2\n",
+                                    "piece 3\n", "piece 4\n"},
+                        std::ref(seen), std::ref(stalled)};
+    LineReader trickled{fds[0], 1 << 16};
+    Vec<String> pieces = {};
+    while (auto line = trickled.next()) {
+        pieces.emplace_back(line.value());
+        seen++;
+    }
+    trickle.join();
+    close(fds[0]);
+    kexpect(!stalled);
+    kexpect_eq(pieces, (Vec<String>{"piece 0", "piece 1", "piece 2", "piece 3",
+                                    "piece 4"}));
+
+    std::istringstream empty{""};
+    kexpect_eq(for_each_line([](StringV) {}, empty).value(), 0);
+}
+
+// A byte-at-a-time reader to check CsvReader against, with the same rules.
+auto csv_reference(const StringV input, const char delim) -> Vec<Vec<String>> {
+    Vec<Vec<String>> rows = {};
+    Vec<String> row       = {};
+    String field          = {};
+    bool inside           = false;
+    bool quoted           = false;
+    // Only a '\r' outside quotes is part of the line ending.
+    bool bare_cr = false;
+    auto end_row = [&] {
+        if (bare_cr) { field.pop_back(); }
+        row.push_back(field);
+        if (row.size() > 1 or !row[0].empty() or quoted) { rows.push_back(row); }
+        row.clear();
+        field.clear();
+        quoted = false;
+    };
+    for (size_t i = 0; i < input.size(); i++) {
+        const char c = input[i];
+        if (c == '"') {
+            quoted = true;
+            if (inside and i + 1 < input.size() and input[i + 1] == '"') {
+                field += '"';
+                i++;
+            } else {
+                inside = !inside;
+            }
+        } else if (inside) {
+            field += c;
+        } else if (c == delim) {
+            row.push_back(field);
+            field.clear();
+            quoted = false;
+        } else if (c == '\n') {
+            end_row();
+        } else {
+            field += c;
+        }
+        bare_cr = c == '\r' and !inside;
+    }
+    if (!field.empty() or !row.empty() or quoted) { end_row(); }
+    return rows;
+}
+
+auto csv_rows(CsvReader &reader) -> Vec<Vec<String>> {
+    Vec<Vec<String>> rows = {};
+    while (auto fields = reader.next()) {
+        rows.emplace_back(fields->begin(), fields->end());
+    }
+    return rows;
+}
+
+auto test_csv() {
+    const String text = "name,age,note\r\n"
+                        "ann,31,\"likes \"\"quotes\"\"\"\r\n"
+                        "\n"
+                        "bob,,\"two\nlines, one comma\"\n"
+                        "\"\",x,\"plain\"";
+    const Vec<Vec<String>> expected = {
+        {"name", "age", "note"},
+        {"ann", "31", "likes \"quotes\""},
+        {"bob", "", "two\nlines, one comma"},
+        {"", "x", "plain"},
+    };
+    CsvReader reader{text};
+    kexpect_eq(csv_rows(reader), expected);
+    kexpect(reader.next() == nullptr);
+    kexpect(!reader.error().has_value());
+
+    // Fields without inner quotes are views of the input.
+    CsvReader views{text};
+    views.next();
+    auto row = views.next();
+    kexpect(row->at(0).data() == text.data() + 15);
+    kexpect(row->at(1).data() == text.data() + 19);
+    kexpect(row->at(2).data() < text.data()
+            or row->at(2).data() >= text.data() + text.size());
+    kexpect(views.next()->at(2).data() == text.data() + 49);
+
+    CsvReader tsv{"a\tb c\t\"d\te\"\n", '\t'};
+    kexpect_eq(csv_rows(tsv), (Vec<Vec<String>>{{"a", "b c", "d\te"}}));
+    CsvReader empty{""};
+    kexpect(empty.next() == nullptr);
+    CsvReader trailing{"a,\n,b\n\n"};
+    kexpect_eq(csv_rows(trailing), (Vec<Vec<String>>{{"a", ""}, {"", "b"}}));
+
+    // Random bytes from a small alphabet hit quotes, separators and block
+    // boundaries in every combination. Streams are read in small chunks so
+    // rows straddle them.
+    std::mt19937 rng{11};
+    const StringV alphabet = "ab,;\"\"\n\r ";
+    for (int round = 0; round < 300; round++) {
+        String input(rng() % 300, ' ');
+        for (char &c : input) { c = alphabet[rng() % alphabet.size()]; }
+        const char delim = round % 2 ? ',' : ';';
+        const auto want  = csv_reference(input, delim);
+        for (auto impl : {ScanImpl::Scalar, ScanImpl::SSE2, ScanImpl::AVX2,
+                          ScanImpl::AVX512}) {
+            if (!set_scan_impl(impl)) { continue; }
+            CsvReader memory{input, delim};
+            kexpect_eq_msg(csv_rows(memory), want,
+                           format("{}", impl));
+        }
+        set_scan_impl(ScanImpl::Auto);
+        for (size_t chunk_size : {1, 5, 64, 100}) {
+            std::istringstream stream{input};
+            CsvReader streamed{stream, delim, chunk_size};
+            kexpect_eq_msg(csv_rows(streamed), want,
+                           format("chunk_size = {}", chunk_size));
+        }
+    }
+
+    const String prices = "id,price\n1,9.5\n2,oops\n3\n4,\"12.25\"\n";
+    // Rows that trickle through a pipe come back as soon as each one is
+    // complete, including one whose quoted field holds a newline.
+    int fds[2];
+    kassert(pipe(fds) == 0);
+    std::atomic<size_t> seen{0};
+    std::atomic<bool> stalled{false};
+    std::thread trickle{trickle_writer, fds[1],
+                        Vec<String>{"a,b\n", "\"multi\nline\",c\n",
+                                    "d,\"e\"\"f\"\n"},
+                        std::ref(seen), std::ref(stalled)};
+    CsvReader piped{fds[0]};
+    Vec<Vec<String>> rows = {};
+    while (auto fields = piped.next()) {
+        rows.emplace_back(fields->begin(), fields->end());
+        seen++;
+    }
+    trickle.join();
+    close(fds[0]);
+    kexpect(!stalled);
+    kexpect_eq(rows, (Vec<Vec<String>>{
+                         {"a", "b"}, {"multi\nline", "c"}, {"d", "e\"f"}}));
+
+    CsvReader by_index{prices};
+    by_index.next();
+    auto ids = csv_column<i64>(0, by_index);
+    kexpect_eq(ids.values, (Vec<i64>{1, 2, 3, 4}));
+    kexpect(ids.bad_rows.empty());
+    CsvReader by_name{prices};
+    auto price = csv_column<f64>("price", by_name);
+    kexpect_eq(price.values, (Vec<f64>{9.5, 12.25}));
+    kexpect_eq(price.bad_rows, (Vec<size_t>{1, 2}));
+    CsvReader no_column{prices};
+    kexpect(csv_column<f64>("cost", no_column).values.empty());
+
+    const String path = "khelper_test_file.csv";
+    std::ofstream{path} << text;
+    auto file = file_view(path);
+    std::remove(path.c_str());
+    kexpect(file);
+    CsvReader mapped{file.value()};
+    kexpect_eq(csv_rows(mapped), expected);
 }
 
 auto test_result() {
@@ -69,6 +901,355 @@ auto test_result() {
     kexpect_eq(res5.err_value(), true);
 }
 
+auto test_parse() {
+    kexpect_eq(parse<i32>("-1234").value(), -1234);
+    kexpect_eq(parse<u64>("18446744073709551615").value(), UINT64_MAX);
+    kexpect_eq(parse<i8>("-128").value(), -128);
+    kexpect_eq(parse<i8>("128").err_value(), ParseError::Overflow);
+    kexpect_eq(parse<u16>("65536").err_value(), ParseError::Overflow);
+    kexpect_eq(parse<i64>("").err_value(), ParseError::Empty);
+    kexpect_eq(parse<i64>("x1").err_value(), ParseError::InvalidDigit);
+    kexpect_eq(parse<i64>("12abc").err_value(), ParseError::TrailingCharacters);
+    kexpect_eq(parse<u32>("-1").err_value(), ParseError::InvalidDigit);
+    kexpect_eq(parse<f64>("2.5e3").value(), 2500.0);
+    kexpect_eq(parse<f32>("-0.25").value(), -0.25f);
+    kexpect_eq(parse<f64>("1.5.").err_value(), ParseError::TrailingCharacters);
+    kexpect_eq(parse<f64>("1e999").err_value(), ParseError::Overflow);
+    kexpect_eq(parse<f64>("-1e999").err_value(), ParseError::Overflow);
+    kexpect_eq(parse<f64>("1e-400").err_value(), ParseError::Underflow);
+    kexpect_eq(parse<f64>("-2.5e-400").err_value(), ParseError::Underflow);
+    kexpect_eq(parse<f32>("1e-50").err_value(), ParseError::Underflow);
+    kexpect_eq(parse<f32>("1e50").err_value(), ParseError::Overflow);
+    kexpect_eq(parse<f64>("0." + String(400, '0') + "1").err_value(),
+               ParseError::Underflow);
+    kexpect_eq(parse<f64>("1" + String(400, '0')).err_value(),
+               ParseError::Overflow);
+    kexpect_eq(parse<f64>("0.000001e-99999999999999999999").err_value(),
+               ParseError::Underflow);
+    kexpect_eq(parse<f64>("0e-400").value(), 0.0);
+    kexpect_eq(format("{}", ParseError::Underflow), "Underflow"s);
+
+    // Views into a bigger buffer parse without a copy.
+    StringV record = "42,17";
+    kexpect_eq(parse<i32>(record.substr(0, 2)).value(), 42);
+
+    kexpect_eq(parse_i32("1234"), make_optional(1234));
+    kexpect(!parse_i32("4294967296").has_value());
+    kexpect(!parse_u32("-5").has_value());
+    kexpect_eq(parse_u64("7"), make_optional(u64{7}));
+    kexpect_eq(parse_f64("0.5"), make_optional(0.5));
+    kexpect(!parse_f32("").has_value());
+
+    auto column = parse_column<i64>(
+        '\n', "1\n-22\nx\n333\r\n\n99999999999999999\n123456789012\n");
+    kexpect_eq(column.values,
+               (Vec<i64>{1, -22, 333, 99999999999999999, 123456789012}));
+    kexpect_eq(column.bad_rows, (Vec<size_t>{2, 4}));
+
+    auto narrow = parse_column<i8>(',', "127,128,-128,-129,+1,1-");
+    kexpect_eq(narrow.values.size(), 2);
+    kexpect_eq(narrow.bad_rows, (Vec<size_t>{1, 3, 4, 5}));
+    kexpect_eq(parse_column<u32>(',', "4294967295,-1").bad_rows,
+               Vec<size_t>{1});
+    kexpect_eq(parse_column<f64>(',', "0.5,1e3,nope").values,
+               (Vec<f64>{0.5, 1000.0}));
+    kexpect(parse_column<i32>(',', "").values.empty());
+
+    // Long enough to go through the 64 byte blocks, and agrees with parse().
+    String numbers    = {};
+    Vec<i64> expected = {};
+    for (i64 i = -500; i < 500; i++) {
+        expected.push_back(i * 7919 * 104729);
+        numbers += format("{},", expected.back());
+    }
+    kexpect_eq(parse_column<i64>(',', numbers).values, expected);
+}
+
+auto test_format() {
+    kexpect_eq(format("{} and {}", "Alice", 42), "Alice and 42"s);
+    kexpect_eq(format("{1} before {0}, {0} again", "a", "b"),
+               "b before a, a again"s);
+    kexpect_eq(format("{{}} {}", 1), "{} 1"s);
+
+    // Padding and alignment.
+    kexpect_eq(format("[{:5}]", 42), "[   42]"s);
+    kexpect_eq(format("[{:5}]", "ab"), "[ab   ]"s);
+    kexpect_eq(format("[{:<5}]", 42), "[42   ]"s);
+    kexpect_eq(format("[{:^6}]", "ab"), "[  ab  ]"s);
+    kexpect_eq(format("[{:*>4}]", 7), "[***7]"s);
+    kexpect_eq(format("[{:05}]", -42), "[-0042]"s);
+    kexpect_eq(format("[{:.3}]", "abcdef"), "[abc]"s);
+
+    // Integer bases, float precision.
+    kexpect_eq(format("{:x} {:X} {:o} {:b}", 255, 255, 8, 5), "ff FF 10 101"s);
+    kexpect_eq(format("{:08x}", 0xbeefu), "0000beef"s);
+    kexpect_eq(format("{}", std::numeric_limits<i64>::min()),
+               "-9223372036854775808"s);
+    kexpect_eq(format("{:.2f} {:.1e}", 3.14159, 1234.5), "3.14 1.2e+03"s);
+
+    // Defaults match what an ostream prints.
+    for (const f64 value : {0.1, 1e6, 1.0 / 3, -2.5, 100.0}) {
+        std::ostringstream oss;
+        oss << value;
+        kexpect_eq(format("{}", value), oss.str());
+    }
+
+    // `r` prints the shortest text that reads back as the same value.
+    kexpect_eq(format("{:r} {:r} {:r} {:r}", 0.1, 100.0, -2.5, 1e6),
+               "0.1 100 -2.5 1e+06"s);
+    kexpect_eq(format("{:r} {:>20r}", 0.1f, 1.0 / 3),
+               "0.1   0.3333333333333333"s);
+    kexpect_eq(format("{:g}", 1.0 / 3), "0.333333"s);
+    for (const f64 value : {1.0 / 3, 5e-324, 1.7976931348623157e308, -0.0}) {
+        kexpect_eq(parse<f64>(format("{:r}", value)).value(), value);
+    }
+    kexpect_eq(format("{} {} {}", true, 'c', u8{65}), "1 c A"s);
+    kexpect_eq(format("{}", ScanImpl::AVX2), "AVX2"s);
+    kexpect_eq(format("{:>6}", ParseError::Empty), " Empty"s);
+
+    // Missing arguments and stray braces are left as they were.
+    kexpect_eq(format("{} {}", 1), "1 {}"s);
+    kexpect_eq(format("a { b {}", 1), "a { b 1"s);
+    kexpect_eq(format("a } {x}", 1), "a } {x}"s);
+
+    // So is a field whose width, precision or index is past
+    // FORMAT_SPEC_MAX, instead of wrapping around or padding to gigabytes.
+    kexpect_eq(format("{:99999999999}", 1), "{:99999999999}"s);
+    kexpect_eq(format("{:4000000000}|", 1), "{:4000000000}|"s);
+    kexpect_eq(format("{:.4000000000f}", 1.0), "{:.4000000000f}"s);
+    kexpect_eq(format("{18446744073709551617}", 1), "{18446744073709551617}"s);
+    kexpect_eq(format("{:65536}", 1).size(), 65536u);
+    static_assert(FormatString{"{:65536}"}.pieces[0].spec.width == 65536);
+
+    // Parsed once, at compile time.
+    constexpr FormatString parsed{"x = {:>4}!"};
+    static_assert(parsed.count == 3);
+    static_assert(parsed.pieces[1].spec.width == 4);
+    kexpect_eq(format(parsed, 12), "x =   12!"s);
+    kexpect_eq(format(kfmt("{} + {} = {}"), 1, 2, 3), "1 + 2 = 3"s);
+
+    // to_chars() against the standard library, at every digit count.
+    char chars[24];
+    for (u64 value = 1; value != 0 and value < 1'000'000'000'000'000'000u;
+         value *= 10) {
+        for (const u64 it : {value - 1, value, value + 7}) {
+            const auto end = to_chars(std::begin(chars), std::end(chars), it);
+            kexpect_eq(String(chars, end.ptr), std::to_string(it));
+        }
+    }
+    for (const i64 it : {std::numeric_limits<i64>::min(),
+                         std::numeric_limits<i64>::max(), i64{-1}}) {
+        const auto result = to_chars(std::begin(chars), std::end(chars), it);
+        kexpect_eq(String(chars, result.ptr), std::to_string(it));
+    }
+    const auto result = to_chars(chars, chars + 3, 1234);
+    kexpect(result.ec == std::errc::value_too_large);
+
+    // Vector printers take the buffered path but print what they always did.
+    std::ostringstream oss;
+    oss << Vec<u8>{0, 7, 255} << Vec<i32>{-1, 20} << Vec<f64>{0.5, 1.0 / 3}
+        << Vec<i32>{};
+    kexpect_eq(oss.str(), "Vec { 0, 7, 255 }Vec { -1, 20 }"
+                          "Vec { 0.5, 0.333333 }Vec {  }"s);
+    oss.str("");
+    oss << std::hex << Vec<i32>{255} << std::dec << std::setprecision(3)
+        << Vec<f64>{1.0 / 3};
+    kexpect_eq(oss.str(), "Vec { ff }Vec { 0.333 }"s);
+
+    String buffer = "log: ";
+    format_to(buffer, kfmt("{}/{}"), 1, 2);
+    format_to(buffer, " {}", "done");
+    kexpect_eq(buffer, "log: 1/2 done"s);
+}
+
+// Runs `func` with file descriptor `target` pointed at a temporary file and
+// returns what was written to it.
+template <typename F>
+auto capture_output(const int target, F func) -> String {
+    flush_output();
+    char path[]      = "/tmp/khelper_test_XXXXXX";
+    const int fd     = mkstemp(path);
+    const int saved  = dup(target);
+    dup2(fd, target);
+    func();
+    flush_output();
+    dup2(saved, target);
+    close(saved);
+    close(fd);
+
+    std::ifstream file{path};
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    unlink(path);
+    return contents.str();
+}
+
+template <typename F>
+auto capture_stdout(F func) -> String {
+    return capture_output(1, func);
+}
+
+auto test_print() {
+    kexpect_eq(print_mode(), PrintMode::Async);
+
+    // Lines from many threads come out whole and in each thread's order.
+    const size_t threads = 4;
+    const size_t count   = 5000;
+    String output        = capture_stdout([&] {
+        Vec<std::thread> workers = {};
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([t] {
+                for (size_t i = 0; i < count; i++) {
+                    println("thread {} line {}", t, i);
+                }
+            });
+        }
+        println("main thread");
+        for (auto &it : workers) {
+            it.join();
+        }
+    });
+    Vec<size_t> next(threads, 0);
+    size_t malformed = 0;
+    for (const auto line : lines_view(output)) {
+        if (line == "main thread") { continue; }
+        const auto words = words_view(line).to_vec();
+        const auto t     = parse<size_t>(words.size() == 4 ? words[1] : "");
+        const auto i     = parse<size_t>(words.size() == 4 ? words[3] : "");
+        if (!t or !i or t.value() >= threads or i.value() != next[t.value()]) {
+            malformed++;
+            continue;
+        }
+        next[t.value()]++;
+    }
+    kexpect_eq(malformed, 0u);
+    kexpect_eq(next, Vec<size_t>(threads, count));
+    kexpect(find("main thread\n", output).has_value());
+
+    // Sync mode goes through std::cout one flushed line at a time.
+    set_print_mode(PrintMode::Sync);
+    output = capture_stdout([] {
+        println("sync {}", 1);
+        println(2.5);
+        println();
+    });
+    set_print_mode(PrintMode::Async);
+    kexpect_eq(output, "sync 1\n2.5\n\n"s);
+
+    // println(x) prints exactly what `std::cout << x` would.
+    output = capture_stdout([] {
+        println(1.0 / 3);
+        println(Vec<i32>{1, 2});
+    });
+    kexpect_eq(output, "0.333333\nVec { 1, 2 }\n"s);
+
+    // flush_output() orders buffered lines with std::cout.
+    output = capture_stdout([] {
+        println("one");
+        flush_output();
+        std::cout << "two\n";
+        flush_output();
+        println("three");
+        flush_output();
+        std::cout << "four" << std::endl;
+        println("five");
+    });
+    kexpect_eq(output, "one\ntwo\nthree\nfour\nfive\n"s);
+
+    // With the fork hooks, a forked child doesn't repeat what the parent had
+    // buffered, and its stderr lines survive an _exit() with no flush.
+    flush_output_on_fork();
+    String errors = {};
+    output        = capture_stdout([&] {
+        errors = capture_output(2, [] {
+            std::cout << "through cout" << std::endl;
+            println("before fork");
+            const pid_t child = fork();
+            if (child == 0) {
+                println("child");
+                flush_output();
+                eprintln("child error");
+                _exit(0);
+            }
+            waitpid(child, nullptr, 0);
+            println("parent");
+        });
+    });
+    kexpect_eq(output, "through cout\nbefore fork\nchild\nparent\n"s);
+    kexpect_eq(errors, "child error\n"s);
+
+    // With the crash hooks, a crashing process still writes what it printed.
+    output = capture_stdout([] {
+        const pid_t child = fork();
+        if (child == 0) {
+            const rlimit no_core{0, 0};
+            setrlimit(RLIMIT_CORE, &no_core);
+            flush_output_on_crash();
+            println("last words");
+            std::abort();
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        kexpect(WIFSIGNALED(status) and WTERMSIG(status) == SIGABRT);
+    });
+    kexpect_eq(output, "last words\n"s);
+}
+
+auto test_arena() {
+    Arena arena{256};
+    void *first = arena.allocate(10, 1);
+    void *wide  = arena.allocate(32, 64);
+    kexpect_eq(reinterpret_cast<uintptr_t>(wide) % 64, 0);
+    kexpect(arena.used() >= 42);
+    kexpect_eq(arena.capacity(), 256);
+    // Bigger than any chunk so far: gets a chunk of its own.
+    kexpect(arena.allocate(1000, 8) != nullptr);
+    kexpect(arena.capacity() >= 256 + 1000);
+    const size_t capacity = arena.capacity();
+    arena.reset();
+    kexpect_eq(arena.used(), 0);
+    kexpect(arena.allocate(10, 1) == first);
+    kexpect_eq(arena.capacity(), capacity);
+    arena.release();
+    kexpect_eq(arena.capacity(), 0);
+
+    const String text = "one,two,,three\nfour\n";
+    for (int round = 0; round < 3; round++) {
+        arena.reset();
+        auto fields = split(arena, text, ',');
+        kexpect_eq(Vec<String>(fields.begin(), fields.end()), split(text, ','));
+        kexpect(fields.get_allocator().resource() == &arena);
+        kexpect(fields[0].get_allocator().resource() == &arena);
+        auto rows = lines(arena, text);
+        kexpect_eq(Vec<String>(rows.begin(), rows.end()), lines(text));
+        kexpect_eq(String{replace(arena, text, "two", "2")},
+                   replace(text, "two", "2"));
+        kexpect_eq(String{replace(arena, text, Searcher{","}, ";")},
+                   replace(text, ",", ";"));
+        kexpect_eq(String{format(arena, "{} and {:>4}", 1, "x")},
+                   "1 and    x");
+        kexpect_eq(String{format(arena, FormatString{"{}-{}"}, 'a', 2.5)},
+                   "a-2.5");
+
+        const Vec<i32> numbers = {1, 2, 3, 4};
+        auto doubled = fmap(arena, [](i32 x) { return x * 2.0; }, numbers);
+        kexpect_eq(Vec<double>(doubled.begin(), doubled.end()),
+                   (Vec<double>{2, 4, 6, 8}));
+        auto even = filter(arena, [](i32 x) { return x % 2 == 0; }, numbers);
+        kexpect_eq(Vec<i32>(even.begin(), even.end()), (Vec<i32>{2, 4}));
+        auto both = concat(arena, numbers, Vec<i32>{5});
+        kexpect_eq(Vec<i32>(both.begin(), both.end()),
+                   (Vec<i32>{1, 2, 3, 4, 5}));
+        // The same work after a reset fits in the chunks already there.
+        if (round == 1) { kexpect(arena.used() <= arena.capacity()); }
+    }
+    const size_t settled = arena.capacity();
+    arena.reset();
+    split(arena, text, ',');
+    lines(arena, text);
+    kexpect_eq(arena.capacity(), settled);
+}
+
 auto test_vector() {
     Vec<u32> v1 = {1, 2, 3, 4, 5, 6};
     // clang-format off
@@ -100,6 +1281,197 @@ Four)";
         !flag_value("--destination-dir", {"--source-dir", "src/"}).has_value());
     expect_helper(!flag_value("src/", {"--source-dir", "src/"}).has_value());
     expect_helper(flag_value("Two", expected2).has_value());
+
+    // Consuming a vector moves its elements and reuses its buffer.
+    Vec<String> words = {"alpha", "beta", "gamma", "delta", "epsilon"};
+    for (auto &it : words) {
+        it.append(32, '!');
+    }
+    const String *buffer = words.data();
+    size_t before        = allocation_count;
+    Vec<String> kept     = take_while(
+        [](const String &it) { return it.size() < 38; },
+        fmap<String, String>(
+            [](String it) {
+                it[0] = 'A' + (it[0] - 'a');
+                return it;
+            },
+            filter([](const String &it) { return it[0] != 'b'; },
+                   std::move(words))));
+    kexpect_eq(allocation_count - before, size_t{0});
+    kexpect(kept.data() == buffer);
+    kexpect_eq(kept.size(), size_t{3});
+    kexpect(starts_with("Gamma!", kept[1]));
+
+    // Copying the strings out of a kept lvalue, by contrast, allocates for
+    // each of them.
+    Vec<String> source = kept;
+    before             = allocation_count;
+    Vec<String> copied = filter([](const String &) { return true; }, source);
+    kexpect(allocation_count - before > source.size());
+    kexpect_eq(copied, kept);
+
+    before            = allocation_count;
+    const size_t size = fold(
+        size_t{0}, [](size_t acc, String it) { return acc + it.size(); },
+        std::move(source));
+    kexpect_eq(allocation_count - before, size_t{0});
+    kexpect_eq(size, size_t{3 * 37});
+
+    Vec<u32> v3    = {1, 2, 3, 4, 5};
+    using Sum      = std::optional<u32>;
+    auto add_small = [](Sum acc, u32 it) -> Sum {
+        if (it > 3) { return {}; }
+        return acc.value() + it;
+    };
+    kexpect_eq(try_fold(Sum{0}, add_small, v3), Sum{6});
+    kexpect_eq(try_fold(Sum{0}, add_small, Vec<u32>{v3}), Sum{6});
+    auto halve = [](u32 it) -> std::optional<u32> {
+        if (it % 2 != 0) { return {}; }
+        return it / 2;
+    };
+    kexpect_eq(flat_map(halve, v3), (Vec<u32>{1, 2}));
+    kexpect_eq(flat_map(halve, std::move(v3)), (Vec<u32>{1, 2}));
+    kexpect_eq((fmap<u32, bool>([](u32 it) { return it > 1; }, Vec<u32>{1, 2})),
+               (Vec<bool>{false, true}));
+    kexpect_eq((fmap<u32, String>([](u32 it) { return std::to_string(it); },
+                                  Vec<u32>{4, 5})),
+               (Vec<String>{"4", "5"}));
+
+    // concat() allocates exactly once, whatever the number of inputs.
+    Vec<i32> a  = {1, 2};
+    Vec<i32> b  = {3};
+    Vec<i32> c  = {};
+    Vec<u8> d   = {4, 5};
+    before      = allocation_count;
+    auto joined = concat(a, b, c, d, slice(1, a).value());
+    kexpect_eq(allocation_count - before, size_t{1});
+    kexpect_eq(joined, (Vec<i32>{1, 2, 3, 4, 5, 2}));
+    kexpect_eq(joined.capacity(), joined.size());
+    kexpect_eq(concat(a), a);
+    kexpect_eq(concat(a, b), (Vec<i32>{1, 2, 3}));
+
+    // Rvalues have their elements moved, and the first one's buffer is reused
+    // when it's big enough.
+    Vec<String> head = {"a"};
+    head.reserve(8);
+    const String *head_data = head.data();
+    Vec<String> tail        = {String(40, 't')};
+    const char *tail_chars  = tail[0].data();
+    Vec<String> all
+        = concat(std::move(head), Vec<String>{"b"}, std::move(tail));
+    kexpect(all.data() == head_data);
+    kexpect(all[2].data() == tail_chars);
+    kexpect_eq(all.size(), size_t{3});
+
+    Vec<i32> v4                 = {1, 2, 3, 4, 5, 6, 7, 8};
+    const i32 *const v4_storage = v4.data();
+    kexpect_eq(retain([](i32 it) { return it % 3 != 0; }, v4), size_t{2});
+    kexpect_eq(v4, (Vec<i32>{1, 2, 4, 5, 7, 8}));
+    kexpect(v4.data() == v4_storage);
+    kexpect_eq(retain_mut(
+                   [](i32 &it) {
+                       it *= 10;
+                       return it > 20;
+                   },
+                   v4),
+               size_t{2});
+    kexpect_eq(v4, (Vec<i32>{40, 50, 70, 80}));
+    kexpect_eq(drain_filter([](i32 it) { return it % 20 != 0; }, v4),
+               (Vec<i32>{50, 70}));
+    kexpect_eq(v4, (Vec<i32>{40, 80}));
+
+    // A throwing predicate leaves no moved-from strings behind.
+    Vec<String> names = {"ann", "bob", "cy", "dee", "eve"};
+    bool thrown       = false;
+    try {
+        retain(
+            [](const String &it) {
+                if (it == "dee") { throw std::runtime_error{"dee"}; }
+                return it.size() == 3;
+            },
+            names);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    kexpect(thrown);
+    kexpect_eq(names, (Vec<String>{"ann", "bob", "dee", "eve"}));
+
+    Vec<i32> runs = {1, 1, 2, 2, 2, 1, 3, 3};
+    kexpect_eq(dedup(runs), size_t{4});
+    kexpect_eq(runs, (Vec<i32>{1, 2, 1, 3}));
+    Vec<String> by_initial = {"apple", "avocado", "banana", "blueberry",
+                              "apricot"};
+    kexpect_eq(dedup_by_key([](const String &it) { return it[0]; }, by_initial),
+               size_t{2});
+    kexpect_eq(by_initial, (Vec<String>{"apple", "banana", "apricot"}));
+    // Compared with the last one kept, not the previous element.
+    Vec<i32> rising = {1, 2, 3, 4, 10, 11};
+    dedup_by([](i32 kept, i32 it) { return it - kept <= 2; }, rising);
+    kexpect_eq(rising, (Vec<i32>{1, 4, 10}));
+    Vec<i32> empty = {};
+    kexpect_eq(dedup(empty), size_t{0});
+
+    auto odd                 = [](i32 it) { return it % 2 != 0; };
+    const Vec<i32> mixed     = {5, 2, 8, 1, 9, 4};
+    auto [odds, evens]       = partition(odd, mixed);
+    kexpect_eq(odds, (Vec<i32>{5, 1, 9}));
+    kexpect_eq(evens, (Vec<i32>{2, 8, 4}));
+    Vec<i32> owned              = mixed;
+    const i32 *const owned_data = owned.data();
+    auto [odds2, evens2]        = partition(odd, std::move(owned));
+    kexpect(odds2.data() == owned_data);
+    kexpect_eq(odds2, odds);
+    kexpect_eq(evens2, evens);
+}
+
+auto test_lazy() {
+    Vec<u32> v1 = {1, 2, 3, 4, 5, 6};
+    // clang-format off
+    Vec<u32> expected1 = {6, 9};
+    kexpect_eq(lazy::collect(
+               lazy::take_while([](auto it) { return it < 10; },
+               lazy::fmap([](auto it)       { return it * 3;  },
+               lazy::filter([](auto it)     { return it >= 2; },
+               v1)))), expected1);
+    // clang-format on
+
+    // Only as much of the input as the output needs gets looked at.
+    size_t calls = 0;
+    auto evens   = lazy::filter(
+        [&](auto it) {
+            calls++;
+            return it % 2 == 0;
+        },
+        v1);
+    kexpect_eq(lazy::collect(lazy::take(2, evens)), (Vec<u32>{2, 4}));
+    kexpect_eq(calls, 4);
+    kexpect_eq(lazy::nth(2, evens), make_optional(6u));
+    kexpect(!lazy::nth(3, evens).has_value());
+    kexpect_eq(lazy::count(evens), 3);
+    auto sum = [](auto acc, auto it) { return acc + it; };
+    kexpect_eq(lazy::fold(0u, sum, evens), 12);
+
+    String input = "One\nTwo\nThree\nFour";
+    auto starts_with_t = [](auto it) { return starts_with("T", it); };
+    kexpect_eq(lazy::collect(lazy::take(
+                   1, lazy::filter(starts_with_t, lines_view(input)))),
+               Vec<StringV>{"Two"});
+
+    Vec<std::optional<i32>> v2 = {1, {}, 3};
+    kexpect_eq(lazy::collect(lazy::flatten(v2)), (Vec<i32>{1, 3}));
+    Vec<Vec<i32>> v3 = {{1, 2}, {}, {3}};
+    kexpect_eq(lazy::collect(lazy::flatten(v3)), (Vec<i32>{1, 2, 3}));
+    kexpect_eq(lazy::collect(lazy::flat_map(
+                   [](auto it) { return parse_i32(it); },
+                   Vec<String>{"1", "x", "3"})),
+               (Vec<i32>{1, 3}));
+
+    // Owned inputs move through the chain.
+    Vec<String> words = {"one", "two", "three"};
+    auto moved = lazy::collect(lazy::take(2, std::move(words)));
+    kexpect_eq(moved, (Vec<String>{"one", "two"}));
+    kexpect_eq(lazy::take(5, Vec<i32>{1, 2}).size_hint(), make_optional(2));
 }
 
 auto test_color() {
@@ -169,6 +1541,353 @@ auto test_slice() {
     Slice s2 = slice(2, 5, v1).value();
 
     kexpect_eq(s1, s2);
+    kexpect(s1.data() == v1.data() + 2);
+    kexpect(!slice(2, 6, v1).has_value());
+    kexpect(!slice(5, v1).has_value());
+    kexpect_eq(slice(3, v1).value().to_vec(), (Vec<String>{"four", "five"}));
+
+    // A mutable slice writes through to the vector; a const one can't.
+    Vec<i32> numbers = {1, 2, 3, 4, 5, 6, 7};
+    Slice<i32> all   = numbers;
+    all[0]           = 10;
+    kexpect_eq(numbers[0], 10);
+    const Vec<i32> &readonly = numbers;
+    Slice view               = readonly;
+    static_assert(std::is_same_v<decltype(view), Slice<const i32>>);
+    Slice<const i32> widened = all;
+    kexpect(widened == view);
+    kexpect_eq(all.subslice(1, 3).value().to_vec(), (Vec<i32>{2, 3}));
+    kexpect(!all.subslice(3, 8).has_value());
+
+    auto [left, right] = all.split_at(3);
+    kexpect_eq(left.to_vec(), (Vec<i32>{10, 2, 3}));
+    kexpect_eq(right.to_vec(), (Vec<i32>{4, 5, 6, 7}));
+    kexpect(all.split_at(7).second.empty());
+    bool threw = false;
+    try {
+        all.split_at(8);
+    } catch (const std::out_of_range &) { threw = true; }
+    kexpect(threw);
+
+    Vec<Vec<i32>> chunks = {};
+    for (auto chunk : all.chunks(3)) { chunks.push_back(chunk.to_vec()); }
+    kexpect_eq(chunks, (Vec<Vec<i32>>{{10, 2, 3}, {4, 5, 6}, {7}}));
+    kexpect_eq(all.chunks(3).size(), 3);
+    kexpect_eq(all.chunks(7).size(), 1);
+    kexpect_eq(Slice<i32>{}.chunks(2).size(), 0);
+    for (auto chunk : all.chunks(2)) { chunk[0] = 0; }
+    kexpect_eq(numbers, (Vec<i32>{0, 2, 0, 4, 0, 6, 0}));
+
+    Vec<i32> sums = {};
+    for (auto window : view.windows(3)) {
+        sums.push_back(fold(0, [](i32 a, i32 b) { return a + b; }, window));
+    }
+    kexpect_eq(sums, (Vec<i32>{2, 6, 4, 10, 6}));
+    kexpect_eq(view.windows(7).size(), 1);
+    kexpect_eq(view.windows(8).size(), 0);
+    threw = false;
+    try {
+        view.windows(0);
+    } catch (const std::invalid_argument &) { threw = true; }
+    kexpect(threw);
+
+    Vec<i32> parts       = {1, 0, 2, 3, 0, 0, 4};
+    auto is_zero         = [](i32 x) { return x == 0; };
+    Vec<Vec<i32>> pieces = {};
+    for (auto piece : Slice{parts}.split(is_zero)) {
+        pieces.push_back(piece.to_vec());
+    }
+    kexpect_eq(pieces, (Vec<Vec<i32>>{{1}, {2, 3}, {}, {4}}));
+    pieces.clear();
+    for (auto piece : Slice{parts}.rsplit(is_zero)) {
+        pieces.push_back(piece.to_vec());
+    }
+    kexpect_eq(pieces, (Vec<Vec<i32>>{{4}, {}, {2, 3}, {1}}));
+
+    // The vector helpers take slices as they are.
+    Slice<const i32> tail = slice(2, parts).value();
+    kexpect_eq(fmap([](i32 x) { return x * 2; }, tail),
+               (Vec<i32>{4, 6, 0, 0, 8}));
+    kexpect_eq(filter([](i32 x) { return x > 2; }, tail), (Vec<i32>{3, 4}));
+    kexpect_eq(find(4, tail), std::make_optional<size_t>(4));
+    kexpect(!find(1, tail).has_value());
+    kexpect_eq(nth(1, tail), std::make_optional(3));
+    kexpect_eq(take_while([](i32 x) { return x != 0; }, tail),
+               (Vec<i32>{2, 3}));
+    Vec<i32> collected = {};
+    append(collected, tail);
+    kexpect_eq(collected, (Vec<i32>{2, 3, 0, 0, 4}));
+    kexpect_eq(lazy::collect(lazy::filter([](i32 x) { return x != 0; }, tail)),
+               (Vec<i32>{2, 3, 4}));
+}
+
+auto test_hash() {
+    HashMap<String, i32> ages = {{"ann", 31}, {"bob", 27}};
+    kexpect_eq(ages.size(), size_t{2});
+    kexpect_eq(*ages.find("ann"), 31);
+    kexpect(ages.find("cy") == nullptr);
+    // Looking up by view or literal doesn't build a String.
+    const String name     = "bob and more";
+    size_t before         = allocation_count;
+    const bool by_view    = ages.contains(StringV{name}.substr(0, 3));
+    const bool by_literal = ages.contains("bob and");
+    kexpect_eq(allocation_count - before, size_t{0});
+    kexpect(by_view);
+    kexpect(!by_literal);
+
+    kexpect(ages.insert("cy", 40));
+    kexpect(!ages.insert("cy", 41));
+    kexpect_eq(*ages.find("cy"), 40);
+    kexpect(!ages.insert_or_assign("cy", 42));
+    kexpect_eq(*ages.find("cy"), 42);
+    ages["dee"] += 5;
+    kexpect_eq(ages["dee"], 5);
+    kexpect(ages.erase("ann"));
+    kexpect(!ages.erase("ann"));
+    kexpect(!ages.contains("ann"));
+    kexpect_eq(ages.size(), size_t{3});
+    HashMap<String, i32> expected = {{"bob", 27}, {"cy", 42}, {"dee", 5}};
+    kexpect_eq(ages, expected);
+    HashMap<String, i32> copied = ages;
+    copied["bob"]               = 0;
+    kexpect(copied != ages);
+    kexpect_eq(*ages.find("bob"), 27);
+
+    // Enough keys to grow through several sizes, with erasures mixed in so
+    // tombstones get reused and cleared out.
+    HashMap<u64, u64> squares = {};
+    std::map<u64, u64> model  = {};
+    std::mt19937 rng{7};
+    for (size_t i = 0; i < 200'000; i++) {
+        const u64 key = rng() % 50'000;
+        if (rng() % 4 == 0) {
+            kexpect_eq(squares.erase(key), model.erase(key) == 1);
+        } else {
+            squares.insert_or_assign(key, key * key);
+            model[key] = key * key;
+        }
+    }
+    kexpect_eq(squares.size(), model.size());
+    bool same = true;
+    for (const auto &[key, value] : model) {
+        const u64 *found = squares.find(key);
+        same             = same and found != nullptr and *found == value;
+    }
+    size_t visited = 0;
+    for (const auto &it : squares) {
+        same = same and model.at(it.first) == it.second;
+        visited++;
+    }
+    kexpect(same);
+    kexpect_eq(visited, model.size());
+
+    // Copies keep the tombstones that keys placed past a full group rely on.
+    // Filling close to the load limit makes full groups common.
+    size_t lost = 0;
+    for (size_t round = 0; round < 200; round++) {
+        HashMap<u64, u64> churned = {};
+        std::map<u64, u64> kept   = {};
+        for (size_t i = 0; i < 440; i++) {
+            const u64 key = rng();
+            churned.insert_or_assign(key, i);
+            kept[key] = i;
+        }
+        for (auto it = kept.begin(); it != kept.end();) {
+            if (rng() % 3 != 0) {
+                it++;
+                continue;
+            }
+            churned.erase(it->first);
+            it = kept.erase(it);
+        }
+        const HashMap<u64, u64> copy = churned;
+        HashMap<u64, u64> assigned   = {};
+        assigned                     = copy;
+        for (const auto &[key, value] : kept) {
+            const u64 *in_copy     = copy.find(key);
+            const u64 *in_assigned = assigned.find(key);
+            lost += in_copy == nullptr or *in_copy != value;
+            lost += in_assigned == nullptr or *in_assigned != value;
+        }
+    }
+    kexpect_eq(lost, 0u);
+
+    squares.clear();
+    kexpect(squares.empty());
+    kexpect(!squares.contains(u64{7}));
+
+    HashSet<String> seen = {"x", "y"};
+    kexpect(seen.insert("z"));
+    kexpect(!seen.insert(String{"x"}));
+    kexpect(seen.contains("z"sv));
+    kexpect(seen.erase("y"));
+    kexpect_eq(seen, (HashSet<String>{"x", "z"}));
+
+    Vec<String> words = {"b", "a", "b", "c", "a", "b"};
+    kexpect_eq(unique(words), (Vec<String>{"b", "a", "c"}));
+    kexpect_eq(counts(words),
+               (HashMap<String, size_t>{{"a", 2}, {"b", 3}, {"c", 1}}));
+
+    Vec<i32> numbers = {1, 2, 3, 4, 5, 6};
+    auto groups      = group_by([](i32 it) { return it % 3; }, numbers);
+    kexpect_eq(groups.size(), size_t{3});
+    kexpect_eq(*groups.find(0), (Vec<i32>{3, 6}));
+    kexpect_eq(*groups.find(1), (Vec<i32>{1, 4}));
+
+    Vec<String> people = {"ann:1", "bob:2", "ann:3"};
+    auto by_name = index_by([](const String &it) { return it.substr(0, 3); },
+                            people);
+    kexpect_eq(by_name.size(), size_t{2});
+    kexpect_eq(*by_name.find("ann"), "ann:3"s);
+
+    Vec<i32> wanted = {4, 2, 9};
+    kexpect_eq(intersection(wanted, Vec<i32>{1, 2, 2, 4, 5}),
+               (Vec<i32>{2, 2, 4}));
+    kexpect_eq(difference(wanted, Vec<i32>{1, 2, 2, 4, 5}), (Vec<i32>{1, 5}));
+    kexpect_eq(intersection(Vec<i32>{}, numbers), Vec<i32>{});
+}
+
+auto test_parallel() {
+    Vec<u64> numbers(100000);
+    for (size_t i = 0; i < numbers.size(); i++) {
+        numbers[i] = (i * 2654435761u) % 1000;
+    }
+    const Vec<u64> small = {5, 1, 4, 1, 5, 9, 2, 6};
+    auto square          = [](u64 it) { return it * it; };
+    auto even            = [](u64 it) { return it % 2 == 0; };
+    auto plus            = [](u64 a, u64 b) { return a + b; };
+
+    u64 total = 0;
+    Vec<bool> evens;
+    for (auto it : numbers) {
+        total += it;
+        evens.push_back(even(it));
+    }
+
+    for (size_t threads : {1, 2, 4}) {
+        ThreadPool pool{threads};
+        kexpect_eq(pool.size(), threads);
+
+        kexpect_eq(par_fmap(pool, square, numbers),
+                   (fmap<u64, u64>(square, numbers)));
+        kexpect_eq(par_fmap(pool, square, small),
+                   (fmap<u64, u64>(square, small)));
+        kexpect_eq(par_fmap(pool, even, numbers), evens);
+        kexpect_eq(par_filter(pool, even, numbers), filter(even, numbers));
+        kexpect_eq(par_filter(pool, even, small), filter(even, small));
+        kexpect_eq(par_reduce(pool, u64{0}, plus, numbers), total);
+        kexpect_eq(par_fold(pool, u64{0}, plus, plus, small), u64{33});
+
+        // Strings concatenate in order, so the blocks must be combined in
+        // order too.
+        auto append = [](String acc, u64 it) {
+            return acc + char('a' + it % 26);
+        };
+        auto join = [](String a, String b) { return a + b; };
+        kexpect_eq(par_fold(pool, String{}, append, join, numbers),
+                   fold(String{}, append, numbers));
+
+        // The first match, not just any match.
+        kexpect_eq(par_find(pool, [](u64 it) { return it == 999; }, numbers),
+                   find(999, numbers));
+        Vec<u64> zeros(50000);
+        zeros[49999] = 1;
+        zeros[30000] = 1;
+        kexpect_eq(par_find(pool, [](u64 it) { return it == 1; }, zeros),
+                   make_optional(size_t{30000}));
+        kexpect(!par_find(pool, [](u64 it) { return it > 1000; }, numbers));
+
+        // Slices work as input too.
+        Slice<const u64> half = slice(50000, numbers).value();
+        kexpect_eq(par_fmap(pool, square, half),
+                   (fmap<u64, u64>(square, half.to_vec())));
+
+        // Every index is covered exactly once.
+        Vec<std::atomic<u32>> hits(10007);
+        pool.run(hits.size(), 3, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                hits[i]++;
+            }
+        });
+        bool all_once = true;
+        for (auto &it : hits) {
+            all_once = all_once and it == 1;
+        }
+        kexpect(all_once);
+
+        // Exceptions reach the caller, and the pool still works afterwards.
+        bool thrown = false;
+        try {
+            par_fmap(pool,
+                     [](u64 it) -> u64 {
+                         if (it == 999) { throw std::runtime_error{"999"}; }
+                         return it;
+                     },
+                     numbers);
+        } catch (const std::runtime_error &e) {
+            thrown = String{e.what()} == "999";
+        }
+        kexpect(thrown);
+        kexpect_eq(par_reduce(pool, u64{0}, plus, numbers), total);
+
+        // A loop started from inside a loop runs serially rather than
+        // deadlocking.
+        Vec<u64> inner(64);
+        pool.run(inner.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                inner[i] = par_reduce(pool, u64{0}, plus, numbers);
+            }
+        });
+        kexpect_eq(inner, Vec<u64>(64, total));
+
+        // Still true after a loop on another pool in between.
+        ThreadPool other{2};
+        Vec<u64> outer(64);
+        Vec<u64> nested(64);
+        pool.run(outer.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                outer[i]  = par_reduce(other, u64{0}, plus, numbers);
+                nested[i] = par_reduce(pool, u64{0}, plus, numbers);
+            }
+        });
+        kexpect_eq(outer, Vec<u64>(64, total));
+        kexpect_eq(nested, Vec<u64>(64, total));
+
+        // And when the loop on the other pool is the one that comes back to
+        // this pool, from the other pool's own threads.
+        std::atomic<size_t> calls{0};
+        auto count_calls = [&](size_t begin, size_t end) {
+            calls += end - begin;
+        };
+        pool.run(64, 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                other.run(64, 1, [&](size_t inner_begin, size_t inner_end) {
+                    for (size_t j = inner_begin; j < inner_end; j++) {
+                        pool.run(8, 1, count_calls);
+                    }
+                });
+            }
+        });
+        kexpect_eq(calls.load(), 64u * 64 * 8);
+    }
+
+    // Idle threads go to sleep during a long tail rather than spin, so the
+    // process uses little CPU time while one range sleeps.
+    ThreadPool pool{4};
+    const std::clock_t cpu_before = std::clock();
+    pool.run(64, 1, [](size_t begin, size_t) {
+        if (begin == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{200});
+        }
+    });
+    const double cpu_secs
+        = static_cast<double>(std::clock() - cpu_before) / CLOCKS_PER_SEC;
+    kexpect(cpu_secs < 0.1);
+
+    kexpect(default_thread_pool().size() >= 1);
+    kexpect_eq(par_reduce(u64{0}, plus, numbers), total);
+    kexpect_eq(par_filter(even, Vec<u64>{}), Vec<u64>{});
+    kexpect(!par_find(even, Vec<u64>{}));
 }
 
 auto unhappy_test_koption() {
@@ -276,10 +1995,26 @@ auto foo() -> KOption<i32> {
 int main() {
     // clang-format off
     if (TEST_STRING)  { test_string();  }
+    if (TEST_SHELL)   { test_shell();   }
+    if (TEST_VIEW)    { test_view();    }
+    if (TEST_UTF8)    { test_utf8();    }
+    if (TEST_SCAN)    { test_scan();    }
+    if (TEST_SEARCH)  { test_search();  }
+    if (TEST_REGEX)   { test_regex();   }
+    if (TEST_FILE)    { test_file();    }
+    if (TEST_STREAM)  { test_stream();  }
+    if (TEST_CSV)     { test_csv();     }
     if (TEST_RESULT)  { test_result();  }
+    if (TEST_PARSE)   { test_parse();   }
+    if (TEST_FORMAT)  { test_format();  }
+    if (TEST_PRINT)   { test_print();   }
     if (TEST_VECTOR)  { test_vector();  }
+    if (TEST_ARENA)   { test_arena();   }
+    if (TEST_LAZY)    { test_lazy();    }
     if (TEST_COLOR)   { test_color();   }
     if (TEST_SLICE)   { test_slice();   }
+    if (TEST_HASH)    { test_hash();    }
+    if (TEST_PAR)     { test_parallel(); }
     if (TEST_KOPTION) { unhappy_test_koption(); }
     if (TEST_OTHER)   { test_other();   }
     // clang-format on